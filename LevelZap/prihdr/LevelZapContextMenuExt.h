@@ -28,6 +28,10 @@
 #include <Dialog.h>
 #include <Nullable.h>
 #include <Utilities.h>
+#include <ZapEngine.h>
+
+class ZapCancel;
+class ZapScheduler;
 
 //
 // CLevelZapContextMenuExt
@@ -79,24 +83,24 @@ public:
 
 private:
     FolderV             m_vFolders;     // List of folders to "zap".
-	HRESULT				FindFiles(const HWND p_hParentWnd,
-									CString szTo,
-									CString szFromPath,
-									CString& szlFrom,
-									CString& szlTo) const;
 
     Nullable<UINT>      m_FirstCmdId;   // ID of first command menu item.
     Nullable<UINT>      m_ZapCmdId;     // ID of our "zap" command.
+    Nullable<UINT>      m_UnzapCmdId;   // ID of our "un-zap" command, if a zap into the folder can be undone.
+
+    struct ZapRequest;
 
     HRESULT             ZapAllFolders(const HWND p_hParentWnd) const;
-    HRESULT             ZapFolder(const HWND p_hParentWnd,
-                                  CString p_Folder,
-                                  bool& p_rYesToAll) const;
-	HRESULT				MoveFile(const HWND p_hParentWnd,
-											CString p_Path,
-											CString p_FolderTo) const;
-	HRESULT				DeleteFolder(const HWND p_hParentWnd,
-											CString p_Path) const;
+    static unsigned __stdcall ZapThreadProc(void* pParam);
+    static HRESULT      ZapFolders(const ZapRequest& p_Request);
+    static HRESULT      WaitForZaps(const HWND p_hParentWnd,
+                                    ZapScheduler& p_rScheduler,
+                                    const ZapStats& p_Stats,
+                                    ZapCancel& p_rCancel);
+    bool                ConfirmFolder(const HWND p_hParentWnd,
+                                      CString p_Folder,
+                                      bool& p_rYesToAll) const;
+    HRESULT             UnzapFolder(const HWND p_hParentWnd) const;
 	BOOL				m_bRecursive;
 };
 
@@ -33,12 +33,11 @@ public:
 	static void		GetLastErrorEx();
 	static void		FormatMessageEx(DWORD dw);
 	static int		GetVersionEx2();
-	static CString	PathFindFolderName(CString szPath);
-	static CString	PathFindPreviousComponent(CString szPath);
-	static HRESULT	MoveFolderEx(CString& szFrom, CString& szTo);
-	static BOOL		PathFindFile(CString _szPath, CString _szFile, BOOL bRecursive = true);
-	static BOOL		PathIsDirectoryEmptyEx(CString _szPath);
-	static DWORD	QueryDWORDValueEx(CString szValue);
-	static CString	QueryStringValueEx(CString szValue);
-	static LONG		QueryMultiStringValueEx(CString szValue, CAtlList<CString>& szArr);
+	static CString	PathFindFolderName(const CString& szPath);
+	static CString	PathFindPreviousComponent(const CString& szPath);
+	static CString	PathAppendGuid(const CString& szPath);
+	static HRESULT	MoveFolderEx(const CString& szFrom, CString& szTo);
+	static DWORD	QueryDWORDValueEx(const CString& szValue);
+	static CString	QueryStringValueEx(const CString& szValue);
+	static LONG		QueryMultiStringValueEx(const CString& szValue, CAtlList<CString>& szArr);
 };
\ No newline at end of file
@@ -0,0 +1,46 @@
+// ZapCancel.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+//
+// ZapCancel
+//
+// Cancellation token of one or more zaps. Cancel() may be called from any
+// thread. The engine looks at the token between directories while scanning
+// and between entries while moving, so an entry is never left half moved;
+// ZapEngine::Execute() then moves back what a cancelled zap had moved.
+//
+class ZapCancel
+{
+public:
+						ZapCancel();
+
+	void				Cancel();
+	bool				IsCancelled() const;
+
+private:
+	volatile LONG		m_lCancelled;	// Cancel() was called.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+						ZapCancel(const ZapCancel&);
+	ZapCancel&			operator=(const ZapCancel&);
+};
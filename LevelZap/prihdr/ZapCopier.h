@@ -0,0 +1,81 @@
+// ZapCopier.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+struct ZapMoveResult;
+class ZapStats;
+
+//
+// ZapCopier
+//
+// Moves files across volumes, where a rename is not possible. Large files
+// are copied unbuffered, with several overlapped chunks in flight, then their
+// alternate streams. Timestamps, attributes, owner and permissions are applied
+// in one batch by Finish(), and a source is only deleted once its copy is
+// complete. Copy() can be called from several
+// threads at once.
+//
+class ZapCopier
+{
+public:
+	enum {
+		CHUNK_SIZE = 1024 * 1024,				// Bytes per overlapped request.
+		CHUNK_COUNT = 4,						// Requests in flight per file.
+		UNBUFFERED_THRESHOLD = 4 * 1024 * 1024,	// Smaller files go through CopyFileEx.
+		SECTOR_ALIGNMENT = 64 * 1024			// Unbuffered write size granularity.
+	};
+
+							ZapCopier();
+
+	HRESULT					Copy(const CString& szFrom, const CString& szTo, size_t uEntry, bool bReplace);
+	void					Finish(std::vector<ZapMoveResult>& vResults);
+	void					SetStats(ZapStats* pStats);
+
+	ULONGLONG				GetBytesCopied() const;
+
+private:
+	struct Pending
+	{
+		size_t		uEntry;			// Plan index of the entry.
+		CString		szFrom;			// Source, deleted once the copy is complete.
+		CString		szTo;			// Copy.
+		FILETIME	ftCreation;		// Source creation time.
+		FILETIME	ftAccess;		// Source last access time.
+		FILETIME	ftWrite;		// Source last write time.
+		DWORD		dwAttributes;	// Source attributes.
+	};
+
+	static HRESULT			CopyUnbuffered(HANDLE hFrom, HANDLE hTo, ULONGLONG ullSize, LONGLONG& llCalls);
+	static HRESULT			CopyStreams(const CString& szFrom, const CString& szTo, LONGLONG& llCalls);
+	static HRESULT			CopyStream(const CString& szFrom, const CString& szTo, LONGLONG& llCalls);
+	static HRESULT			ApplyMetadata(const Pending& pending, LONGLONG& llCalls);
+	void					CountCalls(LONGLONG llCalls) const;
+
+	CComAutoCriticalSection	m_csPending;	// Protects m_vPending.
+	std::vector<Pending>	m_vPending;		// Copies waiting for their metadata.
+	volatile LONGLONG		m_llBytes;		// Bytes copied so far.
+	ZapStats*				m_pStats;		// Counters of the copies, or 0.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+							ZapCopier(const ZapCopier&);
+	ZapCopier&				operator=(const ZapCopier&);
+};
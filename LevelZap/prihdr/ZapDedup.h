@@ -0,0 +1,107 @@
+// ZapDedup.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <ZapMovePlan.h>
+
+class ZapCancel;
+class ZapStats;
+class ZapWorkPool;
+
+//
+// ZapDedup
+//
+// Finds the colliding files of a plan that hold the same bytes, so that the
+// redundant copies are dropped instead of moved. Only the files that share
+// their name and their size with another one are read: each of them is hashed
+// once, in parallel, through memory-mapped views, then files with the same
+// hash are compared byte for byte, so a hash collision never drops a file.
+//
+// Every candidate gets a content class; the entries of a collision are the
+// same when they have the same class. Compare() must run before the plan is
+// resolved, while the collision indexes are valid.
+//
+class ZapDedup
+{
+public:
+	enum {
+		NONE = 0xFFFFFFFF,				// No candidate.
+		VIEW_SIZE = 16 * 1024 * 1024,	// Bytes of a file mapped at once; a multiple of 64 KB.
+		PARALLEL_THRESHOLD = 4			// With fewer files to read, read on the calling thread.
+	};
+
+						ZapDedup(const ZapMovePlan& plan, const ZapTree* pParent);
+
+	void				SetStats(ZapStats* pStats);
+	void				SetCancel(const ZapCancel* pCancel);
+	HRESULT				Compare(const std::vector<ZapCollision>& vCollisions, UINT uThreads = 0);
+	bool				IsSame(size_t iMove, ZapCollision::Kind kind, size_t iOther) const;
+
+	size_t				GetHashedCount() const;
+	ULONGLONG			GetHashedBytes() const;
+
+private:
+	//
+	// Candidate
+	//
+	// File whose content is compared: a move of the plan or an entry of the
+	// destination folder.
+	//
+	struct Candidate
+	{
+		UINT		uNode;			// Node in the zapped tree, or in the destination tree.
+		bool		bParent;		// The node is in the destination tree.
+		ULONGLONG	ullSize;		// File size in bytes.
+		ULONGLONG	ullHash;		// Hash of the content.
+		HRESULT		hRes;			// Result of hashing; a failed candidate is never the same.
+		UINT		uClass;			// Content class, or 0 if unknown.
+	};
+
+	class StepTask;
+	typedef void (ZapDedup::*Step)(UINT uIndex);
+
+	void				RunSteps(UINT uThreads, Step step, size_t nSteps);
+	void				HashCandidate(UINT uIndex);
+	void				ClassifyRun(UINT uRun);
+	CString				GetPath(const Candidate& candidate) const;
+	bool				IsCancelled() const;
+
+	HRESULT				HashFile(const CString& szPath, ULONGLONG ullSize, ULONGLONG& ullHash) const;
+	HRESULT				CompareFiles(const CString& szPath1, const CString& szPath2,
+									 ULONGLONG ullSize, bool& bSame) const;
+
+	const ZapMovePlan&	m_Plan;			// Plan whose collisions are compared.
+	const ZapTree*		m_pParent;		// Destination folder scanned without recursion, or 0.
+	std::vector<Candidate> m_vCandidates;	// Files to compare.
+	std::vector<UINT>	m_vOrder;		// Candidates by size and hash.
+	std::vector<UINT>	m_vRuns;		// Start of each run of equal size and hash in m_vOrder, and its end.
+	std::vector<UINT>	m_vMoves;		// Candidate of each move, or NONE.
+	std::vector<UINT>	m_vParents;		// Candidate of each destination node, or NONE.
+	volatile LONGLONG	m_llHashed;		// Bytes hashed.
+	volatile LONG		m_lHashed;		// Files hashed.
+	ZapStats*			m_pStats;		// Counters of the comparison, or 0.
+	const ZapCancel*	m_pCancel;		// Token that stops the comparison, or 0.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+						ZapDedup(const ZapDedup&);
+	ZapDedup&			operator=(const ZapDedup&);
+};
@@ -0,0 +1,65 @@
+// ZapDirCache.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <ZapTree.h>
+
+#include <deque>
+
+//
+// ZapDirCache
+//
+// Open handles to the directories of a scanned tree, for handle-relative
+// calls. Each directory is opened relative to its parent's handle. At most a
+// fixed number of handles stay open; the oldest unused ones are closed to
+// make room. Safe to use from several threads.
+//
+class ZapDirCache
+{
+public:
+							ZapDirCache(const ZapTree& tree, UINT uBudget);
+							~ZapDirCache();
+
+	HANDLE					Acquire(UINT uNode);
+	void					Release(UINT uNode);
+
+private:
+	struct Entry
+	{
+		HANDLE		hDir;		// Directory handle, or 0 when closed.
+		LONG		lRefs;		// Callers using the handle.
+	};
+
+	HANDLE					Open(UINT uNode);
+	bool					Evict();
+
+	const ZapTree&			m_Tree;			// Tree the node indices refer to.
+	UINT					m_uBudget;		// Maximum number of open handles.
+	UINT					m_uOpen;		// Handles currently open.
+	std::vector<Entry>		m_vEntries;		// One entry per tree node.
+	std::deque<UINT>		m_dqOpened;		// Nodes in the order they were opened.
+	CComAutoCriticalSection	m_cs;			// Protects everything above.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+							ZapDirCache(const ZapDirCache&);
+	ZapDirCache&			operator=(const ZapDirCache&);
+};
@@ -0,0 +1,97 @@
+// ZapEngine.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <ZapExecutor.h>
+#include <ZapJob.h>
+#include <ZapMovePlan.h>
+#include <ZapStats.h>
+
+class ZapCancel;
+class ZapFilter;
+class ZapJournal;
+
+//
+// ZapOptions
+//
+// Settings of a zap. LoadOptions() fills them from the registry; the command
+// line tool then overrides them with its flags.
+//
+struct ZapOptions
+{
+	BOOL		bRecursive;		// Flatten subfolders too.
+	UINT		uDepth;			// Levels a recursive zap flattens; 0 flattens every level.
+	BOOL		bNativeMove;	// Rename entries one by one instead of one SHFileOperation batch.
+	BOOL		bReplace;		// Native moves replace existing destination entries.
+	UINT		uCollisionPolicy;	// ZapCollision::Policy applied before anything moves.
+	BOOL		bDedup;			// Colliding files identical to what keeps their name are not moved.
+	UINT		uScanThreads;	// Scan threads; 0 picks a default.
+	UINT		uQueueDepth;	// Native renames in flight; 0 picks a default.
+	UINT		uHandleBudget;	// Directory handles kept open; 0 picks a default.
+	UINT		uListBuffer;	// Largest directory query buffer, in KB; 0 picks a default.
+	BOOL		bJournal;		// Journal each zap so that it can be recovered if interrupted.
+	BOOL		bRollback;		// Recover() rolls interrupted zaps back instead of finishing them.
+	UINT		uUndoDepth;		// Journals kept to un-zap; 0 leaves undo to the Shell.
+};
+
+//
+// ZapEngine
+//
+// Zaps one folder: moves its content one level up, then deletes it. Has no UI
+// of its own; callers ask for confirmation first. Shared by the context menu
+// handler and the command line tool.
+//
+class ZapEngine
+{
+public:
+	explicit		ZapEngine(const ZapOptions& options);
+
+	static void		LoadOptions(ZapOptions& options);
+	static bool		SetCollisionPolicy(ZapOptions& options, const CString& szName);
+	static LPCWSTR	GetCollisionPolicyName(const ZapOptions& options);
+
+	void			SetCancel(const ZapCancel* p_pCancel);
+	bool			IsCancelled() const;
+	void			SetFilter(const ZapFilter* p_pFilter);
+
+	HRESULT			Zap(const HWND p_hParentWnd, CString p_Folder, ZapStats* p_pStats = 0) const;
+	HRESULT			Plan(CString p_Folder, ZapJob& p_rJob, ZapStats* p_pStats = 0) const;
+	HRESULT			Plan(CString p_Folder, const ZapTree* p_pParent, ZapJob& p_rJob, ZapStats* p_pStats = 0) const;
+	HRESULT			Execute(const HWND p_hParentWnd, ZapJob& p_rJob, ZapStats* p_pStats = 0) const;
+	HRESULT			Recover(const HWND p_hParentWnd, ZapStats* p_pStats = 0) const;
+	HRESULT			Unzap(const CString& p_Folder) const;
+	static bool		CanUnzap(const CString& p_Folder);
+
+private:
+	HRESULT			Run(const HWND p_hParentWnd, ZapJob& p_rJob, ZapJournal& p_rJournal, ZapStats* p_pStats) const;
+	HRESULT			Resume(const HWND p_hParentWnd, ZapJournal& p_rJournal, ZapJob& p_rJob, ZapStats* p_pStats) const;
+	HRESULT			Rollback(const ZapJournal& p_Journal, ZapJob& p_rJob) const;
+	HRESULT			MoveFile(const HWND p_hParentWnd, const ZapMovePlan& p_Plan, ZapJournal& p_rJournal,
+							 ZapStats* p_pStats) const;
+	HRESULT			CheckDestination(const ZapMovePlan& p_Plan) const;
+	HRESULT			RemoveFolder(const ZapTree& p_Tree, BOOL p_bRecursive, ZapStats* p_pStats) const;
+	HRESULT			DeleteFolder(const HWND p_hParentWnd, CString p_Path) const;
+
+	ZapOptions		m_Options;		// Settings of every zap run by this engine.
+	const ZapCancel* m_pCancel;		// Token that cancels the zaps, or 0.
+	const ZapFilter* m_pFilter;		// Rules for the entries the zaps leave out, or 0.
+};
@@ -0,0 +1,105 @@
+// ZapExecutor.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <ZapCopier.h>
+#include <ZapDirCache.h>
+#include <ZapMovePlan.h>
+#include <ZapStats.h>
+
+class ZapCancel;
+class ZapJournal;
+class ZapPathBuilder;
+
+//
+// ZapMoveResult
+//
+// Outcome of one planned move.
+//
+struct ZapMoveResult
+{
+	HRESULT		hr;				// Result of the move.
+	bool		bCopied;		// Entry crossed devices and was copied, then deleted.
+};
+
+//
+// ZapExecutor
+//
+// Executes a move plan with one direct rename per entry instead of handing the
+// whole list to SHFileOperation. Only entries that cross devices fall back to
+// copy and delete, through a ZapCopier. Every entry gets its own result.
+//
+// Renames can be kept in flight concurrently. Entries are split into lanes by
+// their case-folded destination name, and each lane runs in plan order. Two
+// entries aiming at the same name therefore always resolve the same way.
+//
+// Entries are renamed relative to open handles of their parent directory and
+// of the destination, so no full path is resolved per entry. Paths are only
+// built when a handle is not available.
+//
+class ZapExecutor
+{
+public:
+								ZapExecutor();
+
+	HRESULT						Execute(const ZapMovePlan& plan, UINT uQueueDepth = 1);
+	void						SetHandleBudget(UINT uBudget);
+	void						SetReplaceExisting(bool bReplace);
+	void						SetStats(ZapStats* pStats);
+	void						SetJournal(ZapJournal* pJournal);
+	void						SetCancel(const ZapCancel* pCancel);
+
+	const std::vector<ZapMoveResult>& GetResults() const;
+	size_t						GetFailedCount() const;
+	size_t						GetCopiedCount() const;
+
+private:
+	// THESE METHODS ARE NOT IMPLEMENTED.
+								ZapExecutor(const ZapExecutor&);
+	ZapExecutor&				operator=(const ZapExecutor&);
+
+private:
+	class LaneTask;
+
+	void						RunEntry(const ZapMovePlan& plan, size_t i, ZapPathBuilder& from, ZapPathBuilder& to);
+	void						RunLanes(const ZapMovePlan& plan, UINT uQueueDepth);
+	static UINT					GetLane(const ZapMove& move, UINT uLanes);
+	HRESULT						RenameEntry(HANDLE hParent, const ZapNode& node, const ZapMove& move) const;
+	void						MoveEntry(LPCWSTR pszFrom, LPCWSTR pszTo,
+										  bool bDirectory, bool bReplace, size_t i);
+	HRESULT						CopyEntry(const CString& szFrom, const CString& szTo,
+										  bool bDirectory, bool bReplace, size_t i);
+	void						Count(HRESULT hRes, bool bCopy) const;
+	static HRESULT				MoveTree(const CString& szFrom, const CString& szTo);
+
+	std::vector<ZapMoveResult>	m_vResults;		// One result per planned move.
+	size_t						m_nFailed;		// Entries that could not be moved.
+	size_t						m_nCopied;		// Entries moved by copy and delete.
+	ZapCopier					m_Copier;		// Cross-volume file moves.
+	UINT						m_uHandleBudget;	// Directory handles kept open.
+	bool						m_bReplace;		// Replace existing destination entries.
+	ZapDirCache*				m_pDirs;		// Source directory handles during Execute(), or 0.
+	HANDLE						m_hTo;			// Destination directory handle during Execute(), or 0.
+	ZapStats*					m_pStats;		// Counters of the moves, or 0.
+	ZapJournal*					m_pJournal;		// Journal recording the completed moves, or 0.
+	const ZapCancel*			m_pCancel;		// Token that stops the moves not started, or 0.
+};
@@ -0,0 +1,77 @@
+// ZapFilter.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+//
+// ZapFilter
+//
+// Include and exclude rules for the entries a zap moves, matched against
+// entry names without case. A rule is a glob: '*' matches any run of
+// characters and '?' any one character. An excluded entry stays where it
+// is, and an excluded directory is not even scanned. When there are include
+// rules, only the entries they match are moved; in a recursive zap, the
+// subdirectories are still flattened whatever their name.
+//
+// The rules are compiled into one DFA over classes of characters, so a name
+// is matched in a single pass, whatever the number of rules. Most names fall
+// into the dead state after a character or two.
+//
+class ZapFilter
+{
+public:
+	enum Result {
+		NONE = 0,
+		INCLUDED = 0x1,					// An include rule matches.
+		EXCLUDED = 0x2					// An exclude rule matches.
+	};
+
+	enum { MAX_STATES = 4096 };			// Larger automatons are refused.
+
+						ZapFilter();
+
+	void				Load();
+	void				Add(const CString& szPattern, bool bExclude);
+	HRESULT				Compile();
+
+	bool				IsEmpty() const;
+	DWORD				Match(LPCWSTR pszName, UINT cchName) const;
+	bool				IsExcluded(LPCWSTR pszName, UINT cchName, bool bMoved) const;
+	size_t				GetRuleCount() const;
+	size_t				GetStateCount() const;
+
+private:
+	enum { DEAD = 0, START = 1 };		// States every automaton has.
+
+	UINT				GetClass(WCHAR ch) const;
+	void				Close(std::vector<UINT>& vItems) const;
+
+	std::vector<CString> m_vRules;		// Patterns, upper-cased.
+	std::vector<bool>	m_vExclude;		// Each rule excludes; otherwise it includes.
+	bool				m_bIncludes;	// Some rule includes.
+	UINT				m_cchMin;		// Shortest name a rule can match.
+	UINT				m_uClasses;		// Character classes; class 0 is every character no rule names.
+	UINT				m_vAscii[128];	// Class of each ASCII character, both cases.
+	std::vector<WCHAR>	m_vWide;		// Other characters rules name, upper-cased and sorted.
+	std::vector<UINT>	m_vWideClass;	// Class of each of them.
+	std::vector<UINT>	m_vNext;		// Next state, by state and class.
+	std::vector<BYTE>	m_vAccept;		// Result of each state.
+};
@@ -0,0 +1,83 @@
+// ZapJob.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <ZapMovePlan.h>
+
+//
+// ZapForecast
+//
+// What executing a planned zap is expected to do.
+//
+struct ZapForecast
+{
+	size_t		nRenames;		// Moves expected to be renames.
+	size_t		nCopies;		// Moves expected to cross devices, hence copy and delete.
+	size_t		nReplaced;		// Moves replacing an existing entry.
+	size_t		nSkipped;		// Entries left in the folder to settle collisions.
+	size_t		nCollisions;	// Collisions found while planning.
+	ULONGLONG	ullBytes;		// Bytes in the moved files.
+	ULONGLONG	ullCopyBytes;	// Bytes expected to be copied.
+};
+
+//
+// ZapJob
+//
+// A planned zap: the scanned folder, its resolved move plan, and whether the
+// folder has to be renamed out of the way first. ZapEngine::Plan() builds it
+// and ZapEngine::Execute() runs it, so a zap can be previewed before anything
+// moves. Save() writes it in a flat binary format that Load() maps back in,
+// so a large plan can be kept, inspected and run later without a rescan.
+//
+class ZapJob
+{
+public:
+						ZapJob();
+
+	const CString&		GetFolder() const;
+	UINT				GetDepth() const;
+	BOOL				NeedsRename() const;
+	bool				IsRestored() const;
+	const ZapTree&		GetTree() const;
+	const ZapMovePlan&	GetPlan() const;
+
+	bool				IsCopy(size_t i) const;
+	void				GetForecast(ZapForecast& forecast) const;
+
+	HRESULT				Save(const CString& szPath) const;
+	HRESULT				Load(const CString& szPath);
+
+private:
+	friend class ZapEngine;
+
+	CString				m_szFolder;		// Folder to zap, as it was planned.
+	UINT				m_uDepth;		// Levels flattened; ZapTree::ALL_LEVELS for every level.
+	BOOL				m_bRename;		// A move takes the folder's own name; rename the folder first.
+	bool				m_bRestored;	// Loaded from a file; the folder may have changed since.
+	size_t				m_nCollisions;	// Collisions found while planning.
+	ZapTree				m_Tree;			// Scanned folder.
+	ZapMovePlan			m_Plan;			// Resolved moves.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+						ZapJob(const ZapJob&);
+	ZapJob&				operator=(const ZapJob&);
+};
@@ -0,0 +1,104 @@
+// ZapJournal.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+class ZapJob;
+
+//
+// ZapJournal
+//
+// Write-ahead journal of one zap, so that a zap cut short by a crash or a
+// power loss can be finished or undone on the next run without a rescan.
+//
+// The plan of the job is saved next to the journal and flushed before
+// anything moves. Then the journal records the intent to rename the folder,
+// the moves as they complete, and the end of the moves. A zap that was not
+// interrupted either commits, which deletes both files, or keeps them as its
+// undo record; the last few undo records of each destination are kept.
+//
+// Completed moves are flushed in groups, so durability costs one flush per
+// group rather than one per entry. A move that completed after the last
+// flush is not lost: recovery finds it by looking at the source and the
+// destination of the moves not recorded. A torn record at the end of the
+// journal fails its checksum and is ignored.
+//
+// The journal is held open exclusively while its zap runs; recovery skips
+// the journals it cannot open, as their zaps are still running. A zap run
+// without a journal file is tracked in memory, so that it can still be
+// rolled back when it is cancelled.
+//
+class ZapJournal
+{
+public:
+						ZapJournal();
+						~ZapJournal();
+
+	HRESULT				Begin(const ZapJob& job);
+	void				Track(const ZapJob& job);
+	HRESULT				Rename(const CString& szTo);
+	void				Done(size_t i);
+	HRESULT				Moved(bool bAll);
+	void				Commit();
+	void				Keep(UINT nDepth);
+	bool				IsOpen() const;
+	bool				IsTracking() const;
+
+	static HRESULT		FindPending(std::vector<CString>& vPaths);
+	static HRESULT		FindUndo(const CString& szDestination, std::vector<CString>& vPaths);
+	HRESULT				Open(const CString& szPath);
+	const CString&		GetPlanPath() const;
+	const CString&		GetFolder() const;
+	bool				IsPlanned() const;
+	const CString&		GetRenamed() const;
+	bool				IsMoved() const;
+	bool				IsDone(size_t i) const;
+	bool				IsRecorded(size_t i) const;
+
+private:
+	enum { DONE_BATCH = 4096 };			// Completed moves written and flushed at once.
+
+	static CString		GetDirectory();
+	static DWORD		GetDestinationHash(const CString& szDestination);
+	static void			Prune(const CString& szPrefix, UINT nDepth);
+	void				Append(DWORD dwType, DWORD dwValue, const CString& szText);
+	HRESULT				Flush();
+	void				Close();
+
+	CComAutoCriticalSection	m_cs;		// Serializes the records of concurrent moves.
+	HANDLE				m_hFile;		// Journal file, or INVALID_HANDLE_VALUE.
+	CString				m_szPath;		// Path of the journal file.
+	CString				m_szPlanPath;	// Path of the saved plan.
+	std::vector<BYTE>	m_vBuffer;		// Records not written yet.
+	size_t				m_nPending;		// Completed moves in m_vBuffer.
+	bool				m_bFailed;		// A write failed; nothing more is recorded.
+	bool				m_bPlanned;		// The plan was saved completely.
+	bool				m_bTracking;	// Moves are followed in memory, without a file.
+	CString				m_szFolder;		// Folder zapped, as it was planned.
+	CString				m_szRenamed;	// Name the folder is renamed to, if it is.
+	bool				m_bMoved;		// Every move was attempted.
+	bool				m_bAllMoved;	// Every move succeeded.
+	std::vector<bool>	m_vDone;		// Moves recorded as completed, by plan index.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+						ZapJournal(const ZapJournal&);
+	ZapJournal&			operator=(const ZapJournal&);
+};
@@ -0,0 +1,124 @@
+// ZapLog.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+//
+// Compile-time log level. Messages above it are compiled out, arguments
+// included. Debug builds keep everything; release builds drop per-entry
+// tracing. Define ZAP_LOG_MAX_LEVEL before including this header to change it.
+//
+#define ZAP_LOG_LEVEL_ERROR		1
+#define ZAP_LOG_LEVEL_WARNING	2
+#define ZAP_LOG_LEVEL_INFO		3
+#define ZAP_LOG_LEVEL_TRACE		4
+
+#ifndef ZAP_LOG_MAX_LEVEL
+#ifdef _DEBUG
+#define ZAP_LOG_MAX_LEVEL		ZAP_LOG_LEVEL_TRACE
+#else
+#define ZAP_LOG_MAX_LEVEL		ZAP_LOG_LEVEL_INFO
+#endif
+#endif
+
+// Arguments are only evaluated when the level is enabled at run time.
+#define ZAP_LOG(level, ...) \
+	do { if (ZapLog::IsEnabled(level)) ZapLog::Write(level, __VA_ARGS__); } while (0)
+
+#if ZAP_LOG_MAX_LEVEL >= ZAP_LOG_LEVEL_ERROR
+#define ZAP_LOG_ERROR(...)		ZAP_LOG(ZAP_LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define ZAP_LOG_ERROR(...)		((void) 0)
+#endif
+
+#if ZAP_LOG_MAX_LEVEL >= ZAP_LOG_LEVEL_WARNING
+#define ZAP_LOG_WARNING(...)	ZAP_LOG(ZAP_LOG_LEVEL_WARNING, __VA_ARGS__)
+#else
+#define ZAP_LOG_WARNING(...)	((void) 0)
+#endif
+
+#if ZAP_LOG_MAX_LEVEL >= ZAP_LOG_LEVEL_INFO
+#define ZAP_LOG_INFO(...)		ZAP_LOG(ZAP_LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define ZAP_LOG_INFO(...)		((void) 0)
+#endif
+
+#if ZAP_LOG_MAX_LEVEL >= ZAP_LOG_LEVEL_TRACE
+#define ZAP_LOG_TRACE(...)		ZAP_LOG(ZAP_LOG_LEVEL_TRACE, __VA_ARGS__)
+#else
+#define ZAP_LOG_TRACE(...)		((void) 0)
+#endif
+
+//
+// ZapLog
+//
+// Log shared by the whole module. Nothing is formatted unless a sink is
+// attached and the level is enabled; enabled messages are formatted into a
+// fixed-size slot of a lock-free ring, and written to the sinks by Flush(),
+// which the engine calls between phases. Writers never block: when the ring
+// is full, the writer tries to flush it, and drops its message if another
+// thread is already flushing.
+//
+class ZapLog
+{
+public:
+	enum Sink {
+		SINK_DEBUGGER = 0x1,	// OutputDebugString.
+		SINK_CONSOLE = 0x2		// Standard error.
+	};
+
+	enum {
+		SLOT_COUNT = 128,		// Messages the ring holds; a power of two.
+		SLOT_LENGTH = 512		// Characters per message, terminator included.
+	};
+
+	static void				Configure(int iLevel, DWORD dwSinks);
+	static void				LoadSettings();
+	static bool				IsEnabled(int iLevel) { return iLevel <= s_lLevel; }
+
+	static void				Write(int iLevel, const wchar_t* format, ...);
+	static void				WriteV(int iLevel, const wchar_t* format, va_list args);
+	static void				Flush();
+
+	static LONG				GetDroppedCount();
+
+private:
+	struct Slot
+	{
+		volatile LONG	lSequence;				// Ring position the slot is ready for, minus its index,
+												// so that a zeroed ring is empty.
+		int				iLevel;					// Level of the message.
+		WCHAR			szText[SLOT_LENGTH];	// Formatted message.
+	};
+
+	static Slot*			Claim(LONG& lPosition);
+
+	static volatile LONG	s_lLevel;		// Highest level enabled at run time; 0 when no sink is attached.
+	static volatile LONG	s_lSinks;		// Sink mask.
+	static Slot				s_vSlots[SLOT_COUNT];	// Ring; its pages are only committed once used.
+	static volatile LONG	s_lTail;		// Next position to claim.
+	static LONG				s_lHead;		// Next position to flush; owned by the flushing thread.
+	static volatile LONG	s_lFlushing;	// A thread is flushing.
+	static volatile LONG	s_lDropped;		// Messages dropped because the ring was full.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+							ZapLog();
+};
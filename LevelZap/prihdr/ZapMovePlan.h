@@ -0,0 +1,127 @@
+// ZapMovePlan.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <ZapTree.h>
+
+class ZapDedup;
+class ZapNameIndex;
+class ZapPathBuilder;
+
+//
+// ZapMove
+//
+// One planned move. The source path is not stored: it is rebuilt from the
+// shared parent entries of the tree when needed.
+//
+struct ZapMove
+{
+	UINT		uNode;			// Source entry in the tree.
+	LPCWSTR		pszName;		// Destination name, interned in the tree's string pool.
+	UINT		cchName;		// Length of the destination name.
+	bool		bReplace;		// Replace the destination entry; set when resolving collisions.
+};
+
+//
+// ZapCollision
+//
+// A planned move whose destination name is already taken.
+//
+struct ZapCollision
+{
+	//
+	// How a collision is resolved before anything moves
+	//
+	enum Policy {
+		ASK,					// Leave it to the move: the Shell asks, the executor fails the entry.
+		RENAME,					// Append " (2)", " (3)"... to the name.
+		PREFIX,					// Prefix the name with the folders it comes from.
+		KEEP_NEWER,				// Keep whichever file was written last.
+		KEEP_LARGER,			// Keep whichever file is larger.
+		SKIP,					// Leave the entry in the zapped folder.
+		FAIL,					// Fail the zap.
+		POLICY_COUNT
+	};
+
+	enum Kind {
+		FOLDER,					// The name is the zapped folder's own name.
+		PARENT,					// An entry of the destination folder has the name.
+		SIBLING					// An earlier move has the name; recursive zaps only.
+	};
+
+	Kind		kind;			// What the name collides with.
+	size_t		iMove;			// Colliding move.
+	size_t		iOther;			// Earlier move for SIBLING, node of the destination tree for PARENT.
+};
+
+//
+// ZapMovePlan
+//
+// List of moves for one zap. Replaces the double-null strings that used to be
+// grown entry by entry; those are only produced on demand for SHFileOperation.
+//
+class ZapMovePlan
+{
+public:
+						ZapMovePlan();
+
+	void				Build(const ZapTree& tree, const CString& szTo, UINT uDepth);
+	void				Restore(const ZapTree& tree, const CString& szTo,
+								const std::vector<ZapMove>& vMoves, size_t nSkipped);
+
+	size_t				GetCount() const;
+	const ZapMove&		GetMove(size_t i) const;
+	const ZapTree&		GetTree() const;
+	const CString&		GetDestination() const;
+	CString				GetFromPath(size_t i) const;
+	CString				GetToPath(size_t i) const;
+	void				GetFromPath(size_t i, ZapPathBuilder& path) const;
+	void				GetToPath(size_t i, ZapPathBuilder& path) const;
+
+	size_t				GetFromList(CAtlArray<WCHAR>& buffer, bool bReplace) const;
+	size_t				GetToList(CAtlArray<WCHAR>& buffer, bool bReplace) const;
+
+	void				FindCollisions(const CString& szFolderName, const ZapTree* pParent,
+									   std::vector<ZapCollision>& vCollisions) const;
+	HRESULT				Resolve(ZapCollision::Policy policy, const ZapTree* pParent,
+								const std::vector<ZapCollision>& vCollisions, const ZapDedup* pDedup = 0);
+	size_t				GetSkippedCount() const;
+	size_t				GetDedupedCount() const;
+	ULONGLONG			GetDedupedBytes() const;
+
+	size_t				GetFootprint() const;
+	size_t				GetListFootprint() const;
+
+private:
+	enum { MAX_NAME = 255 };			// Longest name NTFS accepts.
+
+	void				AppendMoves(UINT uNode, UINT uLevel, UINT uDepth);
+	void				Rename(size_t i, const CString& szPrefix, ZapNameIndex& taken);
+	CString				GetPrefix(UINT uNode) const;
+
+	const ZapTree*		m_pTree;		// Tree the moves come from.
+	CString				m_szTo;			// Destination folder.
+	std::vector<ZapMove> m_vMoves;		// Planned moves, in walk order.
+	size_t				m_nSkipped;		// Moves dropped when resolving collisions.
+	size_t				m_nDeduped;		// Skipped moves of files identical to what holds their name.
+	ULONGLONG			m_ullDeduped;	// Bytes of those files.
+};
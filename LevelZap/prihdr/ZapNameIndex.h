@@ -0,0 +1,67 @@
+// ZapNameIndex.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+//
+// ZapNameIndex
+//
+// Hash table over entry names, compared the way NTFS compares them: each
+// UTF-16 unit is folded through the system upcase table. ASCII runs, the
+// common case, are folded eight units at a time. Names are not copied; they
+// must outlive the index, as interned tree names do.
+//
+class ZapNameIndex
+{
+public:
+	enum { NONE = UINT_MAX };
+
+						ZapNameIndex();
+
+	void				Reserve(size_t nNames);
+	UINT				Insert(LPCWSTR pszName, UINT cchName, UINT uValue);
+	UINT				Find(LPCWSTR pszName, UINT cchName) const;
+	size_t				GetCount() const;
+
+	static void			Fold(LPCWSTR pszName, UINT cchName, WCHAR* pDst);
+	static bool			Equals(LPCWSTR pszName1, UINT cchName1, LPCWSTR pszName2, UINT cchName2);
+	static UINT			Hash(LPCWSTR pszName, UINT cchName);
+
+private:
+	struct Entry
+	{
+		LPCWSTR			pszName;		// Name, not owned.
+		UINT			cchName;		// Length of the name.
+		UINT			uValue;			// Value given by the caller.
+	};
+
+	struct Slot
+	{
+		UINT			uHash;			// Hash of the folded name.
+		UINT			uEntry;			// Index in m_vEntries, or NONE if the slot is free.
+	};
+
+	UINT				Lookup(LPCWSTR pszName, UINT cchName, UINT uHash, size_t& iSlot) const;
+	void				Grow(size_t nSlots);
+
+	std::vector<Entry>	m_vEntries;		// Indexed names, in insertion order.
+	std::vector<Slot>	m_vSlots;		// Open addressing table; a power of two, at most half full.
+};
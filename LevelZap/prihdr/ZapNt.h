@@ -0,0 +1,67 @@
+// ZapNt.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+//
+// ZapNt
+//
+// Handle-relative file system calls, bound at run time from ntdll. A name is
+// resolved relative to an open directory handle, so the kernel does not walk
+// the whole path again for every entry of a deep tree.
+//
+class ZapNt
+{
+public:
+	//
+	// DirectoryEntry
+	//
+	// Layout of FILE_DIRECTORY_INFORMATION, as returned by QueryDirectory.
+	//
+	struct DirectoryEntry
+	{
+		ULONG			NextEntryOffset;
+		ULONG			FileIndex;
+		LARGE_INTEGER	CreationTime;
+		LARGE_INTEGER	LastAccessTime;
+		LARGE_INTEGER	LastWriteTime;
+		LARGE_INTEGER	ChangeTime;
+		LARGE_INTEGER	EndOfFile;
+		LARGE_INTEGER	AllocationSize;
+		ULONG			FileAttributes;
+		ULONG			FileNameLength;
+		WCHAR			FileName[1];
+	};
+
+	static bool		IsAvailable();
+
+	static HRESULT	OpenDirectory(const CString& szPath, HANDLE& hDir);
+	static HRESULT	OpenDirectory(HANDLE hParent, LPCWSTR pszName, UINT cchName, HANDLE& hDir);
+	static HRESULT	OpenForRename(HANDLE hParent, LPCWSTR pszName, UINT cchName, HANDLE& hFile);
+	static HRESULT	Rename(HANDLE hFile, HANDLE hToDir, LPCWSTR pszName, UINT cchName, bool bReplace);
+	static HRESULT	QueryDirectory(HANDLE hDir, void* pBuffer, ULONG cbBuffer, bool bRestart);
+
+private:
+	static HRESULT	Open(HANDLE hParent, LPCWSTR pszName, UINT cchName,
+						 DWORD dwAccess, ULONG uOptions, HANDLE& hFile);
+	static HRESULT	FromStatus(LONG lStatus);
+	static bool		Bind();
+};
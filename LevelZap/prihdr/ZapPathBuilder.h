@@ -0,0 +1,55 @@
+// ZapPathBuilder.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+//
+// ZapPathBuilder
+//
+// A path kept in one buffer that is reused from path to path. A walk pushes
+// a component when it descends and pops back to the saved length when it
+// returns. The buffer only grows; once it holds the longest path seen,
+// building a path no longer allocates.
+//
+class ZapPathBuilder
+{
+public:
+						ZapPathBuilder();
+
+	void				Reset(LPCWSTR pszRoot, UINT cchRoot);
+	void				Reset(const CString& szRoot);
+	UINT				Push(LPCWSTR pszName, UINT cchName);
+	void				Pop(UINT cchLength);
+	WCHAR*				SetLength(UINT cchLength);
+
+	LPCWSTR				GetString() const;
+	UINT				GetLength() const;
+
+private:
+	void				Reserve(UINT cchLength);
+
+	std::vector<WCHAR>	m_vBuffer;		// Path and terminator; never shrinks.
+	UINT				m_cchLength;	// Path length, without terminator.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+						ZapPathBuilder(const ZapPathBuilder&);
+	ZapPathBuilder&		operator=(const ZapPathBuilder&);
+};
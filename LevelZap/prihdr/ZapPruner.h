@@ -0,0 +1,71 @@
+// ZapPruner.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <ZapTree.h>
+
+class ZapPathBuilder;
+class ZapStats;
+class ZapWorkPool;
+
+//
+// ZapPruner
+//
+// Removes the directories a recursive zap emptied, below the zapped folder,
+// without enumerating anything: the scan already knows every directory it
+// flattened. A directory is removed once all its subdirectories are, so
+// independent subtrees are pruned in parallel on a work pool, deepest first.
+//
+// A directory that still holds something is kept and logged, and so are its
+// ancestors, which are not even tried. Directories holding entries the filter
+// excluded are kept the same way, without a try.
+//
+class ZapPruner
+{
+public:
+	enum { PARALLEL_THRESHOLD = 64 };	// With fewer leaf directories, prune on the calling thread.
+
+	explicit			ZapPruner(const ZapTree& tree);
+						~ZapPruner();
+
+	void				SetStats(ZapStats* pStats);
+	HRESULT				Prune(UINT uThreads = 0);
+	size_t				GetRemovedCount() const;
+	size_t				GetKeptCount() const;
+
+private:
+	class PruneTask;
+
+	void				Remove(UINT uWorker, UINT uNode);
+
+	const ZapTree&		m_Tree;			// Scan of the zapped folder.
+	std::vector<LONG>	m_vPending;		// Subdirectories of each directory not done yet.
+	std::vector<LONG>	m_vBlocked;		// A subdirectory of each directory was kept.
+	std::vector<ZapPathBuilder*> m_vPaths;	// Path buffer of each worker.
+	volatile LONG		m_lRemoved;		// Directories removed.
+	volatile LONG		m_lKept;		// Directories kept.
+	ZapStats*			m_pStats;		// Counters of the removals, or 0.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+						ZapPruner(const ZapPruner&);
+	ZapPruner&			operator=(const ZapPruner&);
+};
@@ -0,0 +1,100 @@
+// ZapScheduler.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <ZapEngine.h>
+#include <ZapNameIndex.h>
+
+class ZapWorkPool;
+
+//
+// ZapScheduler
+//
+// Zaps several folders at once on a work pool. Folders whose zaps overlap
+// run one after another, in the order they were added; the others run in
+// parallel. Two zaps overlap when one folder is inside the other, or when
+// they move entries with the same name into the same folder, or an entry
+// named like a folder zapped there.
+//
+// Overlaps are found from the plans of every folder, made in parallel before
+// anything moves, and merged into groups with a union-find. Each parent
+// folder is scanned once for all the folders zapped into it.
+//
+// Start() runs the zaps on a background thread, so that a UI can poll the
+// counters of the stats and cancel the engine while they run.
+//
+class ZapScheduler
+{
+public:
+	enum { DEFAULT_THREADS = 4 };	// Zaps run at once when none is given.
+
+	explicit			ZapScheduler(const ZapEngine& engine, UINT uThreads = 0);
+						~ZapScheduler();
+
+	void				Add(const CString& szFolder);
+	HRESULT				Run(const HWND p_hParentWnd, ZapStats* p_pStats = 0);
+	HRESULT				Start(const HWND p_hParentWnd, ZapStats* p_pStats = 0);
+	HRESULT				Wait(DWORD dwMilliseconds = INFINITE);
+
+	size_t				GetCount() const;
+	const CString&		GetFolder(size_t i) const;
+	HRESULT				GetResult(size_t i) const;
+	size_t				GetGroupCount() const;
+
+private:
+	class StepTask;
+	typedef void (ZapScheduler::*Step)(UINT uIndex);
+
+	static unsigned __stdcall ThreadProc(void* pParam);
+
+	UINT				Find(UINT i);
+	void				Union(UINT i, UINT j);
+	UINT				GetParentSlot(const CString& szParent);
+	void				RunSteps(ZapWorkPool& pool, Step step, size_t nSteps);
+
+	void				ScanParent(UINT uSlot);
+	void				PlanFolder(UINT i);
+	void				ZapGroup(UINT uGroup);
+
+	typedef CAtlMap<CString, UINT, CStringElementTraitsI<CString> > PathMap;
+
+	const ZapEngine&	m_Engine;		// Engine running the zaps.
+	UINT				m_uThreads;		// Zaps run at once.
+	HWND				m_hParentWnd;	// Parent window of the Shell UI, or 0.
+	ZapStats*			m_pStats;		// Counters and phase times of every zap, or 0.
+	std::vector<CString> m_vFolders;	// Folders to zap, in order.
+	std::vector<HRESULT> m_vResults;	// Result of each folder.
+	std::vector<UINT>	m_vUnion;		// Union-find parent of each folder.
+	std::vector<ZapJob*> m_vJobs;		// Plan of each folder, or 0.
+	std::vector<std::vector<UINT> > m_vLandings;	// Slots of the folders the content of each folder ends up in.
+	PathMap				m_Slots;		// Slot of each parent folder, by path.
+	std::vector<CString> m_vParents;	// Parent folder of each slot.
+	std::vector<ZapTree*> m_vTrees;		// Scan of each parent folder, or 0 if it failed.
+	std::vector<ZapNameIndex> m_vNames;	// Names moved into each parent folder, with the folder moving them.
+	std::vector<std::vector<UINT> > m_vGroups;	// Overlapping folders, in order.
+	HANDLE				m_hThread;		// Thread running Start(), or 0.
+	HRESULT				m_hRun;			// Result of Run() on that thread.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+						ZapScheduler(const ZapScheduler&);
+	ZapScheduler&		operator=(const ZapScheduler&);
+};
@@ -0,0 +1,69 @@
+// ZapSettings.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+//
+// ZapSettings
+//
+// Immutable snapshot of every value under HKCU\Software\LevelZap. Current()
+// returns the latest snapshot without taking a lock; the key is only read
+// again after RegNotifyChangeKeyValue reports a change, or looked for once a
+// second while it does not exist. Snapshots that have been replaced stay
+// valid until the module unloads, so callers can keep the reference for the
+// duration of a zap; a read that finds the same values keeps the snapshot.
+//
+class ZapSettings
+{
+public:
+	static const ZapSettings&	Current();
+
+	DWORD						GetDWORD(LPCWSTR pszName, DWORD dwDefault = 0) const;
+	CString						GetString(LPCWSTR pszName) const;
+	bool						GetMultiString(LPCWSTR pszName, CAtlList<CString>& lStrings) const;
+
+private:
+	struct Value
+	{
+		DWORD					dwType;		// REG_DWORD, REG_SZ, REG_EXPAND_SZ or REG_MULTI_SZ.
+		DWORD					dwValue;	// REG_DWORD data.
+		CString					szValue;	// REG_SZ and REG_EXPAND_SZ data.
+		std::vector<CString>	vValues;	// REG_MULTI_SZ data.
+	};
+
+	typedef CAtlMap<CString, Value, CStringElementTraitsI<CString> > ValueMap;
+
+	class Watcher;
+
+								ZapSettings();
+
+	void						Load(HKEY hKey);
+	bool						Equals(const ZapSettings& other) const;
+	const Value*				Find(LPCWSTR pszName, DWORD dwType) const;
+
+	ValueMap					m_mValues;	// Values by case-insensitive name.
+
+	static Watcher				s_Watcher;	// Publishes the snapshots of this module.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+								ZapSettings(const ZapSettings&);
+	ZapSettings&				operator=(const ZapSettings&);
+};
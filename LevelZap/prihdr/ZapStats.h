@@ -0,0 +1,105 @@
+// ZapStats.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+//
+// ZapStats
+//
+// Counters and phase times of one or more zaps. Counters are updated with
+// interlocked operations from any thread; the engine adds per directory or
+// per entry, never per byte, so they can stay on in production. Phase times
+// are charged by a Clock owned by each zap.
+//
+class ZapStats
+{
+public:
+	enum Counter {
+		DIRECTORIES,		// Directories listed.
+		ENTRIES,			// Entries found while listing.
+		RENAMES,			// Entries moved by rename.
+		COPIES,				// Files moved by copy and delete.
+		BYTES,				// Bytes copied.
+		RETRIES,			// Operations retried another way after failing.
+		FAILURES,			// Operations that failed for good.
+		KERNEL_CALLS,		// File system calls issued.
+		COLLISIONS,			// Planned moves whose destination name was taken.
+		PLANNED,			// Moves about to be executed; progress is measured against it.
+		PRUNED,				// Emptied directories removed after a recursive zap.
+		EXCLUDED,			// Entries the filter left out while scanning.
+		HASHED,				// Bytes of colliding files hashed to find duplicates.
+		DEDUPED,			// Colliding files dropped as duplicates instead of moved.
+		DEDUP_BYTES,		// Bytes of the dropped duplicates.
+		COUNTER_COUNT
+	};
+
+	enum Phase {
+		SCAN,				// Scanning the folder.
+		COLLISION,			// Checking for and resolving the name collision.
+		PLAN,				// Planning the moves.
+		MOVE,				// Moving the content up.
+		CLEANUP,			// Checking what is left and deleting the folder.
+		DEDUP,				// Hashing and comparing colliding files.
+		PHASE_COUNT
+	};
+
+	//
+	// Clock
+	//
+	// Charges the wall and process CPU time between calls of Next() to the
+	// phases of one zap. Does nothing without stats.
+	//
+	class Clock
+	{
+	public:
+		explicit		Clock(ZapStats* pStats, bool bCount = true);
+		void			Next(Phase phase);
+
+	private:
+		ZapStats*		m_pStats;		// Stats to charge, or 0.
+		LONGLONG		m_llWall;		// Counter at the end of the previous phase.
+		LONGLONG		m_llCpu;		// CPU time at the end of the previous phase, in 100ns.
+	};
+
+						ZapStats();
+
+	void				Add(Counter counter, LONGLONG llValue = 1);
+	LONGLONG			Get(Counter counter) const;
+	LONGLONG			GetWallTime(Phase phase) const;
+	LONGLONG			GetCpuTime(Phase phase) const;
+	LONG				GetZapCount() const;
+
+	CString				ToJson() const;
+	HRESULT				WriteReport(const CString& szPath) const;
+
+private:
+	static LONGLONG		GetCpuTime();
+
+	volatile LONGLONG	m_vCounters[COUNTER_COUNT];	// Counter values.
+	volatile LONGLONG	m_vWall[PHASE_COUNT];		// Wall time per phase, in QueryPerformanceCounter ticks.
+	volatile LONGLONG	m_vCpu[PHASE_COUNT];		// Process CPU time per phase, in 100ns.
+	volatile LONG		m_lZaps;					// Zaps that charged time.
+	LONGLONG			m_llFrequency;				// QueryPerformanceCounter ticks per second.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+						ZapStats(const ZapStats&);
+	ZapStats&			operator=(const ZapStats&);
+};
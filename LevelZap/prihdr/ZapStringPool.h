@@ -0,0 +1,66 @@
+// ZapStringPool.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+//
+// ZapStringPool
+//
+// Bump allocator for the names of a zap. Strings are copied into large blocks
+// that are only released with the pool, and repeated names can be interned so
+// they are stored once.
+//
+class ZapStringPool
+{
+public:
+						ZapStringPool();
+						~ZapStringPool();
+
+	LPCWSTR				Store(LPCWSTR psz, UINT cch);
+	LPCWSTR				Intern(LPCWSTR psz, UINT cch);
+	void				Clear();
+	size_t				GetFootprint() const;
+
+private:
+	enum { BLOCK_CHARS = 16 * 1024 };
+
+	struct Atom
+	{
+		LPCWSTR			psz;		// Interned string, null-terminated.
+		UINT			cch;		// Length in characters.
+		UINT			uHash;		// Hash of the string.
+	};
+
+	WCHAR*				Allocate(UINT cch);
+	void				Grow();
+	static UINT			Hash(LPCWSTR psz, UINT cch);
+
+	std::vector<WCHAR*>	m_vBlocks;		// Allocated blocks.
+	WCHAR*				m_pNext;		// Next free character in the current block.
+	size_t				m_cchLeft;		// Free characters left in the current block.
+	size_t				m_cchAllocated;	// Characters allocated in all blocks.
+	std::vector<Atom>	m_vAtoms;		// Open-addressing table of interned strings.
+	size_t				m_nAtoms;		// Used slots in m_vAtoms.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+						ZapStringPool(const ZapStringPool&);
+	ZapStringPool&		operator=(const ZapStringPool&);
+};
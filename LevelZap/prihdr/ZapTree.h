@@ -0,0 +1,147 @@
+// ZapTree.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <ZapStringPool.h>
+
+#include <deque>
+
+class ZapCancel;
+class ZapFilter;
+class ZapPathBuilder;
+class ZapStats;
+class ZapWorkPool;
+
+//
+// ZapNode
+//
+// One entry of a scanned folder. The children of a directory are stored
+// contiguously, in the order the file system returned them.
+//
+struct ZapNode
+{
+	LPCWSTR		pszName;		// Entry name, without path; owned by the tree's string pool.
+	UINT		cchName;		// Length of the name in characters.
+	DWORD		dwAttributes;	// File attributes.
+	ULONGLONG	ullSize;		// File size in bytes.
+	FILETIME	ftWrite;		// Last write time.
+	UINT		uParent;		// Index of parent node; root is its own parent.
+	UINT		uFirstChild;	// Index of first child node.
+	UINT		uChildCount;	// Number of children.
+	bool		bScanned;		// Directory content was enumerated successfully.
+	bool		bExcluded;		// Left out by the filter; an excluded directory is not scanned.
+
+	bool		IsDirectory() const { return (dwAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0; }
+};
+
+//
+// ZapTree
+//
+// In-memory model of a folder to zap, built with a single walk of the file system.
+// Answers the name collision, move list and emptiness questions of a zap without
+// enumerating the folder again.
+//
+// Directories are listed with as few round trips as the file system allows.
+// The query buffer starts small and doubles, up to the list buffer size, for
+// as long as a directory fills it, so a directory of millions of entries is
+// read a few megabytes at a time while small directories stay cheap.
+//
+// A scan descends as deep as the zap flattens: the directories below the
+// zapped folder, down to the depth of the zap, are listed, while those at
+// that depth are moved as a whole and are not.
+//
+class ZapTree
+{
+public:
+	enum {
+		ROOT = 0,
+		ALL_LEVELS = 0,					// Depth of a zap that flattens every level.
+		DEFAULT_HANDLE_BUDGET = 256,	// Shared directory handles a scan keeps open.
+		DEFAULT_LIST_BUFFER = 4096		// Largest directory query buffer, in KB.
+	};
+
+					ZapTree();
+
+	HRESULT			Scan(const CString& szRoot, UINT uDepth, UINT uThreads = 1);
+	void			Restore(const CString& szRoot, const std::vector<ZapNode>& vNodes);
+	void			SetHandleBudget(UINT uBudget);
+	void			SetListBuffer(UINT uSize);
+	void			SetStats(ZapStats* pStats);
+	void			SetCancel(const ZapCancel* pCancel);
+	void			SetFilter(const ZapFilter* pFilter);
+
+	const CString&	GetRoot() const;
+	void			SetRoot(const CString& szRoot);
+	CString			GetPath(UINT uNode) const;
+	void			GetPath(UINT uNode, ZapPathBuilder& path) const;
+	UINT			GetPathLength(UINT uNode) const;
+	void			CopyPath(UINT uNode, WCHAR* pDst, UINT cch) const;
+	size_t			GetCount() const;
+	const ZapNode&	GetNode(UINT uNode) const;
+
+	BOOL			IsEmpty() const;
+	BOOL			IsComplete(UINT uDepth) const;
+	UINT			GetLevel(UINT uNode) const;
+
+	static bool		IsFlattened(UINT uDepth, UINT uLevel);
+
+	ZapStringPool&	GetPool() const;
+	size_t			GetFootprint() const;
+
+private:
+	enum { LIST_BUFFER_SIZE = 64 * 1024 };	// Bytes read by the first query of a directory.
+
+	struct Listing;
+	struct DirHandle;
+	struct Folder;
+	class ScanTask;
+
+	HRESULT			ScanFolder(UINT uNode, UINT uLevel, const CString& szPath, UINT cchName, DirHandle* pParent,
+							   Listing& listing, DirHandle*& pDir, UINT& uFirstChild);
+	static HANDLE	OpenFolder(HANDLE hParent, const CString& szPath, UINT cchName);
+	DirHandle*		ShareFolder(HANDLE hDir, size_t nFolders);
+	static void		ReleaseFolders(DirHandle* pDir, size_t nFolders);
+	static HRESULT	ListFolder(const CString& szPath, HANDLE hDir, ULONG cbMax, Listing& listing);
+	static HRESULT	FindFolder(const CString& szPath, Listing& listing);
+	void			Exclude(UINT uLevel, Listing& listing) const;
+	UINT			Attach(UINT uNode, const Listing& listing);
+	void			SubmitFolders(ZapWorkPool& pool, UINT uWorker, UINT uFirstChild, UINT uLevel,
+								  const CString& szPath, const Listing& listing, DirHandle* pDir);
+	void			QueueFolders(std::deque<Folder>& qFolders, UINT uFirstChild, UINT uLevel,
+								 const CString& szPath, const Listing& listing, DirHandle* pDir) const;
+
+	CString					m_szRoot;		// Path of the scanned folder.
+	std::vector<ZapNode>	m_vNodes;		// Scanned entries; m_vNodes[ROOT] is the folder itself.
+	mutable ZapStringPool	m_Pool;			// Entry names, interned.
+	CComAutoCriticalSection	m_csNodes;		// Protects m_vNodes and m_Pool during a parallel scan.
+	UINT					m_uHandleBudget;	// Maximum number of shared directory handles.
+	ULONG					m_cbListBuffer;	// Largest directory query buffer, in bytes.
+	volatile LONG			m_lHandles;		// Shared directory handles currently open.
+	ZapStats*				m_pStats;		// Counters of the scan, or 0.
+	const ZapCancel*		m_pCancel;		// Token that stops the scan, or 0.
+	const ZapFilter*		m_pFilter;		// Rules excluding entries from the scan, or 0.
+	UINT					m_uDepth;		// Levels the running scan flattens; ALL_LEVELS for every level.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+					ZapTree(const ZapTree&);
+	ZapTree&		operator=(const ZapTree&);
+};
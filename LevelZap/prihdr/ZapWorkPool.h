@@ -0,0 +1,94 @@
+// ZapWorkPool.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <deque>
+
+class ZapWorkPool;
+
+//
+// ZapTask
+//
+// Unit of work run by a ZapWorkPool. Tasks are allocated with new and deleted
+// by the pool once they have run.
+//
+class ZapTask
+{
+public:
+	virtual				~ZapTask() {}
+
+						//
+						// Runs the task.
+						//
+						// @param p_Pool Pool running the task; new tasks can be submitted to it.
+						// @param p_uWorker Index of the worker running the task.
+						//
+	virtual void		Run(ZapWorkPool& p_Pool, UINT p_uWorker) = 0;
+};
+
+//
+// ZapWorkPool
+//
+// Work-stealing thread pool. Each worker owns a deque: it takes its own tasks
+// newest first, and steals the oldest tasks of other workers when it runs dry.
+// Tasks submitted by a running task go to the deque of its worker, so a walk
+// stays local until other workers need something to do.
+//
+class ZapWorkPool
+{
+public:
+	explicit			ZapWorkPool(UINT uThreads = 0);
+						~ZapWorkPool();
+
+	void				Submit(ZapTask* pTask);
+	void				Submit(ZapTask* pTask, UINT uWorker);
+	void				Wait();
+
+	UINT				GetThreadCount() const;
+	static UINT			GetDefaultThreadCount();
+
+private:
+	struct Worker
+	{
+		ZapWorkPool*			pPool;		// Owning pool.
+		UINT					uIndex;		// Index in m_vWorkers.
+		HANDLE					hThread;	// Worker thread.
+		CComAutoCriticalSection	cs;			// Protects dqTasks.
+		std::deque<ZapTask*>	dqTasks;	// Pending tasks of this worker.
+	};
+
+	static unsigned __stdcall ThreadProc(void* pParam);
+	void				WorkerLoop(UINT uIndex);
+	ZapTask*			Pop(UINT uIndex);
+	ZapTask*			Steal(UINT uIndex);
+
+	std::vector<Worker*> m_vWorkers;	// Workers, one thread each.
+	HANDLE				m_hWork;		// Semaphore released once per submitted task.
+	HANDLE				m_hIdle;		// Set when the last pending task finishes.
+	volatile LONG		m_lPending;		// Submitted tasks that have not finished.
+	volatile LONG		m_lNext;		// Round-robin target of outside submissions.
+	volatile LONG		m_lShutdown;	// Workers must exit.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+						ZapWorkPool(const ZapWorkPool&);
+	ZapWorkPool&		operator=(const ZapWorkPool&);
+};
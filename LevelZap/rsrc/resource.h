@@ -20,6 +20,13 @@
 #define IDS_ZAP_CONTENT                 111
 #define IDS_LEVEL_2                     112
 #define IDS_LEVEL_OLD_2                 113
+#define IDS_UNZAP_MENU_ITEM_DESCRIPTION 114
+#define IDS_UNZAP_MENU_ITEM_HINT        115
+#define IDS_ZAP_PROGRESS_TITLE          116
+#define IDS_ZAP_PROGRESS_SCANNED        117
+#define IDS_ZAP_PROGRESS_MOVED          118
+#define IDS_ZAP_PROGRESS_CANCELLING     119
+#define IDS_ZAP_FILTER_ERROR            120
 #define IDS_ZAP_CONFIRM_MESSAGE_1       202
 #define IDS_ZAP_CONFIRM_MESSAGE_2       203
 
@@ -24,11 +24,23 @@
 
 #include <StStgMedium.h>
 #include <ArrayAutoPtr.h>
+#include <ZapCancel.h>
+#include <ZapFilter.h>
+#include <ZapLog.h>
+#include <ZapScheduler.h>
+#include <ZapSettings.h>
 #include <Dbghelp.h>
 
 #include <assert.h>
+#include <process.h>
 #include <sstream>
 
+namespace {
+
+	// Milliseconds between two updates of the progress dialog.
+	const DWORD PROGRESS_INTERVAL = 250;
+}
+
 // CLevelZapContextMenuExt
 
 //
@@ -37,7 +49,8 @@
 CLevelZapContextMenuExt::CLevelZapContextMenuExt()
 	: m_vFolders(),
 	  m_FirstCmdId(),
-	  m_ZapCmdId()
+	  m_ZapCmdId(),
+	  m_UnzapCmdId()
 {
 }
 
@@ -140,6 +153,16 @@ STDMETHODIMP CLevelZapContextMenuExt::QueryContextMenu(
 					hRes = E_FAIL;
 				}
 
+				// Insert "un-zap" menu item when the last zap into this folder can be undone.
+				if (SUCCEEDED(hRes) && m_vFolders.size() == 1 && ZapEngine::CanUnzap(m_vFolders.front())) {
+					CString unzapMenuDesc(MAKEINTRESOURCE(IDS_UNZAP_MENU_ITEM_DESCRIPTION));
+					if (::InsertMenu(p_hMenu, position, MF_STRING | MF_BYPOSITION, cmdId, unzapMenuDesc)) {
+						m_UnzapCmdId = cmdId;
+						++cmdId;
+						++position;
+					}
+				}
+
 				if (SUCCEEDED(hRes)) {
 					// Strange return value requirement... see MSDN for details.
 					hRes = MAKE_HRESULT(SEVERITY_SUCCESS, 0, cmdId - p_FirstCmdId + 1);
@@ -167,7 +190,9 @@ STDMETHODIMP CLevelZapContextMenuExt::InvokeCommand(
 {
 	HRESULT hRes = S_OK;
 	m_bRecursive = (GetKeyState(VK_CONTROL)&0x80);
-	if (m_bRecursive) {
+	bool bUnzap = p_pCommandInfo != 0 && m_FirstCmdId.HasValue() && m_UnzapCmdId.HasValue()
+		&& m_UnzapCmdId == (UINT) p_pCommandInfo->lpVerb + m_FirstCmdId;
+	if (m_bRecursive && !bUnzap) {
 		// Confirm action
 		CString folderName = Util::PathFindFolderName(m_vFolders.at(0));
 		CString confirmMsg1(MAKEINTRESOURCE(IDS_LEVEL_1));
@@ -198,6 +223,9 @@ STDMETHODIMP CLevelZapContextMenuExt::InvokeCommand(
 				if (m_ZapCmdId.HasValue() && m_ZapCmdId == cmdId) {
 					// Zap everything.
 					hRes = ZapAllFolders((p_pCommandInfo->fMask & CMIC_MASK_FLAG_NO_UI) == 0 ? p_pCommandInfo->hwnd : 0);
+				} else if (m_UnzapCmdId.HasValue() && m_UnzapCmdId == cmdId) {
+					// Undo the last zap into the folder.
+					hRes = UnzapFolder((p_pCommandInfo->fMask & CMIC_MASK_FLAG_NO_UI) == 0 ? p_pCommandInfo->hwnd : 0);
 				} else {
 					// Invalid command ID.
 					hRes = E_INVALIDARG;
@@ -208,7 +236,8 @@ STDMETHODIMP CLevelZapContextMenuExt::InvokeCommand(
 		hRes = E_UNEXPECTED;
 	}
 
-	Util::OutputDebugStringEx(L"RETURN 0x%08x\n", hRes);
+	ZAP_LOG_INFO(L"RETURN 0x%08x\n", hRes);
+	ZapLog::Flush();
 	return hRes;
 }
 
@@ -245,6 +274,8 @@ STDMETHODIMP CLevelZapContextMenuExt::GetCommandString(
 			// We need to validate command ID.
 			if (m_FirstCmdId.HasValue() && m_ZapCmdId.HasValue() && m_ZapCmdId == (m_FirstCmdId + p_CmdId)) {
 				hRes = S_OK;
+			} else if (m_FirstCmdId.HasValue() && m_UnzapCmdId.HasValue() && m_UnzapCmdId == (m_FirstCmdId + p_CmdId)) {
+				hRes = S_OK;
 			} else {
 				hRes = S_FALSE;
 			}
@@ -274,6 +305,12 @@ STDMETHODIMP CLevelZapContextMenuExt::GetCommandString(
 					if (::wcscpy_s((LPWSTR) p_pBuffer, p_BufferSize, zapItemHint) != 0) {
 						hRes = E_FAIL;
 					}
+				} else if (m_FirstCmdId.HasValue() && m_UnzapCmdId.HasValue() && m_UnzapCmdId == (m_FirstCmdId + p_CmdId)) {
+					// Return help text for our un-zap item.
+					CStringW unzapItemHint(MAKEINTRESOURCE(IDS_UNZAP_MENU_ITEM_HINT));
+					if (::wcscpy_s((LPWSTR) p_pBuffer, p_BufferSize, unzapItemHint) != 0) {
+						hRes = E_FAIL;
+					}
 				} else {
 					hRes = E_INVALIDARG;
 				}
@@ -291,42 +328,215 @@ STDMETHODIMP CLevelZapContextMenuExt::GetCommandString(
 	return hRes;
 }
 
+//
+// CLevelZapContextMenuExt::ZapRequest
+//
+// Folders confirmed for zapping, copied out of the menu handler so that the
+// Shell can release it while they are zapped in the background.
+//
+struct CLevelZapContextMenuExt::ZapRequest
+{
+	HWND		hParentWnd;		// Parent window for dialog boxes, or 0.
+	FolderV		vFolders;		// Folders to zap.
+	BOOL		bRecursive;		// Flatten subfolders too.
+};
+
 //
 // ZapAllFolders
 //
-// Called when the contextual menu item is chosen. We scan all folders
-// we found at initialization time and "zap"'em.
+// Called when the contextual menu item is chosen. We ask for confirmation for
+// all folders we found at initialization time, then "zap"'em on a background
+// thread, so that Explorer is not frozen while they move; a progress dialog
+// shows how far they got and can cancel them. Without UI, the folders are
+// zapped before this returns.
 //
 // @param p_hParentWnd Handle of parent window for dialog boxes.
 //                     If this is set to 0, we will not show any UI.
-// @return Result code.
+// @return Result code; E_ABORT if some folders were not confirmed.
 //
 HRESULT CLevelZapContextMenuExt::ZapAllFolders(const HWND p_hParentWnd) const
 {
 	HRESULT hRes = S_OK;
-	bool yesToAll = !Util::QueryDWORDValueEx(L"PromptUser");
+	ZapLog::LoadSettings();
+	const ZapSettings& settings = ZapSettings::Current();
+	bool yesToAll = !settings.GetDWORD(L"PromptUser");
+
+	ZapRequest* pRequest = new ZapRequest;
+	pRequest->hParentWnd = p_hParentWnd;
+	pRequest->bRecursive = m_bRecursive;
 	FolderV::const_iterator it, end = m_vFolders.end();
 	for (it = m_vFolders.begin(); it != end; ++it) {
-		if (GetFileAttributes(*it)&FILE_ATTRIBUTE_DIRECTORY || m_bRecursive)
-			hRes = ZapFolder(p_hParentWnd, *it, yesToAll);
+		if (GetFileAttributes(*it)&FILE_ATTRIBUTE_DIRECTORY || m_bRecursive) {
+			if (ConfirmFolder(p_hParentWnd, *it, yesToAll))
+				pRequest->vFolders.push_back(*it);
+			else
+				hRes = E_ABORT;
+		}
+	}
+
+	// The module stays loaded until the background thread is done.
+	if (p_hParentWnd != 0 && !pRequest->vFolders.empty()) {
+		_pAtlModule->Lock();
+		HANDLE hThread = reinterpret_cast<HANDLE>(::_beginthreadex(0, 0, ZapThreadProc, pRequest, 0, 0));
+		if (hThread != 0) {
+			::CloseHandle(hThread);
+			return hRes;
+		}
+		_pAtlModule->Unlock();
+	}
+	HRESULT hZap = ZapFolders(*pRequest);
+	delete pRequest;
+	return FAILED(hZap) ? hZap : hRes;
+}
+
+//
+// ZapThreadProc
+//
+// Background thread zapping the folders of a request.
+//
+// @param pParam Request; deleted here.
+// @return 0.
+//
+unsigned __stdcall CLevelZapContextMenuExt::ZapThreadProc(void* pParam)
+{
+	ZapRequest* pRequest = static_cast<ZapRequest*>(pParam);
+	HRESULT hRes = ::CoInitializeEx(0, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+	bool bUninitialize = SUCCEEDED(hRes);
+	try {
+		hRes = ZapFolders(*pRequest);
+	} catch (...) {
+		hRes = E_UNEXPECTED;
+	}
+	ZAP_LOG_INFO(L"RETURN 0x%08x\n", hRes);
+	ZapLog::Flush();
+	delete pRequest;
+	if (bUninitialize)
+		::CoUninitialize();
+	_pAtlModule->Unlock();
+	return 0;
+}
+
+//
+// ZapFolders
+//
+// Zaps the folders of a request, those that do not overlap in parallel
+// (ZapThreads of them at a time). If the ReportPath setting is set, the
+// counters and phase times of the run are appended to that file. Nothing is
+// zapped if the Include and Exclude rules cannot be compiled.
+//
+// @param p_Request Folders to zap.
+// @return Result code; the first failure if some folders were not zapped.
+//
+HRESULT CLevelZapContextMenuExt::ZapFolders(const ZapRequest& p_Request)
+{
+	HRESULT hRes = S_OK;
+	const ZapSettings& settings = ZapSettings::Current();
+	ZapStats stats;
+
+	// Finish or roll back the zaps a crash interrupted, before anything else moves.
+	ZapOptions options;
+	ZapEngine::LoadOptions(options);
+	ZapEngine(options).Recover(p_Request.hParentWnd, &stats);
+
+	if (!p_Request.vFolders.empty()) {
+		options.bRecursive = p_Request.bRecursive;
+		ZapEngine engine(options);
+		ZapCancel cancel;
+		engine.SetCancel(&cancel);
+		ZapFilter filter;
+		filter.Load();
+		hRes = filter.Compile();
+		if (FAILED(hRes)) {
+			// A filter that matches nothing would move what the user excluded.
+			ZAP_LOG_ERROR(L"Filter 0x%08x | %Iu rules\n", hRes, filter.GetRuleCount());
+			if (p_Request.hParentWnd != 0) {
+				CString message(MAKEINTRESOURCE(IDS_ZAP_FILTER_ERROR));
+				CString caption(MAKEINTRESOURCE(IDS_ZAP_CONFIRM_CAPTION));
+				::MessageBox(p_Request.hParentWnd, message, caption, MB_OK | MB_ICONERROR);
+			}
+		} else {
+			engine.SetFilter(&filter);
+			ZapScheduler scheduler(engine, settings.GetDWORD(L"ZapThreads"));
+			FolderV::const_iterator it, end = p_Request.vFolders.end();
+			for (it = p_Request.vFolders.begin(); it != end; ++it)
+				scheduler.Add(*it);
+			hRes = scheduler.Start(p_Request.hParentWnd, &stats);
+			if (SUCCEEDED(hRes))
+				hRes = WaitForZaps(p_Request.hParentWnd, scheduler, stats, cancel);
+		}
+	}
+	CString reportPath = settings.GetString(L"ReportPath");
+	if (!reportPath.IsEmpty() && stats.GetZapCount() != 0)
+		stats.WriteReport(reportPath);
+	return hRes;
+}
+
+//
+// WaitForZaps
+//
+// Waits for the zaps of a scheduler while a progress dialog shows their
+// counters, polled a few times a second. Cancelling the dialog cancels the
+// zaps; those already moving put back what they moved.
+//
+// @param p_hParentWnd Handle of parent window for the progress dialog.
+//                     If this is set to 0, we will not show any UI.
+// @param p_rScheduler Scheduler running the zaps.
+// @param p_Stats Counters of the zaps.
+// @param p_rCancel Token that cancels the zaps.
+// @return Result of the zaps.
+//
+HRESULT CLevelZapContextMenuExt::WaitForZaps(const HWND p_hParentWnd,
+											 ZapScheduler& p_rScheduler,
+											 const ZapStats& p_Stats,
+											 ZapCancel& p_rCancel)
+{
+	CComPtr<IProgressDialog> pProgress;
+	if (p_hParentWnd != 0 && SUCCEEDED(pProgress.CoCreateInstance(CLSID_ProgressDialog))) {
+		CString title(MAKEINTRESOURCE(IDS_ZAP_PROGRESS_TITLE));
+		pProgress->SetTitle(title);
+		if (FAILED(pProgress->StartProgressDialog(p_hParentWnd, 0, PROGDLG_NORMAL | PROGDLG_AUTOTIME, 0)))
+			pProgress.Release();
+	}
+	if (pProgress == 0)
+		return p_rScheduler.Wait();
+
+	CString scannedFormat(MAKEINTRESOURCE(IDS_ZAP_PROGRESS_SCANNED));
+	CString movedFormat(MAKEINTRESOURCE(IDS_ZAP_PROGRESS_MOVED));
+	HRESULT hRes;
+	while ((hRes = p_rScheduler.Wait(PROGRESS_INTERVAL)) == E_PENDING) {
+		if (!p_rCancel.IsCancelled() && pProgress->HasUserCancelled()) {
+			p_rCancel.Cancel();
+			CString cancelling(MAKEINTRESOURCE(IDS_ZAP_PROGRESS_CANCELLING));
+			pProgress->SetLine(3, cancelling, FALSE, 0);
+		}
+		LONGLONG llPlanned = p_Stats.Get(ZapStats::PLANNED);
+		LONGLONG llMoved = p_Stats.Get(ZapStats::RENAMES) + p_Stats.Get(ZapStats::COPIES);
+		CString line;
+		line.Format(scannedFormat, p_Stats.Get(ZapStats::ENTRIES));
+		pProgress->SetLine(1, line, FALSE, 0);
+		line.Format(movedFormat, llMoved, llPlanned);
+		pProgress->SetLine(2, line, FALSE, 0);
+		pProgress->SetProgress64(llMoved, llPlanned);
 	}
+	pProgress->StopProgressDialog();
 	return hRes;
 }
 
 //
-// ZapFolder
+// ConfirmFolder
 //
-// Moves the entire content of the given directory up one level and then "zaps" the directory.
+// Asks for confirmation before a directory is zapped: its entire content is
+// moved up one level and then the directory is "zapped".
 //
 // @param p_hParentWnd Handle of parent window for dialog boxes.
 //                     If this is set to 0, we will not show any UI.
 // @param p_Folder Folder path.
 // @param p_rYesToAll true if user chose to answer "Yes" to all confirmations.
-// @return Result code.
+// @return true if the folder is to be zapped.
 //
-HRESULT CLevelZapContextMenuExt::ZapFolder(const HWND p_hParentWnd,
-										   CString p_Folder,
-										   bool& p_rYesToAll) const {
+bool CLevelZapContextMenuExt::ConfirmFolder(const HWND p_hParentWnd,
+											CString p_Folder,
+											bool& p_rYesToAll) const {
 	CString folderName = Util::PathFindFolderName(p_Folder);
 
 	// Ask for confirmation.
@@ -337,144 +547,29 @@ HRESULT CLevelZapContextMenuExt::ZapFolder(const HWND p_hParentWnd,
 	CString confirmMsgOld2(MAKEINTRESOURCE(IDS_ZAP_CONFIRM_MESSAGE_OLD_2));
 	CString confirmMsgCompleteOld = confirmMsgOld1 + folderName + confirmMsgOld2;
 	if (!p_rYesToAll && !m_bRecursive)
-		if (!Dialog::doModal(p_hParentWnd, Util::GetVersionEx2()>=6?confirmMsgComplete.GetBuffer():confirmMsgCompleteOld.GetBuffer())) return E_ABORT;
-
-	// Check for name collission
-	BOOL bRename = Util::PathFindFile(p_Folder, Util::PathFindFolderName(p_Folder), m_bRecursive);
-	CString _p_Folder(p_Folder);
-	if (bRename)
-		p_Folder.Empty();
-	if (bRename) {
-		if (!SUCCEEDED(Util::MoveFolderEx(_p_Folder, p_Folder)))
-			return E_FAIL;
-	}
-
-	// create list of files to move
-	CString szlFrom, szlTo;
-	if (!SUCCEEDED(FindFiles(p_hParentWnd, Util::PathFindPreviousComponent(p_Folder), p_Folder, szlFrom, szlTo))) {
-		if (bRename)
-			Util::MoveFolderEx(p_Folder, _p_Folder);
-		return E_FAIL;
-	}
-
-	// move files and don't leave an empty folder
-	if (SUCCEEDED(MoveFile(p_hParentWnd, szlFrom, szlTo)) || Util::PathIsDirectoryEmptyEx(p_Folder)) {
-		// Delete source directory
-		DeleteFolder(p_hParentWnd, p_Folder);
-		return S_OK;
-	} else
-		return E_FAIL;
-	return S_OK;
+		if (!Dialog::doModal(p_hParentWnd, Util::GetVersionEx2()>=6?confirmMsgComplete.GetBuffer():confirmMsgCompleteOld.GetBuffer())) return false;
+	return true;
 }
 
 //
-// FindFiles
+// UnzapFolder
 //
-// Populate recursive file list
+// Called when the "un-zap" menu item is chosen. Moves the content of the
+// last folder zapped into the selected folder back into it.
 //
-HRESULT CLevelZapContextMenuExt::FindFiles(const HWND p_hParentWnd,
-											CString szTo,
-											CString szFromPath,
-											CString& szlFrom,
-											CString& szlTo) const {
-	WIN32_FIND_DATA ffd;
-	HANDLE hFind;
-	CString szPath;
-
-	// files are ignored
-	hFind = FindFirstFile(szFromPath, &ffd);
-	if (INVALID_HANDLE_VALUE == hFind) {
-		Util::OutputDebugStringEx(L"INVALID_HANDLE_VALUE: %s\n", szFromPath);
-		FindClose(hFind);
-		return E_FAIL;
-	}
-	if (!(ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-		FindClose(hFind);
-		return E_FAIL;
-	}
-	FindClose(hFind);
-
-	// add folder members to move list
-	szPath.Append(szFromPath);
-	szPath.Append(L"\\*");
-	hFind = FindFirstFile(szPath, &ffd);
-	if (INVALID_HANDLE_VALUE == hFind) {
-		Util::OutputDebugStringEx(L"INVALID_HANDLE_VALUE: %s\n", szPath);
-		FindClose(hFind);
-		return E_FAIL;
-	}	
-	do {
-		CString szFileName(ffd.cFileName);
-		szPath.Empty();
-		szPath.Append(szPath);
-		szPath.Append(szFromPath);
-		szPath.Append(L"\\");
-		szPath.Append(szFileName);
-		if ((ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-			if (szFileName.Compare(L".") && szFileName.Compare(L"..")) {
-				if (m_bRecursive) {
-					Util::OutputDebugStringEx(L"Folder %s\n", szPath);
-					FindFiles(p_hParentWnd, szTo, szPath, szlFrom, szlTo);					
-				} else {
-					szlFrom.Append(szPath); szlFrom.AppendChar('\0');
-					szlTo.Append(szTo + L"\\" + szFileName); szlTo.AppendChar('\0');
-					Util::OutputDebugStringEx(L"    Move %s -> %s\n", szPath, szTo + L"\\" + szFileName);
-				}
-			}
-		}
-		else
-		{
-			szlFrom.Append(szPath); szlFrom.AppendChar('\0');
-			CString _szTo;
-			_szTo.Append(szTo);
-			_szTo.Append(L"\\"); _szTo.Append(szFileName);
-			szlTo.Append(_szTo); szlTo.AppendChar('\0');
-			Util::OutputDebugStringEx(L"    Move %s -> %s\n", szPath, _szTo);
-		}
-	} while (FindNextFile(hFind, &ffd));
-
-	FindClose(hFind);
-	return S_OK;
-}
-
-//
-// MoveFile
-//
-// Move file(s)
-//
-HRESULT CLevelZapContextMenuExt::MoveFile(const HWND p_hParentWnd,
-											CString p_Path,
-											CString p_FolderTo) const {
-	if (p_Path.IsEmpty()) return S_OK;
-	SHFILEOPSTRUCT fileOpStruct = {0};
-	fileOpStruct.hwnd = p_hParentWnd;
-	fileOpStruct.wFunc = FO_MOVE;
-	p_Path.AppendChar(L'\0'); fileOpStruct.pFrom = p_Path;
-	p_FolderTo.AppendChar(L'\0'); fileOpStruct.pTo = p_FolderTo;
-	fileOpStruct.fFlags = FOF_MULTIDESTFILES | FOF_ALLOWUNDO | FOF_SILENT;
-	if (p_hParentWnd == 0) fileOpStruct.fFlags |= (FOF_NOCONFIRMATION | FOF_NOERRORUI);
-	int hRes = SHFileOperation(&fileOpStruct);
-	if (fileOpStruct.fAnyOperationsAborted) hRes = E_ABORT;
-	Util::OutputDebugStringEx(L"Move 0x%08x | %s -> %s\n", hRes, p_Path, p_FolderTo);
-	return hRes;
-}
-
-//
-// DeleteFolder
-//
-// Delete folder
+// @param p_hParentWnd Handle of parent window for dialog boxes; unused,
+//                     as un-zapping has no UI of its own.
+// @return Result code.
 //
-HRESULT CLevelZapContextMenuExt::DeleteFolder(const HWND p_hParentWnd,
-											CString p_Path) const {
-	SHFILEOPSTRUCT fileOpStruct = {0};
-	fileOpStruct.hwnd = p_hParentWnd;
-	fileOpStruct.wFunc = FO_DELETE;	
-	fileOpStruct.pTo = 0;
-	fileOpStruct.fFlags = FOF_ALLOWUNDO | FOF_WANTNUKEWARNING | FOF_SILENT;
-	if (Util::PathIsDirectoryEmptyEx(p_Path)) fileOpStruct.fFlags |= FOF_NOCONFIRMATION;
-	p_Path.AppendChar(L'\0'); fileOpStruct.pFrom = p_Path;
-	if (p_hParentWnd == 0) fileOpStruct.fFlags |= FOF_NOERRORUI;
-	int hRes = SHFileOperation(&fileOpStruct);
-	Util::OutputDebugStringEx(L"Delete 0x%08x | %s", hRes, p_Path);
+HRESULT CLevelZapContextMenuExt::UnzapFolder(const HWND /*p_hParentWnd*/) const
+{
+	ZapLog::LoadSettings();
+	ZapOptions options;
+	ZapEngine::LoadOptions(options);
+	CString folder(m_vFolders.front());
+	folder.TrimRight(L"\\");
+	HRESULT hRes = ZapEngine(options).Unzap(folder);
+	// Let Explorer show the folder coming back.
+	::SHChangeNotify(SHCNE_UPDATEDIR, SHCNF_PATH, folder.GetString(), 0);
 	return hRes;
 }
\ No newline at end of file
@@ -22,19 +22,24 @@
 #include "stdafx.h"
 #include <GuidString.h>
 #include "Utilities.h"
+#include "ZapLog.h"
+#include "ZapSettings.h"
 
 //
 // OutputDebugString
 //
+// Writes an info message to the log. Prefer the ZAP_LOG_* macros, which do
+// not evaluate their arguments when the level is disabled.
+//
 // @param format Variable argument list.
 //
 void Util::OutputDebugStringEx(const wchar_t* format, ...) {
-	wchar_t buffer[1024*8];
+	if (!ZapLog::IsEnabled(ZAP_LOG_LEVEL_INFO))
+		return;
 	va_list argptr;
 	va_start(argptr, format);
-	_vsnwprintf(buffer, 1024*8, format, argptr);
+	ZapLog::WriteV(ZAP_LOG_LEVEL_INFO, format, argptr);
 	va_end(argptr);
-	OutputDebugString(buffer);
 }
 
 //
@@ -67,7 +72,7 @@ void Util::FormatMessageEx(DWORD dw) {
 		(LPWSTR)&lpMsgBuf,
 		0,
 		NULL);	
-	OutputDebugStringEx(L"0x%08x %s", dw, (LPWSTR)lpMsgBuf);
+	ZAP_LOG_ERROR(L"0x%08x %s", dw, (LPWSTR)lpMsgBuf);
 }
 
 //
@@ -90,9 +95,8 @@ int Util::GetVersionEx2() {
 //
 // @param szPath Path.
 //
-CString Util::PathFindFolderName(CString szPath) {
-	szPath = szPath.Right(szPath.GetLength()-szPath.ReverseFind(L'\\')-1);
-	return szPath;
+CString Util::PathFindFolderName(const CString& szPath) {
+	return szPath.Right(szPath.GetLength()-szPath.ReverseFind(L'\\')-1);
 }
 
 //
@@ -101,9 +105,19 @@ CString Util::PathFindFolderName(CString szPath) {
 // @param szPath Path.
 // @return Previous level path.
 //
-CString Util::PathFindPreviousComponent(CString szPath) {
-	szPath = szPath.Left(szPath.ReverseFind(L'\\'));
-	return szPath;
+CString Util::PathFindPreviousComponent(const CString& szPath) {
+	return szPath.Left(szPath.ReverseFind(L'\\'));
+}
+
+//
+// Make a new path next to a folder, named after it
+//
+// @param szPath Folder path.
+// @return Path with a random GUID appended.
+//
+CString Util::PathAppendGuid(const CString& szPath) {
+	GuidString szGUID;
+	return PathFindPreviousComponent(szPath) + L"\\" + PathFindFolderName(szPath) + CString(szGUID.String().c_str());
 }
 
 //
@@ -113,106 +127,29 @@ CString Util::PathFindPreviousComponent(CString szPath) {
 // @param szTo New name.
 // @return Result code.
 //
-HRESULT Util::MoveFolderEx(CString& szFrom, CString& szTo) {
-	if (szTo.IsEmpty()) {
-		GuidString szGUID;
-		szTo = PathFindPreviousComponent(szFrom) + L"\\" + PathFindFolderName(szFrom) + CString(szGUID.String().c_str());
-	}
+HRESULT Util::MoveFolderEx(const CString& szFrom, CString& szTo) {
+	if (szTo.IsEmpty())
+		szTo = PathAppendGuid(szFrom);
 	if (!(GetFileAttributes(szFrom) & FILE_ATTRIBUTE_DIRECTORY)) {
 		szTo = szFrom;
 		return S_OK;
 	}
 	if (!MoveFileEx(szFrom, szTo, 0)) {
-		OutputDebugStringEx(L"MOVE_FAILED: %s -> %s\n", szFrom, szTo);
+		ZAP_LOG_ERROR(L"MOVE_FAILED: %s -> %s\n", szFrom, szTo);
 		GetLastErrorEx();
 		return E_FAIL;
 	}
 	return S_OK;
 }
 
-//
-// Find file recursively
-//
-// @param _szPath Path.
-// @param _szPath Filename to find.
-// @return BOOL File found.
-//
-BOOL Util::PathFindFile(CString _szPath, CString _szFile, BOOL bRecursive) {
-	WIN32_FIND_DATA ffd;
-	HANDLE hFind;
-
-	hFind = FindFirstFile(_szPath + L"\\*", &ffd);
-	if (INVALID_HANDLE_VALUE == hFind) {
-		OutputDebugStringEx(L"INVALID_HANDLE_VALUE: %s\n", _szPath);
-		FindClose(hFind);
-		return false;
-	}	
-	do {
-		CString szFileName(ffd.cFileName);
-		if ((ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-			if (szFileName.Compare(L".") && szFileName.Compare(L"..")) {
-				if (!szFileName.CompareNoCase(_szFile))
-					goto ret;
-				if (bRecursive)
-					if (PathFindFile(_szPath + L"\\" + szFileName, _szFile))
-						goto ret;
-			}			
-		} else {
-			if (!szFileName.CompareNoCase(_szFile))
-				goto ret;			
-		}
-	} while (FindNextFile(hFind, &ffd));
-
-	FindClose(hFind);
-	return false;
-ret:
-	FindClose(hFind);
-	return true;
-}
-
-//
-// Is directory empty
-//
-// @param _szPath Path.
-// @return BOOL Directory is empty.
-//
-BOOL Util::PathIsDirectoryEmptyEx(CString _szPath) {
-	WIN32_FIND_DATA ffd;
-	HANDLE hFind;
-
-	hFind = FindFirstFile(_szPath + L"\\*", &ffd);
-	if (INVALID_HANDLE_VALUE == hFind) {
-		OutputDebugStringEx(L"INVALID_HANDLE_VALUE: %s\n", _szPath);
-		FindClose(hFind);
-		return false;
-	}
-	do {
-		CString szFileName(ffd.cFileName);
-		if ((ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-			if (szFileName.Compare(L".") && szFileName.Compare(L"..")) {
-				if(!PathIsDirectoryEmptyEx(_szPath + L"\\" + szFileName)) { FindClose(hFind); return false; }
-			}
-		} else { FindClose(hFind); return false; }
-	} while (FindNextFile(hFind, &ffd));
-
-	FindClose(hFind);
-	return true;
-}
-
 //
 // Read registry string
 //
 // @param szValue Registry value name.
 // @return CString Registry value data.
 //
-CString Util::QueryStringValueEx(CString szValue) {
-	CRegKey RegKey;
-	TCHAR pszValue[1024];
-	ULONG pnChars = 1024;
-	if(RegKey.Open(HKEY_CURRENT_USER, L"Software\\LevelZap") != ERROR_SUCCESS) return L"";
-	if(RegKey.QueryStringValue(szValue, pszValue, &pnChars) != ERROR_SUCCESS) return L"";
-	if(RegKey.Close() != ERROR_SUCCESS) return L"";
-	return CString(pszValue);
+CString Util::QueryStringValueEx(const CString& szValue) {
+	return ZapSettings::Current().GetString(szValue);
 }
 
 //
@@ -221,13 +158,8 @@ CString Util::QueryStringValueEx(CString szValue) {
 // @param szValue Registry value name.
 // @return DWORD Registry value data.
 //
-DWORD Util::QueryDWORDValueEx(CString szValue) {
-	CRegKey RegKey;
-	DWORD dwValue = 0;
-	if(RegKey.Open(HKEY_CURRENT_USER,  L"Software\\LevelZap") != ERROR_SUCCESS) return 0;
-	if(RegKey.QueryDWORDValue(szValue, dwValue) != ERROR_SUCCESS) return 0;
-	if(RegKey.Close() != ERROR_SUCCESS) return 0;
-	return dwValue;
+DWORD Util::QueryDWORDValueEx(const CString& szValue) {
+	return ZapSettings::Current().GetDWORD(szValue);
 }
 
 //
@@ -237,25 +169,6 @@ DWORD Util::QueryDWORDValueEx(CString szValue) {
 // @param szArr Registry value data.
 // @return LONG Result code.
 //
-LONG Util::QueryMultiStringValueEx(CString szValue, CAtlList<CString>& szArr) {
-	CRegKey RegKey;
-	LONG lRet;
-	CAtlArray<WCHAR> pszValue;
-	ULONG pnChars = 0;
-
-	if (lRet = RegKey.Open(HKEY_CURRENT_USER,  L"Software\\LevelZap") != ERROR_SUCCESS) return lRet;
-	if (lRet = RegKey.QueryMultiStringValue(szValue, NULL, &pnChars) != ERROR_SUCCESS) return lRet;
-	pszValue.SetCount(pnChars);
-	if (lRet = RegKey.QueryMultiStringValue(szValue, pszValue.GetData(), &pnChars) != ERROR_SUCCESS) return lRet;
-	if (lRet = RegKey.Close() != ERROR_SUCCESS) return lRet;
-
-    LPCWSTR lpEnd  = pszValue.GetData() + pszValue.GetCount();
-    LPCWSTR lpNext = pszValue.GetData();
-    while (lpNext && lpNext < lpEnd && *lpNext) {
-        szArr.AddTail(lpNext);
-        lpNext = std::find(lpNext, lpEnd, L'\0');
-        if (lpNext == lpEnd) break;
-        ++lpNext;
-    }
-    return ERROR_SUCCESS;
+LONG Util::QueryMultiStringValueEx(const CString& szValue, CAtlList<CString>& szArr) {
+	return ZapSettings::Current().GetMultiString(szValue, szArr) ? ERROR_SUCCESS : ERROR_FILE_NOT_FOUND;
 }
\ No newline at end of file
@@ -0,0 +1,457 @@
+// ZapCopier.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapCopier.h"
+#include "ZapExecutor.h"
+#include "ZapLog.h"
+#include "ZapStats.h"
+
+#include <aclapi.h>
+
+//
+// Constructor.
+//
+ZapCopier::ZapCopier()
+	: m_csPending(),
+	  m_vPending(),
+	  m_llBytes(0),
+	  m_pStats(0)
+{
+}
+
+//
+// Copy
+//
+// Copies the data and the alternate streams of one file to another volume.
+// The source is left in place until Finish().
+//
+// @param szFrom Source file.
+// @param szTo Destination.
+// @param uEntry Plan index of the entry, used to report its result.
+// @param bReplace Overwrite an existing destination; otherwise the copy fails.
+// @return Result code.
+//
+HRESULT ZapCopier::Copy(const CString& szFrom, const CString& szTo, size_t uEntry, bool bReplace) {
+	Pending pending;
+	pending.uEntry = uEntry;
+	pending.szFrom = szFrom;
+	pending.szTo = szTo;
+
+	// Kernel calls are counted as they are made, failed ones included.
+	LONGLONG llCalls = 1;
+	HANDLE hFrom = ::CreateFile(szFrom, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+		FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (hFrom == INVALID_HANDLE_VALUE) {
+		HRESULT hRes = HRESULT_FROM_WIN32(::GetLastError());
+		CountCalls(llCalls);
+		return hRes;
+	}
+
+	BY_HANDLE_FILE_INFORMATION info;
+	++llCalls;
+	if (!::GetFileInformationByHandle(hFrom, &info)) {
+		HRESULT hRes = HRESULT_FROM_WIN32(::GetLastError());
+		::CloseHandle(hFrom);
+		CountCalls(llCalls);
+		return hRes;
+	}
+	pending.ftCreation = info.ftCreationTime;
+	pending.ftAccess = info.ftLastAccessTime;
+	pending.ftWrite = info.ftLastWriteTime;
+	pending.dwAttributes = info.dwFileAttributes;
+	ULONGLONG ullSize = (static_cast<ULONGLONG>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+
+	HRESULT hRes = S_OK;
+	if (ullSize < UNBUFFERED_THRESHOLD || (info.dwFileAttributes & FILE_ATTRIBUTE_ENCRYPTED)) {
+		// Small files: the cache does a better job than we would. Encrypted
+		// files: only CopyFileEx keeps them encrypted.
+		::CloseHandle(hFrom);
+		++llCalls;
+		BOOL bCopied = ::CopyFileEx(szFrom, szTo, 0, 0, 0, bReplace ? 0 : COPY_FILE_FAIL_IF_EXISTS);
+		if (!bCopied)
+			hRes = HRESULT_FROM_WIN32(::GetLastError());
+		CountCalls(llCalls);
+		if (FAILED(hRes))
+			return hRes;
+	} else {
+		++llCalls;
+		HANDLE hTo = ::CreateFile(szTo, GENERIC_WRITE, 0, 0, bReplace ? CREATE_ALWAYS : CREATE_NEW,
+			FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED, 0);
+		if (hTo == INVALID_HANDLE_VALUE) {
+			hRes = HRESULT_FROM_WIN32(::GetLastError());
+			::CloseHandle(hFrom);
+			CountCalls(llCalls);
+			return hRes;
+		}
+		hRes = CopyUnbuffered(hFrom, hTo, ullSize, llCalls);
+		::CloseHandle(hTo);
+		::CloseHandle(hFrom);
+		if (SUCCEEDED(hRes))
+			hRes = CopyStreams(szFrom, szTo, llCalls);
+		CountCalls(llCalls);
+		if (FAILED(hRes)) {
+			::DeleteFile(szTo);
+			return hRes;
+		}
+	}
+
+	::InterlockedExchangeAdd64(&m_llBytes, static_cast<LONGLONG>(ullSize));
+	if (m_pStats != 0) {
+		m_pStats->Add(ZapStats::COPIES);
+		m_pStats->Add(ZapStats::BYTES, static_cast<LONGLONG>(ullSize));
+	}
+	CComCritSecLock<CComAutoCriticalSection> lock(m_csPending);
+	m_vPending.push_back(pending);
+	return S_OK;
+}
+
+//
+// CopyUnbuffered
+//
+// Copies a file with overlapped unbuffered I/O. CHUNK_COUNT chunks are in
+// flight at once; each one is read, then written back at the same offset.
+// The last write is padded to SECTOR_ALIGNMENT, and the destination is then
+// truncated to the real size.
+//
+// @param hFrom Source, opened unbuffered and overlapped.
+// @param hTo Destination, opened unbuffered and overlapped.
+// @param ullSize Size of the source.
+// @param llCalls Incremented for every read, write and truncation call made.
+// @return Result code.
+//
+HRESULT ZapCopier::CopyUnbuffered(HANDLE hFrom, HANDLE hTo, ULONGLONG ullSize, LONGLONG& llCalls) {
+	struct Slot
+	{
+		OVERLAPPED	ov;			// Request in flight.
+		BYTE*		pBuffer;	// Sector-aligned buffer of CHUNK_SIZE bytes.
+		ULONGLONG	ullOffset;	// Offset of the chunk.
+		DWORD		cbChunk;	// Bytes of data in the chunk.
+		bool		bWriting;	// Request in flight is the write.
+		bool		bBusy;		// A request is in flight.
+	};
+
+	Slot vSlots[CHUNK_COUNT];
+	HANDLE vEvents[CHUNK_COUNT];
+	ZeroMemory(vSlots, sizeof(vSlots));
+	BYTE* pBuffers = static_cast<BYTE*>(::VirtualAlloc(0, CHUNK_SIZE * CHUNK_COUNT,
+		MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+	if (pBuffers == 0)
+		return E_OUTOFMEMORY;
+	for (UINT i = 0; i < CHUNK_COUNT; ++i) {
+		vEvents[i] = vSlots[i].ov.hEvent = ::CreateEvent(0, TRUE, FALSE, 0);
+		vSlots[i].pBuffer = pBuffers + i * CHUNK_SIZE;
+	}
+
+	HRESULT hRes = S_OK;
+	ULONGLONG ullNext = 0;
+	UINT uBusy = 0;
+	for (;;) {
+		// Start reading the next chunks into idle slots.
+		for (UINT i = 0; i < CHUNK_COUNT && SUCCEEDED(hRes) && ullNext < ullSize; ++i) {
+			Slot& slot = vSlots[i];
+			if (slot.bBusy) continue;
+			slot.ullOffset = ullNext;
+			slot.bWriting = false;
+			slot.ov.Offset = static_cast<DWORD>(ullNext);
+			slot.ov.OffsetHigh = static_cast<DWORD>(ullNext >> 32);
+			++llCalls;
+			if (!::ReadFile(hFrom, slot.pBuffer, CHUNK_SIZE, 0, &slot.ov)
+				&& ::GetLastError() != ERROR_IO_PENDING) {
+				hRes = HRESULT_FROM_WIN32(::GetLastError());
+				break;
+			}
+			slot.bBusy = true;
+			++uBusy;
+			ullNext += CHUNK_SIZE;
+		}
+		if (uBusy == 0)
+			break;
+
+		DWORD dwWait = ::WaitForMultipleObjects(CHUNK_COUNT, vEvents, FALSE, INFINITE);
+		if (dwWait >= WAIT_OBJECT_0 + CHUNK_COUNT) {
+			hRes = HRESULT_FROM_WIN32(::GetLastError());
+			break;
+		}
+		Slot& slot = vSlots[dwWait - WAIT_OBJECT_0];
+		if (!slot.bBusy) {
+			::ResetEvent(slot.ov.hEvent);
+			continue;
+		}
+		DWORD cbDone = 0;
+		BOOL bDone = ::GetOverlappedResult(slot.bWriting ? hTo : hFrom, &slot.ov, &cbDone, FALSE);
+		::ResetEvent(slot.ov.hEvent);
+		slot.bBusy = false;
+		--uBusy;
+		if (!bDone) {
+			hRes = HRESULT_FROM_WIN32(::GetLastError());
+			break;
+		}
+		if (slot.bWriting || FAILED(hRes))
+			continue;
+
+		// The chunk has been read; write it back at the same offset.
+		slot.cbChunk = cbDone;
+		DWORD cbWrite = (cbDone + SECTOR_ALIGNMENT - 1) & ~static_cast<DWORD>(SECTOR_ALIGNMENT - 1);
+		ZeroMemory(slot.pBuffer + cbDone, cbWrite - cbDone);
+		slot.bWriting = true;
+		++llCalls;
+		if (!::WriteFile(hTo, slot.pBuffer, cbWrite, 0, &slot.ov)
+			&& ::GetLastError() != ERROR_IO_PENDING) {
+			hRes = HRESULT_FROM_WIN32(::GetLastError());
+			break;
+		}
+		slot.bBusy = true;
+		++uBusy;
+	}
+
+	// On failure, let the requests still in flight finish before freeing their buffers.
+	if (uBusy != 0) {
+		::CancelIo(hFrom);
+		::CancelIo(hTo);
+		for (UINT i = 0; i < CHUNK_COUNT; ++i) {
+			DWORD cbDone = 0;
+			if (vSlots[i].bBusy)
+				::GetOverlappedResult(vSlots[i].bWriting ? hTo : hFrom, &vSlots[i].ov, &cbDone, TRUE);
+		}
+	}
+	for (UINT i = 0; i < CHUNK_COUNT; ++i)
+		::CloseHandle(vEvents[i]);
+	::VirtualFree(pBuffers, 0, MEM_RELEASE);
+
+	if (SUCCEEDED(hRes)) {
+		LARGE_INTEGER liSize;
+		liSize.QuadPart = static_cast<LONGLONG>(ullSize);
+		++llCalls;
+		BOOL bTruncated = ::SetFilePointerEx(hTo, liSize, 0, FILE_BEGIN);
+		if (bTruncated) {
+			++llCalls;
+			bTruncated = ::SetEndOfFile(hTo);
+		}
+		if (!bTruncated)
+			hRes = HRESULT_FROM_WIN32(::GetLastError());
+	}
+	return hRes;
+}
+
+//
+// CopyStreams
+//
+// Copies the named data streams of a file; CopyUnbuffered only copies the
+// unnamed one.
+//
+// @param szFrom Source file.
+// @param szTo Copy, already holding the unnamed stream.
+// @param llCalls Incremented for every call made.
+// @return Result code.
+//
+HRESULT ZapCopier::CopyStreams(const CString& szFrom, const CString& szTo, LONGLONG& llCalls) {
+	WIN32_FIND_STREAM_DATA data;
+	++llCalls;
+	HANDLE hFind = ::FindFirstStreamW(szFrom, FindStreamInfoStandard, &data, 0);
+	if (hFind == INVALID_HANDLE_VALUE) {
+		// No stream at all, or a file system without named streams.
+		DWORD dwError = ::GetLastError();
+		return (dwError == ERROR_HANDLE_EOF || dwError == ERROR_INVALID_PARAMETER) ? S_OK : HRESULT_FROM_WIN32(dwError);
+	}
+
+	HRESULT hRes = S_OK;
+	BOOL bFound = TRUE;
+	while (bFound) {
+		// "::$DATA" is the unnamed stream.
+		if (data.cStreamName[0] != L':' || data.cStreamName[1] != L':') {
+			hRes = CopyStream(szFrom + data.cStreamName, szTo + data.cStreamName, llCalls);
+			if (FAILED(hRes))
+				break;
+		}
+		++llCalls;
+		bFound = ::FindNextStreamW(hFind, &data);
+	}
+	if (SUCCEEDED(hRes) && ::GetLastError() != ERROR_HANDLE_EOF)
+		hRes = HRESULT_FROM_WIN32(::GetLastError());
+	::FindClose(hFind);
+	return hRes;
+}
+
+//
+// CopyStream
+//
+// Copies one named stream. CopyFileEx is not used: it would also copy the
+// attributes of the source, and a read-only copy would refuse the next stream.
+//
+// @param szFrom Source stream, as "file:name:$DATA".
+// @param szTo Destination stream.
+// @param llCalls Incremented for every call made.
+// @return Result code.
+//
+HRESULT ZapCopier::CopyStream(const CString& szFrom, const CString& szTo, LONGLONG& llCalls) {
+	++llCalls;
+	HANDLE hFrom = ::CreateFile(szFrom, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (hFrom == INVALID_HANDLE_VALUE)
+		return HRESULT_FROM_WIN32(::GetLastError());
+	++llCalls;
+	HANDLE hTo = ::CreateFile(szTo, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
+	if (hTo == INVALID_HANDLE_VALUE) {
+		HRESULT hRes = HRESULT_FROM_WIN32(::GetLastError());
+		::CloseHandle(hFrom);
+		return hRes;
+	}
+
+	HRESULT hRes = S_OK;
+	std::vector<BYTE> vBuffer(SECTOR_ALIGNMENT);
+	for (;;) {
+		DWORD cbRead = 0;
+		++llCalls;
+		if (!::ReadFile(hFrom, &vBuffer[0], static_cast<DWORD>(vBuffer.size()), &cbRead, 0)) {
+			hRes = HRESULT_FROM_WIN32(::GetLastError());
+			break;
+		}
+		if (cbRead == 0)
+			break;
+		DWORD cbWritten = 0;
+		++llCalls;
+		if (!::WriteFile(hTo, &vBuffer[0], cbRead, &cbWritten, 0)) {
+			hRes = HRESULT_FROM_WIN32(::GetLastError());
+			break;
+		}
+	}
+	::CloseHandle(hTo);
+	::CloseHandle(hFrom);
+	return hRes;
+}
+
+//
+// Finish
+//
+// Applies the timestamps, attributes and security of every copy made so far,
+// then deletes the sources of the copies that are complete.
+//
+// @param vResults Per-entry results of the plan; updated for every copied entry.
+//
+void ZapCopier::Finish(std::vector<ZapMoveResult>& vResults) {
+	CComCritSecLock<CComAutoCriticalSection> lock(m_csPending);
+	LONGLONG llCalls = 0;
+	for (size_t i = 0; i < m_vPending.size(); ++i) {
+		const Pending& pending = m_vPending[i];
+		HRESULT hRes = ApplyMetadata(pending, llCalls);
+		if (SUCCEEDED(hRes)) {
+			if (pending.dwAttributes & FILE_ATTRIBUTE_READONLY) {
+				++llCalls;
+				::SetFileAttributes(pending.szFrom, pending.dwAttributes & ~FILE_ATTRIBUTE_READONLY);
+			}
+			++llCalls;
+			if (!::DeleteFile(pending.szFrom))
+				hRes = HRESULT_FROM_WIN32(::GetLastError());
+		}
+		vResults[pending.uEntry].hr = hRes;
+	}
+	CountCalls(llCalls);
+	ZAP_LOG_INFO(L"Copied %Iu files, %I64u bytes\n", m_vPending.size(), GetBytesCopied());
+	m_vPending.clear();
+}
+
+//
+// ApplyMetadata
+//
+// Gives a copy the timestamps and attributes of its source, then its owner,
+// group and explicit permissions. The security comes last, as it may take
+// away our own right to write the attributes.
+//
+// @param pending Copy to finish.
+// @param llCalls Incremented for every call made.
+// @return Result code.
+//
+HRESULT ZapCopier::ApplyMetadata(const Pending& pending, LONGLONG& llCalls) {
+	++llCalls;
+	HANDLE hTo = ::CreateFile(pending.szTo, FILE_WRITE_ATTRIBUTES,
+		FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0);
+	if (hTo == INVALID_HANDLE_VALUE)
+		return HRESULT_FROM_WIN32(::GetLastError());
+	llCalls += 2;
+	BOOL bTime = ::SetFileTime(hTo, &pending.ftCreation, &pending.ftAccess, &pending.ftWrite);
+	DWORD dwError = ::GetLastError();
+	::CloseHandle(hTo);
+	if (!bTime)
+		return HRESULT_FROM_WIN32(dwError);
+	++llCalls;
+	if (!::SetFileAttributes(pending.szTo, pending.dwAttributes))
+		return HRESULT_FROM_WIN32(::GetLastError());
+
+	PSID pOwner = 0;
+	PSID pGroup = 0;
+	PACL pDacl = 0;
+	PSECURITY_DESCRIPTOR pSecurity = 0;
+	++llCalls;
+	dwError = ::GetNamedSecurityInfo(pending.szFrom, SE_FILE_OBJECT,
+		OWNER_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION | DACL_SECURITY_INFORMATION,
+		&pOwner, &pGroup, &pDacl, 0, &pSecurity);
+	if (dwError != ERROR_SUCCESS)
+		return HRESULT_FROM_WIN32(dwError);
+
+	// Inherited entries are dropped and inherited again from the new folder,
+	// as they would be on a move; a protected source stays protected.
+	SECURITY_DESCRIPTOR_CONTROL control = 0;
+	DWORD dwRevision = 0;
+	::GetSecurityDescriptorControl(pSecurity, &control, &dwRevision);
+	SECURITY_INFORMATION siDacl = DACL_SECURITY_INFORMATION
+		| ((control & SE_DACL_PROTECTED) ? PROTECTED_DACL_SECURITY_INFORMATION : UNPROTECTED_DACL_SECURITY_INFORMATION);
+	LPWSTR pszTo = const_cast<LPWSTR>(pending.szTo.GetString());
+	++llCalls;
+	dwError = ::SetNamedSecurityInfo(pszTo, SE_FILE_OBJECT,
+		siDacl | OWNER_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION, pOwner, pGroup, pDacl, 0);
+	if (dwError == ERROR_INVALID_OWNER || dwError == ERROR_ACCESS_DENIED || dwError == ERROR_PRIVILEGE_NOT_HELD) {
+		// Only an administrator can give a file to someone else; we keep it.
+		ZAP_LOG_WARNING(L"OWNER_NOT_KEPT: %s\n", pending.szTo);
+		++llCalls;
+		dwError = ::SetNamedSecurityInfo(pszTo, SE_FILE_OBJECT, siDacl, 0, 0, pDacl, 0);
+	}
+	::LocalFree(pSecurity);
+	if (dwError != ERROR_SUCCESS)
+		return HRESULT_FROM_WIN32(dwError);
+	return S_OK;
+}
+
+//
+// Count the copies, bytes and calls of the next copies
+//
+// @param pStats Counters to add to, or 0.
+//
+void ZapCopier::SetStats(ZapStats* pStats) {
+	m_pStats = pStats;
+}
+
+//
+// CountCalls
+//
+// @param llCalls Kernel calls made, added to the stats if any.
+//
+void ZapCopier::CountCalls(LONGLONG llCalls) const {
+	if (m_pStats != 0)
+		m_pStats->Add(ZapStats::KERNEL_CALLS, llCalls);
+}
+
+//
+// Bytes copied so far
+//
+ULONGLONG ZapCopier::GetBytesCopied() const {
+	return static_cast<ULONGLONG>(m_llBytes);
+}
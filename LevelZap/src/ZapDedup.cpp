@@ -0,0 +1,637 @@
+// ZapDedup.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapDedup.h"
+#include "ZapCancel.h"
+#include "ZapLog.h"
+#include "ZapStats.h"
+#include "ZapWorkPool.h"
+
+#include <algorithm>
+
+namespace {
+
+	const ULONGLONG PRIME64_1 = 0x9E3779B185EBCA87ULL;
+	const ULONGLONG PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+	const ULONGLONG PRIME64_3 = 0x165667B19E3779F9ULL;
+	const ULONGLONG PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+	const ULONGLONG PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+	//
+	// Hash64
+	//
+	// 64-bit hash of a file content in the xxHash64 layout: four lanes of
+	// 8-byte words, each multiplied, rotated and multiplied again, merged at
+	// the end. Fast enough to run at memory speed; not meant to resist an
+	// attacker, as equal hashes are always confirmed byte for byte.
+	//
+	class Hash64
+	{
+	public:
+		enum { STRIPE = 32 };			// Bytes consumed by one round of the four lanes.
+
+		explicit		Hash64(ULONGLONG ullLength);
+		void			Update(const BYTE* p, size_t cb);
+		ULONGLONG		Finish() const;
+
+	private:
+		static ULONGLONG Read64(const BYTE* p) { ULONGLONG ull; memcpy(&ull, p, sizeof(ull)); return ull; }
+		static DWORD	Read32(const BYTE* p) { DWORD dw; memcpy(&dw, p, sizeof(dw)); return dw; }
+		static ULONGLONG Round(ULONGLONG ullAcc, ULONGLONG ullInput);
+		static ULONGLONG Merge(ULONGLONG ullAcc, ULONGLONG ullLane);
+
+		ULONGLONG		m_vLanes[4];	// Lane accumulators.
+		ULONGLONG		m_ullLength;	// Length of the whole content.
+		BYTE			m_vTail[STRIPE];	// Bytes after the last full stripe.
+		size_t			m_cbTail;		// Bytes in m_vTail.
+	};
+
+	//
+	// Constructor.
+	//
+	// @param ullLength Length of the content; every Update() but the last
+	//                  must pass a multiple of STRIPE bytes.
+	//
+	Hash64::Hash64(ULONGLONG ullLength)
+		: m_ullLength(ullLength),
+		  m_cbTail(0)
+	{
+		m_vLanes[0] = PRIME64_1 + PRIME64_2;
+		m_vLanes[1] = PRIME64_2;
+		m_vLanes[2] = 0;
+		m_vLanes[3] = 0 - PRIME64_1;
+	}
+
+	//
+	// Hash the next bytes of the content
+	//
+	void Hash64::Update(const BYTE* p, size_t cb) {
+		const BYTE* pEnd = p + (cb & ~static_cast<size_t>(STRIPE - 1));
+		ULONGLONG v1 = m_vLanes[0], v2 = m_vLanes[1], v3 = m_vLanes[2], v4 = m_vLanes[3];
+		for (; p < pEnd; p += STRIPE) {
+			v1 = Round(v1, Read64(p));
+			v2 = Round(v2, Read64(p + 8));
+			v3 = Round(v3, Read64(p + 16));
+			v4 = Round(v4, Read64(p + 24));
+		}
+		m_vLanes[0] = v1; m_vLanes[1] = v2; m_vLanes[2] = v3; m_vLanes[3] = v4;
+		m_cbTail = cb & (STRIPE - 1);
+		memcpy(m_vTail, p, m_cbTail);
+	}
+
+	//
+	// Hash of the content
+	//
+	ULONGLONG Hash64::Finish() const {
+		ULONGLONG h;
+		if (m_ullLength >= STRIPE) {
+			h = _rotl64(m_vLanes[0], 1) + _rotl64(m_vLanes[1], 7) + _rotl64(m_vLanes[2], 12) + _rotl64(m_vLanes[3], 18);
+			for (int i = 0; i < 4; ++i)
+				h = Merge(h, m_vLanes[i]);
+		} else {
+			h = PRIME64_5;
+		}
+		h += m_ullLength;
+
+		const BYTE* p = m_vTail;
+		const BYTE* pEnd = m_vTail + m_cbTail;
+		for (; p + 8 <= pEnd; p += 8)
+			h = _rotl64(h ^ Round(0, Read64(p)), 27) * PRIME64_1 + PRIME64_4;
+		if (p + 4 <= pEnd) {
+			h = _rotl64(h ^ (Read32(p) * PRIME64_1), 23) * PRIME64_2 + PRIME64_3;
+			p += 4;
+		}
+		for (; p < pEnd; ++p)
+			h = _rotl64(h ^ (*p * PRIME64_5), 11) * PRIME64_1;
+
+		h ^= h >> 33;
+		h *= PRIME64_2;
+		h ^= h >> 29;
+		h *= PRIME64_3;
+		h ^= h >> 32;
+		return h;
+	}
+
+	//
+	// Mix one word into a lane
+	//
+	ULONGLONG Hash64::Round(ULONGLONG ullAcc, ULONGLONG ullInput) {
+		return _rotl64(ullAcc + ullInput * PRIME64_2, 31) * PRIME64_1;
+	}
+
+	//
+	// Fold one lane into the hash
+	//
+	ULONGLONG Hash64::Merge(ULONGLONG ullAcc, ULONGLONG ullLane) {
+		return (ullAcc ^ Round(0, ullLane)) * PRIME64_1 + PRIME64_4;
+	}
+
+	//
+	// MappedFile
+	//
+	// File read through one mapped view at a time.
+	//
+	class MappedFile
+	{
+	public:
+						MappedFile() : m_hFile(INVALID_HANDLE_VALUE), m_hMapping(0), m_pView(0) {}
+						~MappedFile() { Close(); }
+
+		HRESULT			Open(const CString& szPath, ULONGLONG ullSize);
+		const BYTE*		Map(ULONGLONG ullOffset, size_t cb);
+		void			Close();
+
+	private:
+		HANDLE			m_hFile;		// File, or INVALID_HANDLE_VALUE.
+		HANDLE			m_hMapping;		// Mapping of the file, or 0.
+		const BYTE*		m_pView;		// Mapped view, or 0.
+
+		// THESE METHODS ARE NOT IMPLEMENTED.
+						MappedFile(const MappedFile&);
+		MappedFile&		operator=(const MappedFile&);
+	};
+
+	//
+	// Open a file for mapping
+	//
+	// @param szPath Path of the file.
+	// @param ullSize Size the scan found; a file that changed size since fails.
+	// @return Result code.
+	//
+	HRESULT MappedFile::Open(const CString& szPath, ULONGLONG ullSize) {
+		// Writers are kept out while the file is read.
+		m_hFile = ::CreateFile(szPath, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+		if (m_hFile == INVALID_HANDLE_VALUE)
+			return HRESULT_FROM_WIN32(::GetLastError());
+		LARGE_INTEGER liSize;
+		if (!::GetFileSizeEx(m_hFile, &liSize) || static_cast<ULONGLONG>(liSize.QuadPart) != ullSize)
+			return HRESULT_FROM_WIN32(ERROR_FILE_INVALID);
+		m_hMapping = ::CreateFileMapping(m_hFile, 0, PAGE_READONLY, 0, 0, 0);
+		return m_hMapping != 0 ? S_OK : HRESULT_FROM_WIN32(::GetLastError());
+	}
+
+	//
+	// Map a part of the file, in place of the previous one
+	//
+	// @param ullOffset Offset of the part; a multiple of the allocation granularity.
+	// @param cb Length of the part.
+	// @return View, or 0 on failure.
+	//
+	const BYTE* MappedFile::Map(ULONGLONG ullOffset, size_t cb) {
+		if (m_pView != 0)
+			::UnmapViewOfFile(m_pView);
+		m_pView = static_cast<const BYTE*>(::MapViewOfFile(m_hMapping, FILE_MAP_READ,
+			static_cast<DWORD>(ullOffset >> 32), static_cast<DWORD>(ullOffset), cb));
+		return m_pView;
+	}
+
+	//
+	// Unmap and close the file
+	//
+	void MappedFile::Close() {
+		if (m_pView != 0)
+			::UnmapViewOfFile(m_pView);
+		if (m_hMapping != 0)
+			::CloseHandle(m_hMapping);
+		if (m_hFile != INVALID_HANDLE_VALUE)
+			::CloseHandle(m_hFile);
+		m_pView = 0;
+		m_hMapping = 0;
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+
+	//
+	// Hash a mapped view. A read error of the file surfaces as an exception
+	// while the view is touched; it fails the view instead.
+	//
+	bool HashView(Hash64& hash, const BYTE* pView, size_t cb) {
+		__try {
+			hash.Update(pView, cb);
+			return true;
+		} __except (::GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+			return false;
+		}
+	}
+
+	//
+	// Compare two mapped views, failing on read errors as HashView() does
+	//
+	bool CompareViews(const BYTE* pView1, const BYTE* pView2, size_t cb, bool& bSame) {
+		__try {
+			bSame = memcmp(pView1, pView2, cb) == 0;
+			return true;
+		} __except (::GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+			return false;
+		}
+	}
+
+	//
+	// Entry of a collision group, sorted by group and size
+	//
+	struct Member
+	{
+		UINT		uGroup;			// First move of the name.
+		ULONGLONG	ullSize;		// File size.
+		UINT		uIndex;			// Move, or destination node.
+		bool		bParent;		// uIndex is a destination node.
+
+		bool		operator<(const Member& other) const
+		{
+			return uGroup != other.uGroup ? uGroup < other.uGroup : ullSize < other.ullSize;
+		}
+	};
+
+	//
+	// Hashed candidate, sorted by size and hash
+	//
+	struct Content
+	{
+		ULONGLONG	ullSize;		// File size.
+		ULONGLONG	ullHash;		// Hash of the content.
+		UINT		uCandidate;		// Candidate index.
+
+		bool		operator<(const Content& other) const
+		{
+			return ullSize != other.ullSize ? ullSize < other.ullSize : ullHash < other.ullHash;
+		}
+	};
+}
+
+//
+// ZapDedup::StepTask
+//
+// Hashes one candidate or classifies one run on the work pool.
+//
+class ZapDedup::StepTask : public ZapTask
+{
+public:
+	StepTask(ZapDedup& dedup, Step step, UINT uIndex)
+		: m_Dedup(dedup), m_Step(step), m_uIndex(uIndex) {}
+
+	virtual void Run(ZapWorkPool&, UINT)
+	{
+		(m_Dedup.*m_Step)(m_uIndex);
+	}
+
+private:
+	ZapDedup&	m_Dedup;	// Comparison the step belongs to.
+	Step		m_Step;		// Step to run.
+	UINT		m_uIndex;	// Candidate or run the step works on.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+	StepTask&	operator=(const StepTask&);
+};
+
+//
+// Constructor.
+//
+// @param plan Plan whose collisions are compared. Must outlive the comparison.
+// @param pParent Destination folder the collisions were found with, or 0.
+//
+ZapDedup::ZapDedup(const ZapMovePlan& plan, const ZapTree* pParent)
+	: m_Plan(plan),
+	  m_pParent(pParent),
+	  m_vCandidates(),
+	  m_vOrder(),
+	  m_vRuns(),
+	  m_vMoves(),
+	  m_vParents(),
+	  m_llHashed(0),
+	  m_lHashed(0),
+	  m_pStats(0),
+	  m_pCancel(0)
+{
+}
+
+//
+// Count the bytes hashed by the next comparison
+//
+// @param pStats Counters to add to, or 0.
+//
+void ZapDedup::SetStats(ZapStats* pStats) {
+	m_pStats = pStats;
+}
+
+//
+// Stop the next comparison when a token is cancelled
+//
+// @param pCancel Token looked at before each file and each view, or 0.
+//
+void ZapDedup::SetCancel(const ZapCancel* pCancel) {
+	m_pCancel = pCancel;
+}
+
+//
+// Compare
+//
+// Sorts out which colliding files hold the same bytes. Entries with the same
+// name form a group; within a group, only files of the same size are read.
+// The candidates are hashed in parallel, then those with the same size and
+// hash are compared byte for byte, one run of them per task.
+//
+// @param vCollisions Collisions found by ZapMovePlan::FindCollisions().
+// @param uThreads Number of threads; 0 picks a default, 1 reads on the calling thread.
+// @return Result code; ERROR_CANCELLED if the token was cancelled. A file
+//         that cannot be read is only left out.
+//
+HRESULT ZapDedup::Compare(const std::vector<ZapCollision>& vCollisions, UINT uThreads) {
+	const ZapTree& tree = m_Plan.GetTree();
+	m_vCandidates.clear();
+	m_vOrder.clear();
+	m_vRuns.clear();
+	m_vMoves.assign(m_Plan.GetCount(), NONE);
+	m_vParents.assign(m_pParent != 0 ? m_pParent->GetCount() : 0, NONE);
+	m_llHashed = 0;
+	m_lHashed = 0;
+
+	// A collision always names the first move of its name, which names the group.
+	std::vector<Member> vMembers;
+	std::vector<bool> vAdded(m_Plan.GetCount(), false);
+	for (size_t i = 0; i < vCollisions.size(); ++i) {
+		const ZapCollision& collision = vCollisions[i];
+		if (collision.kind == ZapCollision::FOLDER)
+			continue;
+		bool bSibling = collision.kind == ZapCollision::SIBLING;
+		UINT uGroup = static_cast<UINT>(bSibling ? collision.iOther : collision.iMove);
+		UINT vMoves[2] = { uGroup, static_cast<UINT>(collision.iMove) };
+		for (int iSide = 0; iSide < 2; ++iSide) {
+			UINT uMove = vMoves[iSide];
+			if (vAdded[uMove])
+				continue;
+			vAdded[uMove] = true;
+			const ZapNode& node = tree.GetNode(m_Plan.GetMove(uMove).uNode);
+			if (!node.IsDirectory()) {
+				Member member = { uGroup, node.ullSize, uMove, false };
+				vMembers.push_back(member);
+			}
+		}
+		if (!bSibling) {
+			// Each destination entry collides at most once.
+			const ZapNode& node = m_pParent->GetNode(static_cast<UINT>(collision.iOther));
+			if (!node.IsDirectory()) {
+				Member member = { uGroup, node.ullSize, static_cast<UINT>(collision.iOther), true };
+				vMembers.push_back(member);
+			}
+		}
+	}
+
+	// Files alone with their size in their group cannot be the same as another.
+	std::sort(vMembers.begin(), vMembers.end());
+	for (size_t i = 0; i < vMembers.size(); ) {
+		size_t j = i + 1;
+		while (j < vMembers.size() && !(vMembers[i] < vMembers[j]))
+			++j;
+		if (j - i < 2) {
+			i = j;
+			continue;
+		}
+		for (; i < j; ++i) {
+			const Member& member = vMembers[i];
+			Candidate candidate;
+			candidate.uNode = member.bParent ? member.uIndex : m_Plan.GetMove(member.uIndex).uNode;
+			candidate.bParent = member.bParent;
+			candidate.ullSize = member.ullSize;
+			candidate.ullHash = 0;
+			candidate.hRes = S_OK;
+			candidate.uClass = 0;
+			(member.bParent ? m_vParents : m_vMoves)[member.uIndex] = static_cast<UINT>(m_vCandidates.size());
+			m_vCandidates.push_back(candidate);
+		}
+	}
+
+	if (uThreads == 0)
+		uThreads = ZapWorkPool::GetDefaultThreadCount();
+	RunSteps(uThreads, &ZapDedup::HashCandidate, m_vCandidates.size());
+	if (IsCancelled())
+		return HRESULT_FROM_WIN32(ERROR_CANCELLED);
+
+	// Runs of equal size and hash are confirmed byte for byte.
+	std::vector<Content> vContents;
+	vContents.reserve(m_vCandidates.size());
+	for (size_t i = 0; i < m_vCandidates.size(); ++i) {
+		if (FAILED(m_vCandidates[i].hRes))
+			continue;
+		Content content = { m_vCandidates[i].ullSize, m_vCandidates[i].ullHash, static_cast<UINT>(i) };
+		vContents.push_back(content);
+	}
+	std::sort(vContents.begin(), vContents.end());
+	for (size_t i = 0; i < vContents.size(); ) {
+		size_t j = i + 1;
+		while (j < vContents.size() && !(vContents[i] < vContents[j]))
+			++j;
+		if (j - i > 1) {
+			m_vRuns.push_back(static_cast<UINT>(m_vOrder.size()));
+			for (; i < j; ++i)
+				m_vOrder.push_back(vContents[i].uCandidate);
+			m_vRuns.push_back(static_cast<UINT>(m_vOrder.size()));
+		}
+		i = j;
+	}
+	RunSteps(uThreads, &ZapDedup::ClassifyRun, m_vRuns.size() / 2);
+
+	ZAP_LOG_INFO(L"Dedup | %Iu candidates, %ld hashed, %I64d bytes, %Iu runs | %s\n",
+		m_vCandidates.size(), m_lHashed, m_llHashed, m_vRuns.size() / 2, tree.GetRoot());
+	return IsCancelled() ? HRESULT_FROM_WIN32(ERROR_CANCELLED) : S_OK;
+}
+
+//
+// IsSame
+//
+// Do the two entries of a collision hold the same bytes. Only valid for the
+// collisions given to Compare(), with the moves still at their indexes.
+//
+// @param iMove Colliding move.
+// @param kind SIBLING or PARENT; FOLDER collisions are never the same.
+// @param iOther Move for SIBLING, node of the destination tree for PARENT.
+// @return true if both are files with the same content.
+//
+bool ZapDedup::IsSame(size_t iMove, ZapCollision::Kind kind, size_t iOther) const {
+	if (iMove >= m_vMoves.size() || kind == ZapCollision::FOLDER)
+		return false;
+	const std::vector<UINT>& vOthers = kind == ZapCollision::SIBLING ? m_vMoves : m_vParents;
+	UINT uCandidate = m_vMoves[iMove];
+	UINT uOther = iOther < vOthers.size() ? vOthers[iOther] : NONE;
+	if (uCandidate == NONE || uOther == NONE)
+		return false;
+	UINT uClass = m_vCandidates[uCandidate].uClass;
+	return uClass != 0 && uClass == m_vCandidates[uOther].uClass;
+}
+
+//
+// Number of files the last comparison hashed
+//
+size_t ZapDedup::GetHashedCount() const {
+	return static_cast<size_t>(m_lHashed);
+}
+
+//
+// Number of bytes the last comparison hashed
+//
+ULONGLONG ZapDedup::GetHashedBytes() const {
+	return static_cast<ULONGLONG>(m_llHashed);
+}
+
+//
+// Run a step for every index, on a work pool unless there are only a few
+//
+void ZapDedup::RunSteps(UINT uThreads, Step step, size_t nSteps) {
+	if (uThreads < 2 || nSteps < PARALLEL_THRESHOLD) {
+		for (size_t i = 0; i < nSteps; ++i)
+			(this->*step)(static_cast<UINT>(i));
+		return;
+	}
+	ZapWorkPool pool(uThreads);
+	for (size_t i = 0; i < nSteps; ++i)
+		pool.Submit(new StepTask(*this, step, static_cast<UINT>(i)));
+	pool.Wait();
+}
+
+//
+// HashCandidate
+//
+// Hashes one candidate. Empty files need no reading.
+//
+void ZapDedup::HashCandidate(UINT uIndex) {
+	Candidate& candidate = m_vCandidates[uIndex];
+	if (candidate.ullSize == 0)
+		return;
+	if (IsCancelled()) {
+		candidate.hRes = HRESULT_FROM_WIN32(ERROR_CANCELLED);
+		return;
+	}
+	CString szPath = GetPath(candidate);
+	candidate.hRes = HashFile(szPath, candidate.ullSize, candidate.ullHash);
+	if (FAILED(candidate.hRes)) {
+		ZAP_LOG_WARNING(L"HASH_FAILED 0x%08x: %s\n", candidate.hRes, szPath);
+		return;
+	}
+	::InterlockedExchangeAdd64(&m_llHashed, static_cast<LONGLONG>(candidate.ullSize));
+	::InterlockedIncrement(&m_lHashed);
+	if (m_pStats != 0)
+		m_pStats->Add(ZapStats::HASHED, static_cast<LONGLONG>(candidate.ullSize));
+}
+
+//
+// ClassifyRun
+//
+// Gives the same class to the candidates of a run of equal size and hash
+// that compare equal byte for byte. Each one is compared with the first
+// candidate of every class found so far in the run, which is a single
+// comparison unless the hashes collided.
+//
+void ZapDedup::ClassifyRun(UINT uRun) {
+	std::vector<UINT> vFirsts;
+	for (UINT i = m_vRuns[2 * uRun]; i < m_vRuns[2 * uRun + 1]; ++i) {
+		Candidate& candidate = m_vCandidates[m_vOrder[i]];
+		CString szPath = GetPath(candidate);
+		for (size_t j = 0; j < vFirsts.size() && candidate.uClass == 0; ++j) {
+			const Candidate& first = m_vCandidates[vFirsts[j]];
+			bool bSame = false;
+			if (SUCCEEDED(CompareFiles(GetPath(first), szPath, candidate.ullSize, bSame)) && bSame)
+				candidate.uClass = first.uClass;
+		}
+		if (candidate.uClass == 0) {
+			candidate.uClass = m_vOrder[i] + 1;
+			vFirsts.push_back(m_vOrder[i]);
+		}
+	}
+}
+
+//
+// Path of a candidate
+//
+CString ZapDedup::GetPath(const Candidate& candidate) const {
+	return candidate.bParent ? m_pParent->GetPath(candidate.uNode) : m_Plan.GetTree().GetPath(candidate.uNode);
+}
+
+//
+// Was the comparison cancelled
+//
+bool ZapDedup::IsCancelled() const {
+	return m_pCancel != 0 && m_pCancel->IsCancelled();
+}
+
+//
+// HashFile
+//
+// Hashes a file one mapped view at a time.
+//
+// @param szPath Path of the file.
+// @param ullSize Size of the file.
+// @param ullHash Receives the hash.
+// @return Result code.
+//
+HRESULT ZapDedup::HashFile(const CString& szPath, ULONGLONG ullSize, ULONGLONG& ullHash) const {
+	MappedFile file;
+	HRESULT hRes = file.Open(szPath, ullSize);
+	Hash64 hash(ullSize);
+	for (ULONGLONG ullOffset = 0; SUCCEEDED(hRes) && ullOffset < ullSize; ullOffset += VIEW_SIZE) {
+		if (IsCancelled())
+			return HRESULT_FROM_WIN32(ERROR_CANCELLED);
+		size_t cb = static_cast<size_t>(ullSize - ullOffset < VIEW_SIZE ? ullSize - ullOffset : VIEW_SIZE);
+		const BYTE* pView = file.Map(ullOffset, cb);
+		if (pView == 0)
+			hRes = HRESULT_FROM_WIN32(::GetLastError());
+		else if (!HashView(hash, pView, cb))
+			hRes = HRESULT_FROM_WIN32(ERROR_READ_FAULT);
+	}
+	if (SUCCEEDED(hRes))
+		ullHash = hash.Finish();
+	return hRes;
+}
+
+//
+// CompareFiles
+//
+// Compares two files of the same size byte for byte, one pair of mapped
+// views at a time, and stops at the first difference.
+//
+// @param szPath1 Path of the first file.
+// @param szPath2 Path of the second file.
+// @param ullSize Size of both files.
+// @param bSame Receives whether the contents are equal.
+// @return Result code.
+//
+HRESULT ZapDedup::CompareFiles(const CString& szPath1, const CString& szPath2,
+							   ULONGLONG ullSize, bool& bSame) const {
+	bSame = true;
+	if (ullSize == 0)
+		return S_OK;
+	MappedFile file1, file2;
+	HRESULT hRes = file1.Open(szPath1, ullSize);
+	if (SUCCEEDED(hRes))
+		hRes = file2.Open(szPath2, ullSize);
+	for (ULONGLONG ullOffset = 0; SUCCEEDED(hRes) && bSame && ullOffset < ullSize; ullOffset += VIEW_SIZE) {
+		if (IsCancelled())
+			return HRESULT_FROM_WIN32(ERROR_CANCELLED);
+		size_t cb = static_cast<size_t>(ullSize - ullOffset < VIEW_SIZE ? ullSize - ullOffset : VIEW_SIZE);
+		const BYTE* pView1 = file1.Map(ullOffset, cb);
+		const BYTE* pView2 = pView1 != 0 ? file2.Map(ullOffset, cb) : 0;
+		if (pView2 == 0)
+			hRes = HRESULT_FROM_WIN32(::GetLastError());
+		else if (!CompareViews(pView1, pView2, cb, bSame))
+			hRes = HRESULT_FROM_WIN32(ERROR_READ_FAULT);
+	}
+	if (FAILED(hRes))
+		bSame = false;
+	return hRes;
+}
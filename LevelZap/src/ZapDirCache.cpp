@@ -0,0 +1,135 @@
+// ZapDirCache.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapDirCache.h"
+#include "ZapNt.h"
+
+//
+// Constructor.
+//
+// @param tree Scanned tree. Must outlive the cache.
+// @param uBudget Maximum number of open handles; 0 uses ZapTree::DEFAULT_HANDLE_BUDGET.
+//
+ZapDirCache::ZapDirCache(const ZapTree& tree, UINT uBudget)
+	: m_Tree(tree),
+	  m_uBudget(uBudget ? uBudget : ZapTree::DEFAULT_HANDLE_BUDGET),
+	  m_uOpen(0),
+	  m_vEntries(),
+	  m_dqOpened(),
+	  m_cs()
+{
+	Entry empty = { 0, 0 };
+	m_vEntries.assign(tree.GetCount(), empty);
+}
+
+//
+// Destructor. Closes every handle.
+//
+ZapDirCache::~ZapDirCache()
+{
+	for (size_t i = 0; i < m_vEntries.size(); ++i)
+		if (m_vEntries[i].hDir != 0)
+			::CloseHandle(m_vEntries[i].hDir);
+}
+
+//
+// Acquire
+//
+// Returns an open handle to a directory of the tree, opening it if needed.
+// Every successful call must be matched by Release().
+//
+// @param uNode Directory node.
+// @return Directory handle, or 0 if it could not be opened within the budget;
+//         callers then fall back to paths.
+//
+HANDLE ZapDirCache::Acquire(UINT uNode) {
+	CComCritSecLock<CComAutoCriticalSection> lock(m_cs);
+	Entry& entry = m_vEntries[uNode];
+	if (entry.hDir == 0) {
+		if (m_uOpen >= m_uBudget && !Evict())
+			return 0;
+		entry.hDir = Open(uNode);
+		if (entry.hDir == 0)
+			return 0;
+		++m_uOpen;
+		m_dqOpened.push_back(uNode);
+	}
+	++entry.lRefs;
+	return entry.hDir;
+}
+
+//
+// Release a handle returned by Acquire()
+//
+void ZapDirCache::Release(UINT uNode) {
+	CComCritSecLock<CComAutoCriticalSection> lock(m_cs);
+	--m_vEntries[uNode].lRefs;
+}
+
+//
+// Open
+//
+// Opens a directory relative to its parent, or by path when the parent cannot
+// be opened. Called with m_cs held.
+//
+HANDLE ZapDirCache::Open(UINT uNode) {
+	HANDLE hDir = 0;
+	if (uNode != ZapTree::ROOT) {
+		const ZapNode& node = m_Tree.GetNode(uNode);
+		HANDLE hParent = Acquire(node.uParent);
+		if (hParent != 0) {
+			HRESULT hRes = ZapNt::OpenDirectory(hParent, node.pszName, node.cchName, hDir);
+			Release(node.uParent);
+			if (SUCCEEDED(hRes))
+				return hDir;
+		}
+	}
+	if (SUCCEEDED(ZapNt::OpenDirectory(m_Tree.GetPath(uNode), hDir)))
+		return hDir;
+	return 0;
+}
+
+//
+// Evict
+//
+// Closes the oldest handle that nobody is using. Called with m_cs held.
+//
+// @return A handle was closed.
+//
+bool ZapDirCache::Evict() {
+	for (size_t n = m_dqOpened.size(); n > 0; --n) {
+		UINT uNode = m_dqOpened.front();
+		m_dqOpened.pop_front();
+		Entry& entry = m_vEntries[uNode];
+		if (entry.hDir == 0)
+			continue;
+		if (entry.lRefs != 0) {
+			m_dqOpened.push_back(uNode);
+			continue;
+		}
+		::CloseHandle(entry.hDir);
+		entry.hDir = 0;
+		--m_uOpen;
+		return true;
+	}
+	return false;
+}
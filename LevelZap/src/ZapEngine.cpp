@@ -0,0 +1,766 @@
+// ZapEngine.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapEngine.h"
+#include "Utilities.h"
+#include "ZapCancel.h"
+#include "ZapDedup.h"
+#include "ZapJournal.h"
+#include "ZapLog.h"
+#include "ZapPathBuilder.h"
+#include "ZapPruner.h"
+#include "ZapSettings.h"
+
+namespace {
+
+	// Command line names of the collision policies, in ZapCollision::Policy order.
+	const wchar_t* const POLICY_NAMES[ZapCollision::POLICY_COUNT] = {
+		L"fail", L"rename", L"prefix", L"newer", L"larger", L"skip", L"abort"
+	};
+
+	// Command line name of bReplace; collisions are then replaced as they are moved.
+	const wchar_t REPLACE_NAME[] = L"replace";
+
+	//
+	// A move the journal does not record looks done: its source is gone and
+	// its destination is the entry that was planned, with the same size and
+	// last write time, not one the move left alone or merged into
+	//
+	bool IsMovedAsPlanned(const ZapNode& node, LPCWSTR pszFrom, LPCWSTR pszTo) {
+		if (::GetFileAttributes(pszFrom) != INVALID_FILE_ATTRIBUTES)
+			return false;
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!::GetFileAttributesEx(pszTo, GetFileExInfoStandard, &data))
+			return false;
+		ULONGLONG ullSize = (static_cast<ULONGLONG>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+		bool bSame = ((data.dwFileAttributes ^ node.dwAttributes) & FILE_ATTRIBUTE_DIRECTORY) == 0
+			&& (node.IsDirectory() || ullSize == node.ullSize)
+			&& ::CompareFileTime(&data.ftLastWriteTime, &node.ftWrite) == 0;
+		if (!bSame)
+			ZAP_LOG_WARNING(L"NOT_RESTORED: %s is not the entry moved from %s\n", pszTo, pszFrom);
+		return bSame;
+	}
+}
+
+//
+// Constructor.
+//
+// @param options Settings of every zap run by this engine.
+//
+ZapEngine::ZapEngine(const ZapOptions& options)
+	: m_Options(options),
+	  m_pCancel(0),
+	  m_pFilter(0)
+{
+}
+
+//
+// LoadOptions
+//
+// Reads the zap settings from one settings snapshot. Recursion is not a
+// setting; it is left as it is.
+//
+// @param options Receives the settings.
+//
+void ZapEngine::LoadOptions(ZapOptions& options) {
+	const ZapSettings& settings = ZapSettings::Current();
+	options.bNativeMove = settings.GetDWORD(L"NativeMove") != 0;
+	options.bReplace = FALSE;
+	options.uCollisionPolicy = settings.GetDWORD(L"CollisionPolicy");
+	if (options.uCollisionPolicy >= ZapCollision::POLICY_COUNT)
+		options.uCollisionPolicy = ZapCollision::ASK;
+	options.uScanThreads = settings.GetDWORD(L"ScanThreads");
+	options.uQueueDepth = settings.GetDWORD(L"QueueDepth");
+	options.uHandleBudget = settings.GetDWORD(L"HandleBudget");
+	options.uListBuffer = settings.GetDWORD(L"ListBuffer");
+	options.bDedup = settings.GetDWORD(L"Dedup") != 0;
+	options.uDepth = settings.GetDWORD(L"ZapDepth");
+	options.bJournal = settings.GetDWORD(L"Journal", 1) != 0;
+	options.bRollback = settings.GetDWORD(L"Recovery") == 1;
+	options.uUndoDepth = settings.GetDWORD(L"UndoDepth", 8);
+}
+
+//
+// SetCollisionPolicy
+//
+// Sets how collisions are handled from a command line name: "fail" leaves
+// the colliding entries to fail, "replace" replaces what is in the way, and
+// the other names pick the matching ZapCollision policy.
+//
+// @param options Receives the policy.
+// @param szName Name of the policy.
+// @return The name is known; options are left alone otherwise.
+//
+bool ZapEngine::SetCollisionPolicy(ZapOptions& options, const CString& szName) {
+	if (szName == REPLACE_NAME) {
+		options.bReplace = TRUE;
+		options.uCollisionPolicy = ZapCollision::ASK;
+		return true;
+	}
+	for (UINT i = 0; i < ZapCollision::POLICY_COUNT; ++i) {
+		if (szName == POLICY_NAMES[i]) {
+			options.bReplace = FALSE;
+			options.uCollisionPolicy = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+//
+// Command line name of the collision handling of some options
+//
+LPCWSTR ZapEngine::GetCollisionPolicyName(const ZapOptions& options) {
+	if (options.bReplace && options.uCollisionPolicy == ZapCollision::ASK)
+		return REPLACE_NAME;
+	return POLICY_NAMES[options.uCollisionPolicy < ZapCollision::POLICY_COUNT ? options.uCollisionPolicy : 0];
+}
+
+//
+// SetCancel
+//
+// Lets the zaps of this engine be cancelled from another thread. A scan stops
+// before its next directory and a move before its next entry; whatever a
+// cancelled zap had already moved is then moved back.
+//
+// @param p_pCancel Token to watch, or 0; must outlive the zaps.
+//
+void ZapEngine::SetCancel(const ZapCancel* p_pCancel) {
+	m_pCancel = p_pCancel;
+}
+
+//
+// The zaps of this engine were cancelled
+//
+bool ZapEngine::IsCancelled() const {
+	return m_pCancel != 0 && m_pCancel->IsCancelled();
+}
+
+//
+// SetFilter
+//
+// Leaves out of the zaps of this engine the entries a filter excludes. They
+// stay in the zapped folder, which is then kept unless a UI confirms its
+// deletion.
+//
+// @param p_pFilter Compiled rules, or 0 to move everything; must outlive the zaps.
+//
+void ZapEngine::SetFilter(const ZapFilter* p_pFilter) {
+	m_pFilter = p_pFilter;
+}
+
+//
+// Zap
+//
+// Moves the entire content of the given directory up one level and then "zaps" the directory.
+//
+// @param p_hParentWnd Handle of parent window for Shell progress and error UI.
+//                     If this is set to 0, we will not show any UI.
+// @param p_Folder Folder path.
+// @param p_pStats Receives the counters and phase times of the zap; may be 0.
+// @return Result code; S_FALSE if the content was moved but the folder was kept.
+//
+HRESULT ZapEngine::Zap(const HWND p_hParentWnd, CString p_Folder, ZapStats* p_pStats) const {
+	ZapJob job;
+	HRESULT hRes = Plan(p_Folder, job, p_pStats);
+	if (FAILED(hRes))
+		return hRes;
+	return Execute(p_hParentWnd, job, p_pStats);
+}
+
+//
+// Plan
+//
+// Scans a folder and plans its zap, collisions resolved, without moving
+// anything.
+//
+// @param p_Folder Folder path.
+// @param p_rJob Receives the planned zap.
+// @param p_pStats Receives the counters and phase times of the planning; may be 0.
+// @return Result code; the failure of the collision policy if it refuses the plan.
+//
+HRESULT ZapEngine::Plan(CString p_Folder, ZapJob& p_rJob, ZapStats* p_pStats) const {
+	return Plan(p_Folder, 0, p_rJob, p_pStats);
+}
+
+//
+// Plan
+//
+// Plans the zap of a folder against a scan of its destination made once for
+// several folders with the same parent, so that it is not scanned again for
+// each of them.
+//
+// @param p_Folder Folder path.
+// @param p_pParent Parent folder scanned without recursion; 0 scans it here.
+// @param p_rJob Receives the planned zap.
+// @param p_pStats Receives the counters and phase times of the planning; may be 0.
+// @return Result code; the failure of the collision policy if it refuses the plan.
+//
+HRESULT ZapEngine::Plan(CString p_Folder, const ZapTree* p_pParent, ZapJob& p_rJob, ZapStats* p_pStats) const {
+	ZapStats::Clock clock(p_pStats);
+	CString folderName = Util::PathFindFolderName(p_Folder);
+	p_rJob.m_szFolder = p_Folder;
+	p_rJob.m_uDepth = m_Options.bRecursive ? m_Options.uDepth : 1;
+	p_rJob.m_bRename = FALSE;
+	p_rJob.m_bRestored = false;
+
+	// Scan the folder once; everything below is answered from this model.
+	ZapTree& tree = p_rJob.m_Tree;
+	tree.SetHandleBudget(m_Options.uHandleBudget);
+	tree.SetListBuffer(m_Options.uListBuffer);
+	tree.SetStats(p_pStats);
+	tree.SetCancel(m_pCancel);
+	tree.SetFilter(m_pFilter);
+	HRESULT hScan = tree.Scan(p_Folder, p_rJob.m_uDepth, m_Options.uScanThreads);
+	clock.Next(ZapStats::SCAN);
+	ZapLog::Flush();
+	if (IsCancelled())
+		return HRESULT_FROM_WIN32(ERROR_CANCELLED);
+	if (FAILED(hScan))
+		return E_FAIL;
+
+	// create list of files to move; renaming the folder later does not change its destination
+	ZapMovePlan& plan = p_rJob.m_Plan;
+	plan.Build(tree, Util::PathFindPreviousComponent(p_Folder), p_rJob.m_uDepth);
+	ZAP_LOG_INFO(L"Plan %Iu entries, %Iu bytes (%Iu bytes as path lists)\n",
+		plan.GetCount(), plan.GetFootprint(), plan.GetListFootprint());
+	clock.Next(ZapStats::PLAN);
+
+	// Check for name collissions, all of them up front
+	ZapTree parent;
+	parent.SetStats(p_pStats);
+	if (p_pParent == 0 && plan.GetCount() != 0) {
+		HRESULT hParent = parent.Scan(plan.GetDestination(), 1);
+		if (SUCCEEDED(hParent)) {
+			p_pParent = &parent;
+		} else if (m_Options.uCollisionPolicy != ZapCollision::ASK) {
+			// The policy cannot be applied to entries it does not see; they would be overwritten.
+			ZAP_LOG_ERROR(L"Parent 0x%08x | %s\n", hParent, plan.GetDestination());
+			if (p_pStats != 0)
+				p_pStats->Add(ZapStats::FAILURES);
+			clock.Next(ZapStats::COLLISION);
+			return hParent;
+		}
+	}
+	std::vector<ZapCollision> vCollisions;
+	plan.FindCollisions(folderName, p_pParent, vCollisions);
+	for (size_t i = 0; i < vCollisions.size(); ++i) {
+		if (vCollisions[i].kind == ZapCollision::FOLDER)
+			p_rJob.m_bRename = TRUE;
+		else
+			ZAP_LOG_WARNING(L"COLLISION: %s -> %s\n", plan.GetFromPath(vCollisions[i].iMove), plan.GetToPath(vCollisions[i].iMove));
+	}
+	p_rJob.m_nCollisions = vCollisions.size();
+	if (p_pStats != 0)
+		p_pStats->Add(ZapStats::COLLISIONS, static_cast<LONGLONG>(vCollisions.size()));
+
+	// Colliding files holding the same bytes are dropped rather than moved.
+	ZapDedup dedup(plan, p_pParent);
+	bool bDedup = m_Options.bDedup && !vCollisions.empty();
+	if (bDedup) {
+		clock.Next(ZapStats::COLLISION);
+		dedup.SetStats(p_pStats);
+		dedup.SetCancel(m_pCancel);
+		HRESULT hDedup = dedup.Compare(vCollisions, m_Options.uScanThreads);
+		clock.Next(ZapStats::DEDUP);
+		if (FAILED(hDedup))
+			return hDedup;
+	}
+	HRESULT hResolve = plan.Resolve(static_cast<ZapCollision::Policy>(m_Options.uCollisionPolicy),
+		p_pParent, vCollisions, bDedup ? &dedup : 0);
+	if (p_pStats != 0 && plan.GetDedupedCount() != 0) {
+		p_pStats->Add(ZapStats::DEDUPED, static_cast<LONGLONG>(plan.GetDedupedCount()));
+		p_pStats->Add(ZapStats::DEDUP_BYTES, static_cast<LONGLONG>(plan.GetDedupedBytes()));
+	}
+	clock.Next(ZapStats::COLLISION);
+	ZapLog::Flush();
+	if (FAILED(hResolve)) {
+		ZAP_LOG_ERROR(L"Collisions 0x%08x | %s\n", hResolve, p_Folder);
+		if (p_pStats != 0)
+			p_pStats->Add(ZapStats::FAILURES);
+		return hResolve;
+	}
+	return S_OK;
+}
+
+//
+// Execute
+//
+// Runs a planned zap: renames the folder out of the way if needed, moves its
+// content up and deletes it. A job loaded from a file was planned against a
+// folder that may have changed since, so its scan is not trusted to prove
+// the folder empty. With bJournal set, the zap is journaled so that Recover()
+// can finish or undo it if it is interrupted, and the journal is then kept
+// so that Unzap() can undo it.
+//
+// @param p_hParentWnd Handle of parent window for Shell progress and error UI.
+//                     If this is set to 0, we will not show any UI.
+// @param p_rJob Planned zap; its tree follows the folder if it is renamed.
+// @param p_pStats Receives the counters and phase times of the zap; may be 0.
+// @return Result code; S_FALSE if the content was moved but the folder was kept.
+//
+HRESULT ZapEngine::Execute(const HWND p_hParentWnd, ZapJob& p_rJob, ZapStats* p_pStats) const {
+	ZapJournal journal;
+	if (m_Options.bJournal) {
+		HRESULT hJournal = journal.Begin(p_rJob);
+		if (FAILED(hJournal))
+			ZAP_LOG_WARNING(L"No journal 0x%08x | %s\n", hJournal, p_rJob.GetFolder());
+	}
+	// Without a journal file, the moves are still followed so that a cancel can undo them.
+	journal.Track(p_rJob);
+	HRESULT hRes = Run(p_hParentWnd, p_rJob, journal, p_pStats);
+	if (FAILED(hRes) && IsCancelled()) {
+		// Cancelled: what was moved goes back, so that the folder is as it was.
+		HRESULT hBack = Rollback(journal, p_rJob);
+		ZAP_LOG_INFO(L"Cancelled 0x%08x | %s\n", hBack, p_rJob.GetFolder());
+		journal.Commit();
+		return HRESULT_FROM_WIN32(ERROR_CANCELLED);
+	}
+	// The zap ran to its end, whatever came of it; there is nothing left to recover.
+	if (journal.IsMoved() && m_Options.uUndoDepth != 0)
+		journal.Keep(m_Options.uUndoDepth);
+	else
+		journal.Commit();
+	return hRes;
+}
+
+//
+// Run
+//
+// Executes a planned zap, recording its progress in a journal.
+//
+// @param p_rJournal Journal of the zap; ignored if it tracks nothing.
+// @return Result code; S_FALSE if the content was moved but the folder was kept.
+//
+HRESULT ZapEngine::Run(const HWND p_hParentWnd, ZapJob& p_rJob, ZapJournal& p_rJournal, ZapStats* p_pStats) const {
+	// A restored job was not counted by Plan().
+	ZapStats::Clock clock(p_pStats, p_rJob.IsRestored());
+	ZapTree& tree = p_rJob.m_Tree;
+	const ZapMovePlan& plan = p_rJob.m_Plan;
+	CString p_Folder(p_rJob.GetFolder());
+	if (IsCancelled())
+		return HRESULT_FROM_WIN32(ERROR_CANCELLED);
+	if (p_pStats != 0)
+		p_pStats->Add(ZapStats::PLANNED, static_cast<LONGLONG>(plan.GetCount()));
+	if (p_rJob.NeedsRename()) {
+		// The new name is journaled first, so that an interrupted zap knows where its folder went.
+		CString _p_Folder(p_Folder);
+		p_Folder = Util::PathAppendGuid(_p_Folder);
+		p_rJournal.Rename(p_Folder);
+		if (!SUCCEEDED(Util::MoveFolderEx(_p_Folder, p_Folder)))
+			return E_FAIL;
+		tree.SetRoot(p_Folder);
+		clock.Next(ZapStats::COLLISION);
+	}
+
+	// move files and don't leave an empty folder
+	HRESULT hMove = MoveFile(p_hParentWnd, plan, p_rJournal, p_pStats);
+	p_rJournal.Moved(SUCCEEDED(hMove));
+	clock.Next(ZapStats::MOVE);
+	ZapLog::Flush();
+	if (SUCCEEDED(hMove)) {
+		// Everything the scan found has been moved, unless collisions kept some of it.
+		if (!p_rJob.IsRestored() && tree.IsComplete(p_rJob.GetDepth()) && plan.GetSkippedCount() == 0
+			&& SUCCEEDED(RemoveFolder(tree, p_rJob.GetDepth() != 1, p_pStats))) {
+			clock.Next(ZapStats::CLEANUP);
+			return S_OK;
+		}
+		// Only what is verifiably empty is removed without asking.
+		ZapTree left;
+		if (SUCCEEDED(left.Scan(p_Folder, ZapTree::ALL_LEVELS)) && left.IsEmpty() && SUCCEEDED(RemoveFolder(left, TRUE, p_pStats))) {
+			clock.Next(ZapStats::CLEANUP);
+			return S_OK;
+		}
+		// Without UI nobody can confirm; the folder is kept.
+		if (p_hParentWnd != 0)
+			DeleteFolder(p_hParentWnd, p_Folder);
+		clock.Next(ZapStats::CLEANUP);
+		return p_hParentWnd != 0 ? S_OK : S_FALSE;
+	}
+
+	// The move did not go through; look at what is actually left.
+	ZapTree left;
+	HRESULT hRes = E_FAIL;
+	if (SUCCEEDED(left.Scan(p_Folder, ZapTree::ALL_LEVELS)) && left.IsEmpty() && SUCCEEDED(RemoveFolder(left, TRUE, p_pStats)))
+		hRes = S_OK;
+	clock.Next(ZapStats::CLEANUP);
+	return hRes;
+}
+
+//
+// Recover
+//
+// Finishes the zaps a crash or a power loss interrupted, or rolls them back
+// if bRollback is set, from the journals they left. Only the moves their
+// journal does not record as done are looked at; nothing is rescanned.
+// Journals of zaps still running are left alone.
+//
+// @param p_hParentWnd Handle of parent window for Shell progress and error UI.
+//                     If this is set to 0, we will not show any UI.
+// @param p_pStats Receives the counters and phase times of resumed zaps; may be 0.
+// @return Result code; the failure of the last zap that could not be recovered.
+//
+HRESULT ZapEngine::Recover(const HWND p_hParentWnd, ZapStats* p_pStats) const {
+	std::vector<CString> vJournals;
+	HRESULT hRes = ZapJournal::FindPending(vJournals);
+	for (size_t i = 0; i < vJournals.size(); ++i) {
+		ZapJournal journal;
+		HRESULT hOpen = journal.Open(vJournals[i]);
+		if (hOpen == HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION))
+			continue;
+		ZapJob job;
+		HRESULT hRecover = hOpen;
+		if (SUCCEEDED(hRecover)) {
+			hRecover = journal.IsPlanned() ? job.Load(journal.GetPlanPath()) : HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+			if (hRecover == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND)) {
+				// Cut short before anything moved, or once the zap was over.
+				journal.Commit();
+				continue;
+			}
+		}
+		if (SUCCEEDED(hRecover)) {
+			hRecover = m_Options.bRollback ? Rollback(journal, job) : Resume(p_hParentWnd, journal, job, p_pStats);
+			// Whatever came of it, the zap has now been run to its end; a finished one can still be undone.
+			if (!m_Options.bRollback && m_Options.uUndoDepth != 0)
+				journal.Keep(m_Options.uUndoDepth);
+			else
+				journal.Commit();
+		}
+		ZAP_LOG_INFO(L"Recover 0x%08x | %s %s\n", hRecover, m_Options.bRollback ? L"rollback" : L"resume", vJournals[i]);
+		if (FAILED(hRecover)) {
+			ZAP_LOG_ERROR(L"RECOVERY_FAILED 0x%08x: %s\n", hRecover, vJournals[i]);
+			hRes = hRecover;
+		}
+	}
+	ZapLog::Flush();
+	return hRes;
+}
+
+//
+// Resume
+//
+// Finishes an interrupted zap: runs the moves its journal does not record
+// as done and whose source is still there, then deletes the folder. A zap
+// cut short before its folder was renamed, including one whose rename was
+// not journaled yet, has not moved anything; it is run again in full, under
+// a new journal that records the new name.
+//
+// @param p_rJournal Journal of the zap, read.
+// @param p_rJob Plan of the zap, loaded from the journal.
+// @return Result code.
+//
+HRESULT ZapEngine::Resume(const HWND p_hParentWnd, ZapJournal& p_rJournal, ZapJob& p_rJob, ZapStats* p_pStats) const {
+	const CString& szRenamed = p_rJournal.GetRenamed();
+	bool bRenamed = !szRenamed.IsEmpty()
+		&& (p_rJournal.IsMoved() || ::GetFileAttributes(szRenamed) != INVALID_FILE_ATTRIBUTES);
+	if (!bRenamed && (p_rJob.NeedsRename() || !szRenamed.IsEmpty())) {
+		p_rJournal.Commit();
+		return Execute(p_hParentWnd, p_rJob, p_pStats);
+	}
+	if (bRenamed) {
+		p_rJob.m_bRename = FALSE;
+		p_rJob.m_szFolder = szRenamed;
+		p_rJob.m_Tree.SetRoot(szRenamed);
+	}
+	if (::GetFileAttributes(p_rJob.GetFolder()) == INVALID_FILE_ATTRIBUTES)
+		return S_OK;	// Deleted already.
+
+	ZapMovePlan& plan = p_rJob.m_Plan;
+	std::vector<ZapMove> vLeft;
+	if (!p_rJournal.IsMoved()) {
+		ZapPathBuilder from;
+		for (size_t i = 0; i < plan.GetCount(); ++i) {
+			if (p_rJournal.IsDone(i))
+				continue;
+			plan.GetFromPath(i, from);
+			if (::GetFileAttributes(from.GetString()) != INVALID_FILE_ATTRIBUTES)
+				vLeft.push_back(plan.GetMove(i));
+		}
+	}
+	ZAP_LOG_INFO(L"Resume %Iu of %Iu moves | %s\n", vLeft.size(), plan.GetCount(), p_rJob.GetFolder());
+	CString szTo(plan.GetDestination());
+	plan.Restore(p_rJob.m_Tree, szTo, vLeft, plan.GetSkippedCount());
+	// The original journal still covers this run.
+	ZapJournal none;
+	return Run(p_hParentWnd, p_rJob, none, p_pStats);
+}
+
+//
+// Unzap
+//
+// Undoes the last zap whose content went to a folder, with direct renames
+// from its undo record: the zapped folder is brought back with the entries
+// that were moved out of it. Entries that a move replaced cannot be restored.
+//
+// @param p_Folder Folder the content went to.
+// @return Result code; ERROR_FILE_NOT_FOUND if no zap into the folder can be undone.
+//
+HRESULT ZapEngine::Unzap(const CString& p_Folder) const {
+	std::vector<CString> vRecords;
+	HRESULT hRes = ZapJournal::FindUndo(p_Folder, vRecords);
+	if (FAILED(hRes))
+		return hRes;
+	for (size_t i = 0; i < vRecords.size(); ++i) {
+		ZapJournal journal;
+		if (FAILED(journal.Open(vRecords[i]))
+			|| Util::PathFindPreviousComponent(journal.GetFolder()).CompareNoCase(p_Folder) != 0)
+			continue;
+		ZapJob job;
+		hRes = job.Load(journal.GetPlanPath());
+		if (SUCCEEDED(hRes))
+			hRes = Rollback(journal, job);
+		// Undone as far as it could be; the record is spent either way.
+		journal.Commit();
+		ZAP_LOG_INFO(L"Unzap 0x%08x | %s\n", hRes, journal.GetFolder());
+		ZapLog::Flush();
+		return hRes;
+	}
+	return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+}
+
+//
+// Can a zap into a folder be undone
+//
+// @param p_Folder Folder the content went to.
+//
+bool ZapEngine::CanUnzap(const CString& p_Folder) {
+	std::vector<CString> vRecords;
+	return SUCCEEDED(ZapJournal::FindUndo(p_Folder, vRecords)) && !vRecords.empty();
+}
+
+//
+// Rollback
+//
+// Undoes a zap: moves back, last first, what its journal records as done
+// one by one and, for a zap that was interrupted or moved through the
+// Shell, what was moved without such a record, when the destination is the
+// entry the plan moved. Then gives the folder its name back. If the folder
+// was deleted, it is created again with the directories no move took.
+// Entries that a move replaced cannot be restored.
+//
+// @param p_Journal Journal of the zap, read.
+// @param p_rJob Plan of the zap, loaded from the journal.
+// @return Result code; the failure of the first entry that could not be moved back.
+//
+HRESULT ZapEngine::Rollback(const ZapJournal& p_Journal, ZapJob& p_rJob) const {
+	// The folder is only deleted once every move was attempted, so it is
+	// still there under its new name unless that point was reached.
+	const CString& szRenamed = p_Journal.GetRenamed();
+	bool bRenamed = !szRenamed.IsEmpty()
+		&& (p_Journal.IsMoved() || ::GetFileAttributes(szRenamed) != INVALID_FILE_ATTRIBUTES);
+	if (bRenamed)
+		p_rJob.m_Tree.SetRoot(szRenamed);
+
+	const ZapTree& tree = p_rJob.m_Tree;
+	const ZapMovePlan& plan = p_rJob.m_Plan;
+	ZapPathBuilder from, to;
+	if (::GetFileAttributes(tree.GetRoot()) == INVALID_FILE_ATTRIBUTES) {
+		// Parents come before their children, so whether an ancestor was moved is known in one pass.
+		std::vector<bool> vMoved(tree.GetCount(), false);
+		for (size_t i = 0; i < plan.GetCount(); ++i)
+			vMoved[plan.GetMove(i).uNode] = true;
+		::SHCreateDirectoryEx(0, tree.GetRoot(), 0);
+		for (UINT i = ZapTree::ROOT + 1; i < tree.GetCount(); ++i) {
+			const ZapNode& node = tree.GetNode(i);
+			vMoved[i] = vMoved[i] || vMoved[node.uParent];
+			if (!vMoved[i] && node.IsDirectory()) {
+				tree.GetPath(i, from);
+				::CreateDirectory(from.GetString(), 0);
+			}
+		}
+	}
+	HRESULT hRes = S_OK;
+	size_t nRestored = 0;
+	for (size_t i = plan.GetCount(); i-- > 0; ) {
+		plan.GetFromPath(i, from);
+		plan.GetToPath(i, to);
+		LPCWSTR pszFrom = from.GetString(), pszTo = to.GetString();
+		// A move not recorded by itself may have happened, e.g. through the Shell, which
+		// may also have put the entry under another name and left the destination alone.
+		if (!p_Journal.IsRecorded(i) && !IsMovedAsPlanned(tree.GetNode(plan.GetMove(i).uNode), pszFrom, pszTo))
+			continue;
+		BOOL bMoved = ::MoveFileEx(pszTo, pszFrom, MOVEFILE_COPY_ALLOWED);
+		if (!bMoved && ::GetLastError() == ERROR_PATH_NOT_FOUND) {
+			// The folder was partly deleted; bring its directories back.
+			::SHCreateDirectoryEx(0, Util::PathFindPreviousComponent(pszFrom), 0);
+			bMoved = ::MoveFileEx(pszTo, pszFrom, MOVEFILE_COPY_ALLOWED);
+		}
+		if (bMoved) {
+			++nRestored;
+		} else {
+			HRESULT hMove = HRESULT_FROM_WIN32(::GetLastError());
+			ZAP_LOG_ERROR(L"MOVE_FAILED 0x%08x: %s -> %s\n", hMove, pszTo, pszFrom);
+			if (SUCCEEDED(hRes))
+				hRes = hMove;
+		}
+	}
+	if (bRenamed) {
+		if (!::MoveFileEx(szRenamed, p_rJob.GetFolder(), 0)) {
+			HRESULT hMove = HRESULT_FROM_WIN32(::GetLastError());
+			ZAP_LOG_ERROR(L"MOVE_FAILED 0x%08x: %s -> %s\n", hMove, szRenamed, p_rJob.GetFolder());
+			if (SUCCEEDED(hRes))
+				hRes = hMove;
+		}
+	}
+	ZAP_LOG_INFO(L"Rollback 0x%08x | %Iu entries restored -> %s\n", hRes, nRestored, p_rJob.GetFolder());
+	return hRes;
+}
+
+//
+// MoveFile
+//
+// Move file(s)
+//
+// @param p_Plan Planned moves; the SHFileOperation lists are built from it here.
+//               With bNativeMove set, each entry is renamed directly instead.
+// @param p_rJournal Journal recording the native moves as they complete.
+// @param p_pStats Receives the counters of the moves; may be 0.
+//
+HRESULT ZapEngine::MoveFile(const HWND p_hParentWnd, const ZapMovePlan& p_Plan, ZapJournal& p_rJournal,
+							ZapStats* p_pStats) const {
+	if (p_Plan.GetCount() == 0) return S_OK;
+	if (m_Options.bNativeMove) {
+		ZapExecutor executor;
+		executor.SetHandleBudget(m_Options.uHandleBudget);
+		executor.SetReplaceExisting(m_Options.bReplace != FALSE);
+		executor.SetStats(p_pStats);
+		executor.SetJournal(p_rJournal.IsTracking() ? &p_rJournal : 0);
+		executor.SetCancel(m_pCancel);
+		return executor.Execute(p_Plan, m_Options.uQueueDepth);
+	}
+	// One SHFileOperation cannot be stopped halfway by the token; only its own UI can cancel it.
+	if (IsCancelled()) return HRESULT_FROM_WIN32(ERROR_CANCELLED);
+	// The plan was made against the destination as it was then; the policy does not cover what came since.
+	if (m_Options.uCollisionPolicy != ZapCollision::ASK) {
+		HRESULT hCheck = CheckDestination(p_Plan);
+		if (FAILED(hCheck)) {
+			if (p_pStats != 0) p_pStats->Add(ZapStats::FAILURES);
+			return hCheck;
+		}
+	}
+	// The moves the plan settled as replacements go last, without asking; the others may still ask.
+	int hRes = 0;
+	for (int iPass = 0; iPass < 2 && hRes == 0; ++iPass) {
+		bool bReplace = iPass != 0;
+		CAtlArray<WCHAR> szlFrom, szlTo;
+		size_t nMoves = p_Plan.GetFromList(szlFrom, bReplace);
+		if (nMoves == 0) continue;
+		p_Plan.GetToList(szlTo, bReplace);
+		SHFILEOPSTRUCT fileOpStruct = {0};
+		fileOpStruct.hwnd = p_hParentWnd;
+		fileOpStruct.wFunc = FO_MOVE;
+		fileOpStruct.pFrom = szlFrom.GetData();
+		fileOpStruct.pTo = szlTo.GetData();
+		fileOpStruct.fFlags = FOF_MULTIDESTFILES | FOF_SILENT;
+		// The Shell's undo is slow; it is only needed when the journal is not kept for Unzap().
+		if (!p_rJournal.IsOpen() || m_Options.uUndoDepth == 0) fileOpStruct.fFlags |= FOF_ALLOWUNDO;
+		if (p_hParentWnd == 0) fileOpStruct.fFlags |= (FOF_NOCONFIRMATION | FOF_NOERRORUI);
+		if (bReplace) fileOpStruct.fFlags |= FOF_NOCONFIRMATION;
+		hRes = SHFileOperation(&fileOpStruct);
+		// SHFileOperation returns a positive error code; make sure callers see a failure.
+		if (hRes != 0) hRes = HRESULT_FROM_WIN32(hRes);
+		if (fileOpStruct.fAnyOperationsAborted) hRes = E_ABORT;
+		if (p_pStats != 0) {
+			if (hRes == 0) p_pStats->Add(ZapStats::RENAMES, static_cast<LONGLONG>(nMoves));
+			else p_pStats->Add(ZapStats::FAILURES);
+		}
+		ZAP_LOG_INFO(L"Move 0x%08x | %Iu entries -> %s\n", hRes, nMoves, p_Plan.GetDestination());
+	}
+	return hRes;
+}
+
+//
+// CheckDestination
+//
+// Lists the destination folder again right before a Shell move, which
+// replaces without asking when there is no UI: an entry that took the name
+// of a move since the plan was made fails the zap, unless the plan replaces
+// it anyway. The native moves need no check; they never replace an entry
+// the plan did not mark.
+//
+// @param p_Plan Planned moves.
+// @return Result code; ERROR_FILE_EXISTS if a name was taken since.
+//
+HRESULT ZapEngine::CheckDestination(const ZapMovePlan& p_Plan) const {
+	ZapTree parent;
+	HRESULT hRes = parent.Scan(p_Plan.GetDestination(), 1);
+	if (FAILED(hRes)) {
+		ZAP_LOG_ERROR(L"Parent 0x%08x | %s\n", hRes, p_Plan.GetDestination());
+		return hRes;
+	}
+	// The zapped folder is out of the way by now; no name is reported as its own.
+	std::vector<ZapCollision> vCollisions;
+	p_Plan.FindCollisions(CString(), &parent, vCollisions);
+	for (size_t i = 0; i < vCollisions.size(); ++i) {
+		const ZapCollision& collision = vCollisions[i];
+		if (collision.kind == ZapCollision::PARENT && !p_Plan.GetMove(collision.iMove).bReplace) {
+			ZAP_LOG_ERROR(L"COLLISION: %s -> %s\n", p_Plan.GetFromPath(collision.iMove), p_Plan.GetToPath(collision.iMove));
+			return HRESULT_FROM_WIN32(ERROR_FILE_EXISTS);
+		}
+	}
+	return S_OK;
+}
+
+//
+// RemoveFolder
+//
+// Removes a folder holding nothing but empty directories, deepest first,
+// with plain directory removals; nothing goes to the Recycle Bin. The
+// subdirectories are pruned in parallel from the scan, without listing them.
+//
+// @param p_Tree Scan of the folder.
+// @param p_bRecursive Subdirectories the scan listed are still in the folder;
+//                     otherwise they were moved out with the rest.
+// @param p_pStats Receives the number of directories removed; may be 0.
+// @return Result code of removing the folder itself.
+//
+HRESULT ZapEngine::RemoveFolder(const ZapTree& p_Tree, BOOL p_bRecursive, ZapStats* p_pStats) const {
+	if (p_bRecursive) {
+		ZapPruner pruner(p_Tree);
+		pruner.SetStats(p_pStats);
+		HRESULT hPrune = pruner.Prune(m_Options.uScanThreads);
+		if (FAILED(hPrune))
+			return hPrune;	// What was kept is logged; the folder cannot be empty.
+	}
+	HRESULT hRes = ::RemoveDirectory(p_Tree.GetRoot()) ? S_OK : HRESULT_FROM_WIN32(::GetLastError());
+	ZAP_LOG_INFO(L"Remove 0x%08x | %s\n", hRes, p_Tree.GetRoot());
+	return hRes;
+}
+
+//
+// DeleteFolder
+//
+// Deletes a folder that still holds something through the Shell, which
+// asks first and recycles it.
+//
+HRESULT ZapEngine::DeleteFolder(const HWND p_hParentWnd, CString p_Path) const {
+	SHFILEOPSTRUCT fileOpStruct = {0};
+	fileOpStruct.hwnd = p_hParentWnd;
+	fileOpStruct.wFunc = FO_DELETE;
+	fileOpStruct.pTo = 0;
+	fileOpStruct.fFlags = FOF_ALLOWUNDO | FOF_WANTNUKEWARNING | FOF_SILENT;
+	p_Path.AppendChar(L'\0'); fileOpStruct.pFrom = p_Path;
+	if (p_hParentWnd == 0) fileOpStruct.fFlags |= FOF_NOERRORUI;
+	int hRes = SHFileOperation(&fileOpStruct);
+	ZAP_LOG_INFO(L"Delete 0x%08x | %s\n", hRes, p_Path);
+	return hRes;
+}
@@ -0,0 +1,415 @@
+// ZapExecutor.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapExecutor.h"
+#include "ZapCancel.h"
+#include "ZapJournal.h"
+#include "ZapLog.h"
+#include "ZapNameIndex.h"
+#include "ZapNt.h"
+#include "ZapPathBuilder.h"
+#include "ZapWorkPool.h"
+
+//
+// Constructor.
+//
+ZapExecutor::ZapExecutor()
+	: m_vResults(),
+	  m_nFailed(0),
+	  m_nCopied(0),
+	  m_Copier(),
+	  m_uHandleBudget(0),
+	  m_bReplace(false),
+	  m_pDirs(0),
+	  m_hTo(0),
+	  m_pStats(0),
+	  m_pJournal(0),
+	  m_pCancel(0)
+{
+}
+
+//
+// LaneTask
+//
+// Runs the entries of one lane, in plan order.
+//
+class ZapExecutor::LaneTask : public ZapTask
+{
+public:
+	LaneTask(ZapExecutor& executor, const ZapMovePlan& plan)
+		: m_Executor(executor), m_Plan(plan), m_vEntries(), m_From(), m_To() {}
+
+	void Add(size_t i) { m_vEntries.push_back(i); }
+
+	virtual void Run(ZapWorkPool&, UINT) {
+		for (size_t j = 0; j < m_vEntries.size(); ++j)
+			m_Executor.RunEntry(m_Plan, m_vEntries[j], m_From, m_To);
+	}
+
+private:
+	ZapExecutor&		m_Executor;		// Executor receiving the results.
+	const ZapMovePlan&	m_Plan;			// Plan being executed.
+	std::vector<size_t>	m_vEntries;		// Plan indices of this lane.
+	ZapPathBuilder		m_From;			// Source path of the entry running.
+	ZapPathBuilder		m_To;			// Destination path of the entry running.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+	LaneTask&			operator=(const LaneTask&);
+};
+
+//
+// Execute
+//
+// Moves every entry of the plan. A failed entry does not stop the others.
+//
+// @param plan Planned moves.
+// @param uQueueDepth Number of renames kept in flight; 0 uses the pool default,
+//                    1 runs the entries one after the other.
+// @return S_OK if every entry was moved, otherwise the result of the first failed entry.
+//
+HRESULT ZapExecutor::Execute(const ZapMovePlan& plan, UINT uQueueDepth) {
+	ZapMoveResult empty = { S_OK, false };
+	m_vResults.assign(plan.GetCount(), empty);
+	m_nFailed = 0;
+	m_nCopied = 0;
+
+	// Handle-relative renames, when the destination can be opened.
+	ZapDirCache dirs(plan.GetTree(), m_uHandleBudget);
+	HANDLE hTo = 0;
+	if (ZapNt::IsAvailable() && SUCCEEDED(ZapNt::OpenDirectory(plan.GetDestination(), hTo))) {
+		m_pDirs = &dirs;
+		m_hTo = hTo;
+	}
+
+	if (uQueueDepth != 1 && plan.GetCount() > 1) {
+		RunLanes(plan, uQueueDepth == 0 ? ZapWorkPool::GetDefaultThreadCount() : uQueueDepth);
+	} else {
+		ZapPathBuilder from, to;
+		for (size_t i = 0; i < plan.GetCount(); ++i)
+			RunEntry(plan, i, from, to);
+	}
+
+	m_pDirs = 0;
+	m_hTo = 0;
+	if (hTo != 0)
+		::CloseHandle(hTo);
+
+	// Cross-volume copies are complete; give them their metadata and drop the sources.
+	m_Copier.Finish(m_vResults);
+
+	// Results are reported in plan order, whatever order they completed in.
+	HRESULT hRes = S_OK;
+	size_t nCancelled = 0;
+	for (size_t i = 0; i < m_vResults.size(); ++i) {
+		const ZapMoveResult& result = m_vResults[i];
+		if (result.bCopied) {
+			++m_nCopied;
+			if (m_pJournal != 0 && SUCCEEDED(result.hr))
+				m_pJournal->Done(i);
+		}
+		if (FAILED(result.hr)) {
+			if (result.hr == HRESULT_FROM_WIN32(ERROR_CANCELLED))
+				++nCancelled;
+			else
+				ZAP_LOG_ERROR(L"MOVE_FAILED 0x%08x: %s -> %s\n", result.hr, plan.GetFromPath(i), plan.GetToPath(i));
+			if (SUCCEEDED(hRes))
+				hRes = result.hr;
+			++m_nFailed;
+		}
+	}
+	if (m_pStats != 0 && m_nFailed != nCancelled)
+		m_pStats->Add(ZapStats::FAILURES, static_cast<LONGLONG>(m_nFailed - nCancelled));
+	ZAP_LOG_INFO(L"Execute 0x%08x | %Iu entries, %Iu copied, %Iu failed, %Iu cancelled, depth %u\n",
+		hRes, m_vResults.size(), m_nCopied, m_nFailed - nCancelled, nCancelled, uQueueDepth);
+	return hRes;
+}
+
+//
+// RunEntry
+//
+// Moves one entry of the plan and stores its result. A rename is journaled
+// as soon as it is done; a copy only once Finish() has completed it.
+//
+// @param plan Planned moves.
+// @param i Plan index of the entry.
+// @param from Buffer for the source path, reused from entry to entry.
+// @param to Buffer for the destination path, reused from entry to entry.
+//
+void ZapExecutor::RunEntry(const ZapMovePlan& plan, size_t i, ZapPathBuilder& from, ZapPathBuilder& to) {
+	const ZapMove& move = plan.GetMove(i);
+	const ZapNode& node = plan.GetTree().GetNode(move.uNode);
+	ZapMoveResult& result = m_vResults[i];
+	if (m_pCancel != 0 && m_pCancel->IsCancelled()) {
+		result.hr = HRESULT_FROM_WIN32(ERROR_CANCELLED);
+		return;
+	}
+	HANDLE hParent = m_pDirs != 0 ? m_pDirs->Acquire(node.uParent) : 0;
+	if (hParent != 0) {
+		HRESULT hRes = RenameEntry(hParent, node, move);
+		m_pDirs->Release(node.uParent);
+		result.bCopied = hRes == HRESULT_FROM_WIN32(ERROR_NOT_SAME_DEVICE);
+		Count(hRes, result.bCopied);
+		result.hr = hRes;
+		if (result.bCopied) {
+			plan.GetFromPath(i, from);
+			plan.GetToPath(i, to);
+			result.hr = CopyEntry(from.GetString(), to.GetString(), node.IsDirectory(), m_bReplace || move.bReplace, i);
+		}
+	} else {
+		plan.GetFromPath(i, from);
+		plan.GetToPath(i, to);
+		MoveEntry(from.GetString(), to.GetString(), node.IsDirectory(), m_bReplace || move.bReplace, i);
+	}
+	if (m_pJournal != 0 && !result.bCopied && SUCCEEDED(result.hr))
+		m_pJournal->Done(i);
+}
+
+//
+// RenameEntry
+//
+// Renames one entry relative to its parent directory and the destination.
+//
+// @param hParent Handle of the directory holding the entry.
+// @param node Entry to move.
+// @param move Planned move.
+// @return Result code; ERROR_NOT_SAME_DEVICE if the entry must be copied.
+//
+HRESULT ZapExecutor::RenameEntry(HANDLE hParent, const ZapNode& node, const ZapMove& move) const {
+	HANDLE hEntry = 0;
+	HRESULT hRes = ZapNt::OpenForRename(hParent, node.pszName, node.cchName, hEntry);
+	if (m_pStats != 0)
+		m_pStats->Add(ZapStats::KERNEL_CALLS, SUCCEEDED(hRes) ? 3 : 1);
+	if (FAILED(hRes))
+		return hRes;
+	hRes = ZapNt::Rename(hEntry, m_hTo, move.pszName, move.cchName, m_bReplace || move.bReplace);
+	::CloseHandle(hEntry);
+	return hRes;
+}
+
+//
+// RunLanes
+//
+// Moves the entries of the plan on a work pool. There are more lanes than
+// workers so that a lane stuck on a slow copy does not hold the others back.
+//
+// @param plan Planned moves.
+// @param uQueueDepth Number of workers.
+//
+void ZapExecutor::RunLanes(const ZapMovePlan& plan, UINT uQueueDepth) {
+	UINT uLanes = uQueueDepth * 4;
+	std::vector<LaneTask*> vLanes(uLanes, static_cast<LaneTask*>(0));
+	for (size_t i = 0; i < plan.GetCount(); ++i) {
+		UINT uLane = GetLane(plan.GetMove(i), uLanes);
+		if (vLanes[uLane] == 0)
+			vLanes[uLane] = new LaneTask(*this, plan);
+		vLanes[uLane]->Add(i);
+	}
+
+	ZapWorkPool pool(uQueueDepth);
+	for (UINT i = 0; i < uLanes; ++i)
+		if (vLanes[i] != 0)
+			pool.Submit(vLanes[i]);
+	pool.Wait();
+}
+
+//
+// GetLane
+//
+// Lane of an entry: a hash of its destination name, folded as the collision
+// index folds it, so names NTFS takes for the same name share a lane.
+//
+// @param move Planned move.
+// @param uLanes Number of lanes.
+// @return Lane index.
+//
+UINT ZapExecutor::GetLane(const ZapMove& move, UINT uLanes) {
+	return ZapNameIndex::Hash(move.pszName, move.cchName) % uLanes;
+}
+
+//
+// MoveEntry
+//
+// Renames one entry; falls back to copy and delete if it crosses devices.
+//
+// @param pszFrom Source path.
+// @param pszTo Destination path.
+// @param bDirectory Entry is a directory.
+// @param bReplace Replace an existing destination entry.
+// @param i Plan index of the entry; its result is stored in m_vResults.
+//
+void ZapExecutor::MoveEntry(LPCWSTR pszFrom, LPCWSTR pszTo,
+							bool bDirectory, bool bReplace, size_t i) {
+	ZapMoveResult& result = m_vResults[i];
+	result.bCopied = false;
+	if (m_pStats != 0)
+		m_pStats->Add(ZapStats::KERNEL_CALLS);
+	if (::MoveFileEx(pszFrom, pszTo, bReplace ? MOVEFILE_REPLACE_EXISTING : 0)) {
+		result.hr = S_OK;
+		Count(S_OK, false);
+		return;
+	}
+	DWORD dwError = ::GetLastError();
+	if (dwError != ERROR_NOT_SAME_DEVICE) {
+		result.hr = HRESULT_FROM_WIN32(dwError);
+		return;
+	}
+	result.bCopied = true;
+	Count(result.hr, true);
+	result.hr = CopyEntry(pszFrom, pszTo, bDirectory, bReplace, i);
+}
+
+//
+// CopyEntry
+//
+// Moves one entry to another device. Files are handed to the copier, which
+// deletes their source in Finish() once the copy is complete.
+//
+// @param szFrom Source path.
+// @param szTo Destination path.
+// @param bDirectory Entry is a directory.
+// @param bReplace Replace an existing destination file.
+// @param i Plan index of the entry.
+// @return Result code.
+//
+HRESULT ZapExecutor::CopyEntry(const CString& szFrom, const CString& szTo,
+							   bool bDirectory, bool bReplace, size_t i) {
+	if (!bDirectory)
+		return m_Copier.Copy(szFrom, szTo, i, bReplace);
+	HRESULT hRes = MoveTree(szFrom, szTo);
+	if (m_pStats != 0 && SUCCEEDED(hRes))
+		m_pStats->Add(ZapStats::COPIES);
+	return hRes;
+}
+
+//
+// Count
+//
+// Counts the outcome of a rename: a success, or a retry by copy.
+//
+// @param hRes Result of the rename.
+// @param bCopy The entry is retried by copy and delete.
+//
+void ZapExecutor::Count(HRESULT hRes, bool bCopy) const {
+	if (m_pStats == 0)
+		return;
+	if (bCopy)
+		m_pStats->Add(ZapStats::RETRIES);
+	else if (SUCCEEDED(hRes))
+		m_pStats->Add(ZapStats::RENAMES);
+}
+
+//
+// MoveTree
+//
+// Moves a whole directory to another device. Directory trees are left to the
+// Shell, without UI.
+//
+// @param szFrom Source directory.
+// @param szTo Destination directory.
+// @return Result code.
+//
+HRESULT ZapExecutor::MoveTree(const CString& szFrom, const CString& szTo) {
+	CAtlArray<WCHAR> pFrom, pTo;
+	pFrom.SetCount(szFrom.GetLength() + 2);
+	pTo.SetCount(szTo.GetLength() + 2);
+	CopyMemory(pFrom.GetData(), szFrom.GetString(), szFrom.GetLength() * sizeof(WCHAR));
+	CopyMemory(pTo.GetData(), szTo.GetString(), szTo.GetLength() * sizeof(WCHAR));
+	pFrom[szFrom.GetLength()] = pFrom[szFrom.GetLength() + 1] = L'\0';
+	pTo[szTo.GetLength()] = pTo[szTo.GetLength() + 1] = L'\0';
+
+	SHFILEOPSTRUCT fileOpStruct = {0};
+	fileOpStruct.wFunc = FO_MOVE;
+	fileOpStruct.pFrom = pFrom.GetData();
+	fileOpStruct.pTo = pTo.GetData();
+	fileOpStruct.fFlags = FOF_SILENT | FOF_NOCONFIRMATION | FOF_NOCONFIRMMKDIR | FOF_NOERRORUI;
+	int hRes = SHFileOperation(&fileOpStruct);
+	if (hRes != 0) return HRESULT_FROM_WIN32(hRes);
+	return fileOpStruct.fAnyOperationsAborted ? E_ABORT : S_OK;
+}
+
+//
+// Limit the number of source directory handles kept open
+//
+// @param uBudget Maximum number of handles; 0 uses the default.
+//
+void ZapExecutor::SetHandleBudget(UINT uBudget) {
+	m_uHandleBudget = uBudget;
+}
+
+//
+// Replace existing destination entries instead of failing them
+//
+// @param bReplace Replace existing entries.
+//
+void ZapExecutor::SetReplaceExisting(bool bReplace) {
+	m_bReplace = bReplace;
+}
+
+//
+// Count the renames, copies and calls of the next executions
+//
+// @param pStats Counters to add to, or 0.
+//
+void ZapExecutor::SetStats(ZapStats* pStats) {
+	m_pStats = pStats;
+	m_Copier.SetStats(pStats);
+}
+
+//
+// Record the completed moves of the next executions in a journal
+//
+// @param pJournal Journal to write to, or 0.
+//
+void ZapExecutor::SetJournal(ZapJournal* pJournal) {
+	m_pJournal = pJournal;
+}
+
+//
+// Stop moving when a token is cancelled
+//
+// @param pCancel Token looked at before each entry is moved, or 0. The
+//                entries not started get ERROR_CANCELLED.
+//
+void ZapExecutor::SetCancel(const ZapCancel* pCancel) {
+	m_pCancel = pCancel;
+}
+
+//
+// Per-entry results, in plan order
+//
+const std::vector<ZapMoveResult>& ZapExecutor::GetResults() const {
+	return m_vResults;
+}
+
+//
+// Number of entries that could not be moved
+//
+size_t ZapExecutor::GetFailedCount() const {
+	return m_nFailed;
+}
+
+//
+// Number of entries moved by copy and delete
+//
+size_t ZapExecutor::GetCopiedCount() const {
+	return m_nCopied;
+}
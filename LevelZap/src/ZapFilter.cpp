@@ -0,0 +1,276 @@
+// ZapFilter.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapFilter.h"
+#include "Utilities.h"
+#include "ZapLog.h"
+
+#include <map>
+
+//
+// Constructor. The filter starts with no rule; it matches nothing.
+//
+ZapFilter::ZapFilter()
+	: m_vRules(),
+	  m_vExclude(),
+	  m_bIncludes(false),
+	  m_cchMin(0),
+	  m_uClasses(1),
+	  m_vWide(),
+	  m_vWideClass(),
+	  m_vNext(),
+	  m_vAccept()
+{
+	ZeroMemory(m_vAscii, sizeof(m_vAscii));
+}
+
+//
+// Load
+//
+// Adds the rules of the Include and Exclude settings, one pattern per
+// string. Compile() must be called afterwards.
+//
+void ZapFilter::Load() {
+	CAtlList<CString> lPatterns;
+	if (Util::QueryMultiStringValueEx(L"Include", lPatterns) == ERROR_SUCCESS)
+		for (POSITION pos = lPatterns.GetHeadPosition(); pos != 0; )
+			Add(lPatterns.GetNext(pos), false);
+	lPatterns.RemoveAll();
+	if (Util::QueryMultiStringValueEx(L"Exclude", lPatterns) == ERROR_SUCCESS)
+		for (POSITION pos = lPatterns.GetHeadPosition(); pos != 0; )
+			Add(lPatterns.GetNext(pos), true);
+}
+
+//
+// Add
+//
+// Adds a rule. Compile() must be called afterwards.
+//
+// @param szPattern Glob matched against whole names; empty patterns are ignored.
+// @param bExclude The rule excludes what it matches; otherwise it includes it.
+//
+void ZapFilter::Add(const CString& szPattern, bool bExclude) {
+	if (szPattern.IsEmpty() || szPattern.GetLength() > MAX_PATH || m_vRules.size() >= 0xFFFF)
+		return;
+	CString szRule(szPattern);
+	::CharUpperBuff(szRule.GetBuffer(), szRule.GetLength());
+	szRule.ReleaseBuffer(szPattern.GetLength());
+	m_vRules.push_back(szRule);
+	m_vExclude.push_back(bExclude);
+}
+
+//
+// Compile
+//
+// Builds the automaton of the rules added so far, by subset construction.
+// An item of a state is a rule and a position in its pattern, packed as
+// (rule << 16) | position.
+//
+// @return Result code; E_OUTOFMEMORY if the automaton would have more than
+//         MAX_STATES states, in which case the filter matches nothing.
+//
+HRESULT ZapFilter::Compile() {
+	m_bIncludes = false;
+	m_cchMin = MAXDWORD;
+	m_uClasses = 1;
+	ZeroMemory(m_vAscii, sizeof(m_vAscii));
+	m_vWide.clear();
+	m_vWideClass.clear();
+	m_vNext.clear();
+	m_vAccept.clear();
+	if (m_vRules.empty()) {
+		m_cchMin = 0;
+		return S_OK;
+	}
+
+	// One class per character a rule names; ASCII letters match both cases.
+	for (size_t r = 0; r < m_vRules.size(); ++r) {
+		const CString& szRule = m_vRules[r];
+		UINT cchFixed = 0;
+		for (int i = 0; i < szRule.GetLength(); ++i) {
+			WCHAR ch = szRule[i];
+			if (ch == L'*')
+				continue;
+			++cchFixed;
+			if (ch == L'?' || GetClass(ch) != 0)
+				continue;
+			if (ch < _countof(m_vAscii)) {
+				m_vAscii[ch] = m_uClasses;
+				if (ch >= L'A' && ch <= L'Z')
+					m_vAscii[ch - L'A' + L'a'] = m_uClasses;
+			} else {
+				size_t iAt = std::lower_bound(m_vWide.begin(), m_vWide.end(), ch) - m_vWide.begin();
+				m_vWide.insert(m_vWide.begin() + iAt, ch);
+				m_vWideClass.insert(m_vWideClass.begin() + iAt, m_uClasses);
+			}
+			++m_uClasses;
+		}
+		if (cchFixed < m_cchMin)
+			m_cchMin = cchFixed;
+		m_bIncludes = m_bIncludes || !m_vExclude[r];
+	}
+
+	typedef std::map<std::vector<UINT>, UINT> StateMap;
+	StateMap states;
+	std::vector<std::vector<UINT> > vStates(2);
+	states[vStates[DEAD]] = DEAD;
+	for (UINT r = 0; r < m_vRules.size(); ++r)
+		vStates[START].push_back(r << 16);
+	Close(vStates[START]);
+	states[vStates[START]] = START;
+
+	for (UINT s = 0; s < vStates.size(); ++s) {
+		BYTE bAccept = NONE;
+		for (size_t k = 0; k < vStates[s].size(); ++k) {
+			UINT r = vStates[s][k] >> 16, i = vStates[s][k] & 0xFFFF;
+			if (i == static_cast<UINT>(m_vRules[r].GetLength()))
+				bAccept |= m_vExclude[r] ? EXCLUDED : INCLUDED;
+		}
+		m_vAccept.push_back(bAccept);
+
+		for (UINT c = 0; c < m_uClasses; ++c) {
+			std::vector<UINT> vNext;
+			for (size_t k = 0; k < vStates[s].size(); ++k) {
+				UINT r = vStates[s][k] >> 16, i = vStates[s][k] & 0xFFFF;
+				const CString& szRule = m_vRules[r];
+				if (i == static_cast<UINT>(szRule.GetLength()))
+					continue;
+				WCHAR ch = szRule[i];
+				if (ch == L'*')
+					vNext.push_back(vStates[s][k]);
+				else if (ch == L'?' || (c != 0 && GetClass(ch) == c))
+					vNext.push_back(vStates[s][k] + 1);
+			}
+			Close(vNext);
+			StateMap::const_iterator it = states.find(vNext);
+			UINT uNext;
+			if (it != states.end()) {
+				uNext = it->second;
+			} else {
+				if (vStates.size() >= MAX_STATES) {
+					ZAP_LOG_ERROR(L"FILTER_TOO_LARGE: %Iu rules\n", m_vRules.size());
+					m_bIncludes = false;
+					m_vNext.clear();
+					m_vAccept.clear();
+					return E_OUTOFMEMORY;
+				}
+				uNext = static_cast<UINT>(vStates.size());
+				states[vNext] = uNext;
+				vStates.push_back(vNext);
+			}
+			m_vNext.push_back(uNext);
+		}
+	}
+	ZAP_LOG_INFO(L"Filter | %Iu rules, %u classes, %Iu states\n", m_vRules.size(), m_uClasses, vStates.size());
+	return S_OK;
+}
+
+//
+// Close
+//
+// Adds to a set of items the positions reachable by skipping '*', which may
+// match nothing, then sorts it so that equal sets compare equal.
+//
+// @param vItems Items of a state.
+//
+void ZapFilter::Close(std::vector<UINT>& vItems) const {
+	for (size_t k = 0; k < vItems.size(); ++k) {
+		UINT r = vItems[k] >> 16, i = vItems[k] & 0xFFFF;
+		if (i < static_cast<UINT>(m_vRules[r].GetLength()) && m_vRules[r][i] == L'*')
+			vItems.push_back(vItems[k] + 1);
+	}
+	std::sort(vItems.begin(), vItems.end());
+	vItems.erase(std::unique(vItems.begin(), vItems.end()), vItems.end());
+}
+
+//
+// Class of a character
+//
+// @param ch Character, in any case.
+// @return Class; 0 if no rule names the character.
+//
+UINT ZapFilter::GetClass(WCHAR ch) const {
+	if (ch < _countof(m_vAscii))
+		return m_vAscii[ch];
+	::CharUpperBuff(&ch, 1);
+	std::vector<WCHAR>::const_iterator it = std::lower_bound(m_vWide.begin(), m_vWide.end(), ch);
+	return it != m_vWide.end() && *it == ch ? m_vWideClass[it - m_vWide.begin()] : 0;
+}
+
+//
+// Has the filter no compiled rule
+//
+bool ZapFilter::IsEmpty() const {
+	return m_vAccept.empty();
+}
+
+//
+// Match
+//
+// Runs a name through the automaton.
+//
+// @param pszName Entry name; need not be terminated.
+// @param cchName Length of the name.
+// @return Result flags of the rules matching the whole name.
+//
+DWORD ZapFilter::Match(LPCWSTR pszName, UINT cchName) const {
+	if (m_vAccept.empty() || cchName < m_cchMin)
+		return NONE;
+	UINT uState = START;
+	for (UINT i = 0; i < cchName; ++i) {
+		uState = m_vNext[uState * m_uClasses + GetClass(pszName[i])];
+		if (uState == DEAD)
+			return NONE;
+	}
+	return m_vAccept[uState];
+}
+
+//
+// IsExcluded
+//
+// Is an entry left where it is.
+//
+// @param pszName Entry name; need not be terminated.
+// @param cchName Length of the name.
+// @param bMoved The entry itself would be moved, rather than flattened.
+// @return The entry is excluded, or include rules exist and none matches it.
+//
+bool ZapFilter::IsExcluded(LPCWSTR pszName, UINT cchName, bool bMoved) const {
+	DWORD dwMatch = Match(pszName, cchName);
+	if (dwMatch & EXCLUDED)
+		return true;
+	return bMoved && m_bIncludes && !(dwMatch & INCLUDED);
+}
+
+//
+// Number of rules
+//
+size_t ZapFilter::GetRuleCount() const {
+	return m_vRules.size();
+}
+
+//
+// Number of states of the automaton
+//
+size_t ZapFilter::GetStateCount() const {
+	return m_vAccept.size();
+}
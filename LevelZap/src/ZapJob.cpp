@@ -0,0 +1,425 @@
+// ZapJob.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapJob.h"
+#include "ZapLog.h"
+
+namespace {
+
+	//
+	// Plan file layout, little-endian, every record at a fixed size:
+	//
+	//   PlanHeader
+	//   PlanNode[nNodes]		tree nodes, ROOT first
+	//   PlanMove[nMoves]		moves, in plan order
+	//   WCHAR[cchFolder]		folder path
+	//   WCHAR[cchDestination]	destination path
+	//   WCHAR[cchNames]		names, referenced by character offset
+	//
+	// Records can be read in place from a mapped view, so a tool can walk a
+	// plan of any size without loading it.
+	//
+	const DWORD PLAN_MAGIC = 0x4C50415A;	// "ZAPL"
+	const DWORD PLAN_VERSION = 2;
+
+	enum PlanFlags {
+		PLAN_RENAME = 0x2,					// PlanHeader: rename the folder first.
+		NODE_SCANNED = 0x1,					// PlanNode: directory content was enumerated.
+		NODE_EXCLUDED = 0x2,				// PlanNode: the filter left the entry out.
+		MOVE_REPLACE = 0x1					// PlanMove: replace the destination entry.
+	};
+
+	struct PlanHeader
+	{
+		DWORD		dwMagic;				// PLAN_MAGIC.
+		DWORD		dwVersion;				// PLAN_VERSION.
+		DWORD		dwFlags;				// PLAN_* flags.
+		DWORD		nNodes;					// Node records.
+		DWORD		nMoves;					// Move records.
+		DWORD		cchFolder;				// Length of the folder path.
+		DWORD		cchDestination;			// Length of the destination path.
+		DWORD		cchNames;				// Length of the name table.
+		DWORD		nCollisions;			// Collisions found while planning.
+		DWORD		nSkipped;				// Moves dropped to settle collisions.
+		DWORD		dwDepth;				// Levels flattened; 0 for every level.
+		DWORD		dwReserved;				// Zero; keeps records 8-byte aligned.
+	};
+
+	struct PlanNode
+	{
+		DWORD		dwName;					// Offset of the name in the name table.
+		DWORD		cchName;				// Length of the name.
+		DWORD		dwAttributes;			// File attributes.
+		DWORD		dwFlags;				// NODE_* flags.
+		ULONGLONG	ullSize;				// File size in bytes.
+		FILETIME	ftWrite;				// Last write time.
+		DWORD		uParent;				// Parent node.
+		DWORD		uFirstChild;			// First child node.
+		DWORD		uChildCount;			// Number of children.
+		DWORD		dwReserved;				// Zero; keeps records 8-byte aligned.
+	};
+
+	struct PlanMove
+	{
+		DWORD		uNode;					// Source node.
+		DWORD		dwName;					// Offset of the destination name in the name table.
+		DWORD		cchName;				// Length of the destination name.
+		DWORD		dwFlags;				// MOVE_* flags.
+	};
+
+	//
+	// PlanWriter
+	//
+	// Buffers the sequential writes of a plan file.
+	//
+	class PlanWriter
+	{
+	public:
+		explicit PlanWriter(HANDLE hFile)
+			: m_hFile(hFile), m_vBuffer(), m_bFailed(false) { m_vBuffer.reserve(BUFFER_SIZE); }
+
+		void Write(const void* pData, size_t cb) {
+			const BYTE* p = static_cast<const BYTE*>(pData);
+			m_vBuffer.insert(m_vBuffer.end(), p, p + cb);
+			if (m_vBuffer.size() >= BUFFER_SIZE)
+				Flush();
+		}
+
+		bool Flush() {
+			DWORD cbWritten = 0;
+			if (!m_vBuffer.empty() && !m_bFailed
+				&& !::WriteFile(m_hFile, &m_vBuffer[0], static_cast<DWORD>(m_vBuffer.size()), &cbWritten, 0))
+				m_bFailed = true;
+			m_vBuffer.clear();
+			return !m_bFailed;
+		}
+
+	private:
+		enum { BUFFER_SIZE = 256 * 1024 };
+
+		HANDLE				m_hFile;	// File written to.
+		std::vector<BYTE>	m_vBuffer;	// Bytes not written yet.
+		bool				m_bFailed;	// A write failed; the rest is dropped.
+	};
+}
+
+//
+// Constructor.
+//
+ZapJob::ZapJob()
+	: m_szFolder(),
+	  m_uDepth(1),
+	  m_bRename(FALSE),
+	  m_bRestored(false),
+	  m_nCollisions(0),
+	  m_Tree(),
+	  m_Plan()
+{
+}
+
+//
+// Folder to zap, as it was planned
+//
+const CString& ZapJob::GetFolder() const {
+	return m_szFolder;
+}
+
+//
+// Levels flattened; ZapTree::ALL_LEVELS for every level
+//
+UINT ZapJob::GetDepth() const {
+	return m_uDepth;
+}
+
+//
+// The folder must be renamed before its content moves
+//
+BOOL ZapJob::NeedsRename() const {
+	return m_bRename;
+}
+
+//
+// The job was loaded from a file, so the folder may have changed since
+//
+bool ZapJob::IsRestored() const {
+	return m_bRestored;
+}
+
+//
+// Scanned folder
+//
+const ZapTree& ZapJob::GetTree() const {
+	return m_Tree;
+}
+
+//
+// Resolved moves
+//
+const ZapMovePlan& ZapJob::GetPlan() const {
+	return m_Plan;
+}
+
+//
+// IsCopy
+//
+// Predicts whether a move crosses devices. The destination is on the
+// folder's own volume, so a move copies when its source sits below a mount
+// point or junction, the folder itself included.
+//
+// @param i Plan index of the move.
+// @return The move is expected to copy and delete.
+//
+bool ZapJob::IsCopy(size_t i) const {
+	UINT uNode = m_Plan.GetMove(i).uNode;
+	do {
+		uNode = m_Tree.GetNode(uNode).uParent;
+		if (m_Tree.GetNode(uNode).dwAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+			return true;
+	} while (uNode != ZapTree::ROOT);
+	return false;
+}
+
+//
+// GetForecast
+//
+// @param forecast Receives what executing the job is expected to do.
+//
+void ZapJob::GetForecast(ZapForecast& forecast) const {
+	ZeroMemory(&forecast, sizeof(forecast));
+	forecast.nSkipped = m_Plan.GetSkippedCount();
+	forecast.nCollisions = m_nCollisions;
+	for (size_t i = 0; i < m_Plan.GetCount(); ++i) {
+		const ZapMove& move = m_Plan.GetMove(i);
+		const ZapNode& node = m_Tree.GetNode(move.uNode);
+		bool bCopy = IsCopy(i);
+		ULONGLONG ullBytes = node.IsDirectory() ? 0 : node.ullSize;
+		forecast.ullBytes += ullBytes;
+		if (bCopy) {
+			++forecast.nCopies;
+			forecast.ullCopyBytes += ullBytes;
+		} else {
+			++forecast.nRenames;
+		}
+		if (move.bReplace)
+			++forecast.nReplaced;
+	}
+}
+
+//
+// Save
+//
+// Writes the job to a plan file; see the layout above. The file is flushed
+// to the disk, so a journal can rely on it.
+//
+// @param szPath Path of the file, replaced if it exists.
+// @return Result code.
+//
+HRESULT ZapJob::Save(const CString& szPath) const {
+	HANDLE hFile = ::CreateFile(szPath, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return HRESULT_FROM_WIN32(::GetLastError());
+
+	size_t nNodes = m_Tree.GetCount(), nMoves = m_Plan.GetCount();
+	const CString& szDestination = m_Plan.GetDestination();
+	PlanHeader header = {};
+	header.dwMagic = PLAN_MAGIC;
+	header.dwVersion = PLAN_VERSION;
+	header.dwFlags = m_bRename ? PLAN_RENAME : 0;
+	header.nNodes = static_cast<DWORD>(nNodes);
+	header.nMoves = static_cast<DWORD>(nMoves);
+	header.cchFolder = m_szFolder.GetLength();
+	header.cchDestination = szDestination.GetLength();
+	header.nCollisions = static_cast<DWORD>(m_nCollisions);
+	header.nSkipped = static_cast<DWORD>(m_Plan.GetSkippedCount());
+	header.dwDepth = m_uDepth;
+
+	// Node names come first in the name table, then the names moves were renamed to.
+	std::vector<DWORD> vNames(nNodes);
+	DWORD cchNames = 0;
+	for (size_t i = 0; i < nNodes; ++i) {
+		vNames[i] = cchNames;
+		cchNames += m_Tree.GetNode(static_cast<UINT>(i)).cchName;
+	}
+	DWORD cchNodeNames = cchNames;
+	for (size_t i = 0; i < nMoves; ++i) {
+		const ZapMove& move = m_Plan.GetMove(i);
+		if (move.pszName != m_Tree.GetNode(move.uNode).pszName)
+			cchNames += move.cchName;
+	}
+	header.cchNames = cchNames;
+
+	PlanWriter writer(hFile);
+	writer.Write(&header, sizeof(header));
+	for (size_t i = 0; i < nNodes; ++i) {
+		const ZapNode& node = m_Tree.GetNode(static_cast<UINT>(i));
+		PlanNode record = {};
+		record.dwName = vNames[i];
+		record.cchName = node.cchName;
+		record.dwAttributes = node.dwAttributes;
+		record.dwFlags = (node.bScanned ? NODE_SCANNED : 0) | (node.bExcluded ? NODE_EXCLUDED : 0);
+		record.ullSize = node.ullSize;
+		record.ftWrite = node.ftWrite;
+		record.uParent = node.uParent;
+		record.uFirstChild = node.uFirstChild;
+		record.uChildCount = node.uChildCount;
+		writer.Write(&record, sizeof(record));
+	}
+	DWORD dwRenamed = cchNodeNames;
+	for (size_t i = 0; i < nMoves; ++i) {
+		const ZapMove& move = m_Plan.GetMove(i);
+		PlanMove record = {};
+		record.uNode = move.uNode;
+		record.cchName = move.cchName;
+		record.dwFlags = move.bReplace ? MOVE_REPLACE : 0;
+		if (move.pszName == m_Tree.GetNode(move.uNode).pszName) {
+			record.dwName = vNames[move.uNode];
+		} else {
+			record.dwName = dwRenamed;
+			dwRenamed += move.cchName;
+		}
+		writer.Write(&record, sizeof(record));
+	}
+	writer.Write(m_szFolder.GetString(), header.cchFolder * sizeof(WCHAR));
+	writer.Write(szDestination.GetString(), header.cchDestination * sizeof(WCHAR));
+	for (size_t i = 0; i < nNodes; ++i) {
+		const ZapNode& node = m_Tree.GetNode(static_cast<UINT>(i));
+		writer.Write(node.pszName, node.cchName * sizeof(WCHAR));
+	}
+	for (size_t i = 0; i < nMoves; ++i) {
+		const ZapMove& move = m_Plan.GetMove(i);
+		if (move.pszName != m_Tree.GetNode(move.uNode).pszName)
+			writer.Write(move.pszName, move.cchName * sizeof(WCHAR));
+	}
+
+	HRESULT hRes = writer.Flush() && ::FlushFileBuffers(hFile) ? S_OK : HRESULT_FROM_WIN32(::GetLastError());
+	::CloseHandle(hFile);
+	if (FAILED(hRes))
+		::DeleteFile(szPath);
+	ZAP_LOG_INFO(L"Save plan 0x%08x | %Iu nodes, %Iu moves -> %s\n", hRes, nNodes, nMoves, szPath);
+	return hRes;
+}
+
+//
+// Load
+//
+// Maps a plan file written by Save() and rebuilds the job from it. Every
+// offset and index is checked against the file before it is used.
+//
+// @param szPath Path of the file.
+// @return Result code; ERROR_BAD_FORMAT if the file is not a valid plan.
+//
+HRESULT ZapJob::Load(const CString& szPath) {
+	HANDLE hFile = ::CreateFile(szPath, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return HRESULT_FROM_WIN32(::GetLastError());
+	LARGE_INTEGER liSize;
+	HANDLE hMapping = 0;
+	const BYTE* pView = 0;
+	HRESULT hRes = HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+	if (::GetFileSizeEx(hFile, &liSize) && liSize.QuadPart >= static_cast<LONGLONG>(sizeof(PlanHeader))
+		&& static_cast<ULONGLONG>(liSize.QuadPart) <= static_cast<SIZE_T>(-1)) {
+		hMapping = ::CreateFileMapping(hFile, 0, PAGE_READONLY, 0, 0, 0);
+		if (hMapping != 0)
+			pView = static_cast<const BYTE*>(::MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+		if (pView == 0)
+			hRes = HRESULT_FROM_WIN32(::GetLastError());
+	}
+
+	if (pView != 0) {
+		const PlanHeader& header = *reinterpret_cast<const PlanHeader*>(pView);
+		ULONGLONG cbExpected = sizeof(PlanHeader)
+			+ static_cast<ULONGLONG>(header.nNodes) * sizeof(PlanNode)
+			+ static_cast<ULONGLONG>(header.nMoves) * sizeof(PlanMove)
+			+ (static_cast<ULONGLONG>(header.cchFolder) + header.cchDestination + header.cchNames) * sizeof(WCHAR);
+		bool bValid = header.dwMagic == PLAN_MAGIC && header.dwVersion == PLAN_VERSION
+			&& header.nNodes != 0 && cbExpected == static_cast<ULONGLONG>(liSize.QuadPart);
+
+		const PlanNode* pNodes = reinterpret_cast<const PlanNode*>(pView + sizeof(PlanHeader));
+		const PlanMove* pMoves = reinterpret_cast<const PlanMove*>(pNodes + (bValid ? header.nNodes : 0));
+		LPCWSTR pszFolder = reinterpret_cast<LPCWSTR>(pMoves + (bValid ? header.nMoves : 0));
+		LPCWSTR pszDestination = pszFolder + header.cchFolder;
+		LPCWSTR pszNames = pszDestination + header.cchDestination;
+
+		std::vector<ZapNode> vNodes;
+		if (bValid)
+			vNodes.resize(header.nNodes);
+		for (DWORD i = 0; bValid && i < header.nNodes; ++i) {
+			const PlanNode& record = pNodes[i];
+			// A scan attaches children after their parent, so parents come first and
+			// walking up always ends at ROOT.
+			bValid = record.dwName <= header.cchNames && record.cchName <= header.cchNames - record.dwName
+				&& (i == ZapTree::ROOT ? record.uParent == ZapTree::ROOT : record.uParent < i)
+				&& record.uFirstChild <= header.nNodes
+				&& record.uChildCount <= header.nNodes - record.uFirstChild;
+			ZapNode& node = vNodes[i];
+			node.pszName = pszNames + record.dwName;
+			node.cchName = record.cchName;
+			node.dwAttributes = record.dwAttributes;
+			node.ullSize = record.ullSize;
+			node.ftWrite = record.ftWrite;
+			node.uParent = record.uParent;
+			node.uFirstChild = record.uFirstChild;
+			node.uChildCount = record.uChildCount;
+			node.bScanned = (record.dwFlags & NODE_SCANNED) != 0;
+			node.bExcluded = (record.dwFlags & NODE_EXCLUDED) != 0;
+		}
+
+		if (bValid) {
+			m_szFolder.SetString(pszFolder, header.cchFolder);
+			m_Tree.Restore(m_szFolder, vNodes);
+		}
+		std::vector<ZapMove> vMoves;
+		if (bValid)
+			vMoves.resize(header.nMoves);
+		for (DWORD i = 0; bValid && i < header.nMoves; ++i) {
+			const PlanMove& record = pMoves[i];
+			bValid = record.uNode != ZapTree::ROOT && record.uNode < header.nNodes
+				&& record.dwName <= header.cchNames && record.cchName <= header.cchNames - record.dwName;
+			if (!bValid)
+				break;
+			ZapMove& move = vMoves[i];
+			const ZapNode& node = m_Tree.GetNode(record.uNode);
+			move.uNode = record.uNode;
+			move.cchName = record.cchName;
+			move.bReplace = (record.dwFlags & MOVE_REPLACE) != 0;
+			// Names shared with the node point into the tree; the others are copied next to them.
+			move.pszName = record.dwName == pNodes[record.uNode].dwName && record.cchName == node.cchName
+				? node.pszName
+				: m_Tree.GetPool().Store(pszNames + record.dwName, record.cchName);
+		}
+
+		if (bValid) {
+			m_uDepth = header.dwDepth;
+			m_bRename = (header.dwFlags & PLAN_RENAME) ? TRUE : FALSE;
+			m_bRestored = true;
+			m_nCollisions = header.nCollisions;
+			m_Plan.Restore(m_Tree, CString(pszDestination, header.cchDestination), vMoves, header.nSkipped);
+			hRes = S_OK;
+		}
+		::UnmapViewOfFile(pView);
+	}
+	if (hMapping != 0)
+		::CloseHandle(hMapping);
+	::CloseHandle(hFile);
+	ZAP_LOG_INFO(L"Load plan 0x%08x | %s\n", hRes, szPath);
+	return hRes;
+}
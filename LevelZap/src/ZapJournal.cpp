@@ -0,0 +1,599 @@
+// ZapJournal.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapJournal.h"
+#include <GuidString.h>
+#include "ZapJob.h"
+#include "ZapLog.h"
+#include "ZapSettings.h"
+
+namespace {
+
+	//
+	// Journal file layout, little-endian:
+	//
+	//   JournalHeader
+	//   JournalRecord, then cchText WCHARs; repeated until the end
+	//
+	// The plan of the zap is in the file of the same name with PLAN_EXTENSION.
+	// Files are named after the hash of the destination, then the time the zap
+	// started, so that the undo records of a folder are found and ordered by name.
+	//
+	const DWORD JOURNAL_MAGIC = 0x5750415A;	// "ZAPW"
+	const DWORD JOURNAL_VERSION = 1;
+
+	const wchar_t JOURNAL_EXTENSION[] = L".wal";
+	const wchar_t UNDO_EXTENSION[] = L".undo";
+	const wchar_t PLAN_EXTENSION[] = L".zapl";
+
+	// Length of the destination hash and its separator at the start of the names.
+	const int HASH_LENGTH = 9;
+
+	enum RecordType {
+		RECORD_PLANNED = 1,					// The plan file is complete; dwValue is its number of moves, the text the folder.
+		RECORD_RENAME,						// The folder is about to be renamed to the text.
+		RECORD_DONE,						// Move dwValue completed.
+		RECORD_MOVED						// Every move was attempted; dwValue is 1 if every one succeeded.
+	};
+
+	struct JournalHeader
+	{
+		DWORD		dwMagic;				// JOURNAL_MAGIC.
+		DWORD		dwVersion;				// JOURNAL_VERSION.
+	};
+
+	struct JournalRecord
+	{
+		DWORD		dwType;					// RecordType.
+		DWORD		dwValue;				// Depends on the type.
+		DWORD		cchText;				// Length of the text after the record.
+		DWORD		dwCheck;				// GetCheck() of the record and its text.
+	};
+
+	//
+	// Checksum of a record: FNV-1a over its other fields and its text
+	//
+	DWORD GetCheck(const JournalRecord& record, LPCWSTR pszText) {
+		DWORD dwCheck = 2166136261u;
+		const BYTE* p = reinterpret_cast<const BYTE*>(&record);
+		for (size_t i = 0; i < offsetof(JournalRecord, dwCheck); ++i)
+			dwCheck = (dwCheck ^ p[i]) * 16777619u;
+		p = reinterpret_cast<const BYTE*>(pszText);
+		for (size_t i = 0; i < record.cchText * sizeof(WCHAR); ++i)
+			dwCheck = (dwCheck ^ p[i]) * 16777619u;
+		return dwCheck;
+	}
+
+	//
+	// Orders names by the time the zap started, then by GUID
+	//
+	bool IsOlder(const CString& szName1, const CString& szName2) {
+		return wcscmp(szName1.GetString() + HASH_LENGTH, szName2.GetString() + HASH_LENGTH) < 0;
+	}
+}
+
+//
+// Constructor.
+//
+ZapJournal::ZapJournal()
+	: m_cs(),
+	  m_hFile(INVALID_HANDLE_VALUE),
+	  m_szPath(),
+	  m_szPlanPath(),
+	  m_vBuffer(),
+	  m_nPending(0),
+	  m_bFailed(false),
+	  m_bPlanned(false),
+	  m_bTracking(false),
+	  m_szFolder(),
+	  m_szRenamed(),
+	  m_bMoved(false),
+	  m_bAllMoved(false),
+	  m_vDone()
+{
+}
+
+//
+// Destructor. A journal that was not committed is kept for recovery.
+//
+ZapJournal::~ZapJournal() {
+	Close();
+}
+
+//
+// Begin
+//
+// Starts the journal of a job about to be executed: saves its plan, then
+// records that the plan is complete. Both are flushed before this returns.
+//
+// @param job Planned zap.
+// @return Result code; the job must not be journaled if this fails.
+//
+HRESULT ZapJournal::Begin(const ZapJob& job) {
+	CString szDirectory = GetDirectory();
+	int iRes = szDirectory.IsEmpty() ? ERROR_PATH_NOT_FOUND : ::SHCreateDirectoryEx(0, szDirectory, 0);
+	if (iRes != ERROR_SUCCESS && iRes != ERROR_ALREADY_EXISTS && iRes != ERROR_FILE_EXISTS)
+		return HRESULT_FROM_WIN32(iRes);
+	GuidString szGUID;
+	FILETIME ftNow;
+	::GetSystemTimeAsFileTime(&ftNow);
+	CString szBase;
+	szBase.Format(L"%s\\%08X-%08X%08X-%s", szDirectory.GetString(),
+		GetDestinationHash(job.GetPlan().GetDestination()), ftNow.dwHighDateTime, ftNow.dwLowDateTime,
+		szGUID.String().c_str());
+	m_szPath = szBase + JOURNAL_EXTENSION;
+	m_szPlanPath = szBase + PLAN_EXTENSION;
+
+	// The journal exists first, so that recovery never finds a plan without one.
+	m_hFile = ::CreateFile(m_szPath, GENERIC_WRITE, 0, 0, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, 0);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return HRESULT_FROM_WIN32(::GetLastError());
+	HRESULT hRes = job.Save(m_szPlanPath);
+	if (SUCCEEDED(hRes)) {
+		JournalHeader header = { JOURNAL_MAGIC, JOURNAL_VERSION };
+		const BYTE* p = reinterpret_cast<const BYTE*>(&header);
+		m_vBuffer.assign(p, p + sizeof(header));
+		Append(RECORD_PLANNED, static_cast<DWORD>(job.GetPlan().GetCount()), job.GetFolder());
+		// Kept as they are written too, so that a cancelled zap can be rolled back from them.
+		m_szFolder = job.GetFolder();
+		m_vDone.assign(job.GetPlan().GetCount(), false);
+		hRes = Flush();
+	}
+	if (FAILED(hRes)) {
+		Commit();
+		return hRes;
+	}
+	m_bPlanned = true;
+	m_szFolder = job.GetFolder();
+	return S_OK;
+}
+
+//
+// Track
+//
+// Follows a job that is executed without a journal file: the rename and the
+// completed moves are only kept in memory, so that a cancelled zap can still
+// be rolled back. Nothing survives a crash.
+//
+// @param job Planned zap.
+//
+void ZapJournal::Track(const ZapJob& job) {
+	if (IsOpen())
+		return;
+	m_bTracking = true;
+	m_szFolder = job.GetFolder();
+	m_vDone.assign(job.GetPlan().GetCount(), false);
+}
+
+//
+// Rename
+//
+// Records that the folder is about to be renamed, before it is.
+//
+// @param szTo New path of the folder.
+// @return Result code.
+//
+HRESULT ZapJournal::Rename(const CString& szTo) {
+	if (!IsTracking())
+		return S_OK;
+	CComCritSecLock<CComAutoCriticalSection> lock(m_cs);
+	m_szRenamed = szTo;
+	if (!IsOpen())
+		return S_OK;
+	Append(RECORD_RENAME, 0, szTo);
+	return Flush();
+}
+
+//
+// Done
+//
+// Records a completed move. Records are flushed once DONE_BATCH of them
+// are pending, or with the next record that is flushed right away.
+//
+// @param i Plan index of the move.
+//
+void ZapJournal::Done(size_t i) {
+	if (!IsTracking())
+		return;
+	CComCritSecLock<CComAutoCriticalSection> lock(m_cs);
+	if (i < m_vDone.size())
+		m_vDone[i] = true;
+	if (!IsOpen())
+		return;
+	Append(RECORD_DONE, static_cast<DWORD>(i), CString());
+	if (++m_nPending >= DONE_BATCH)
+		Flush();
+}
+
+//
+// Moved
+//
+// Records that every move was attempted, so that only the folder itself is
+// left to delete or to restore.
+//
+// @param bAll Every move succeeded, including those not recorded one by one.
+// @return Result code.
+//
+HRESULT ZapJournal::Moved(bool bAll) {
+	if (!IsTracking())
+		return S_OK;
+	CComCritSecLock<CComAutoCriticalSection> lock(m_cs);
+	m_bMoved = true;
+	m_bAllMoved = bAll;
+	if (!IsOpen())
+		return S_OK;
+	Append(RECORD_MOVED, bAll ? 1 : 0, CString());
+	return Flush();
+}
+
+//
+// Commit
+//
+// Ends the journal of a zap that ran to its end, successfully or not, and
+// deletes it. The plan goes first: a journal found without its plan is
+// known to be over.
+//
+void ZapJournal::Commit() {
+	if (!IsOpen())
+		return;
+	::DeleteFile(m_szPlanPath);
+	::CloseHandle(m_hFile);
+	m_hFile = INVALID_HANDLE_VALUE;
+	::DeleteFile(m_szPath);
+	m_vBuffer.clear();
+	m_nPending = 0;
+}
+
+//
+// Keep
+//
+// Ends the journal of a zap that ran to its end and keeps it, with its
+// plan, as the undo record of the zap. Only the nDepth most recent undo
+// records of its destination are kept.
+//
+// @param nDepth Number of undo records to keep for each destination.
+//
+void ZapJournal::Keep(UINT nDepth) {
+	if (!IsOpen())
+		return;
+	Close();
+	CString szUndo = m_szPath.Left(m_szPath.ReverseFind(L'.')) + UNDO_EXTENSION;
+	if (!::MoveFileEx(m_szPath, szUndo, 0)) {
+		ZAP_LOG_WARNING(L"No undo 0x%08x | %s\n", HRESULT_FROM_WIN32(::GetLastError()), m_szPath);
+		::DeleteFile(m_szPlanPath);
+		::DeleteFile(m_szPath);
+		return;
+	}
+	// The name starts with the hash of the destination, which groups its records.
+	CString szName = szUndo.Mid(szUndo.ReverseFind(L'\\') + 1);
+	Prune(szName.Left(HASH_LENGTH), nDepth);
+}
+
+//
+// The journal is open, written or read
+//
+bool ZapJournal::IsOpen() const {
+	return m_hFile != INVALID_HANDLE_VALUE;
+}
+
+//
+// The rename and the completed moves are followed, in a file or in memory
+//
+bool ZapJournal::IsTracking() const {
+	return IsOpen() || m_bTracking;
+}
+
+//
+// FindPending
+//
+// Lists the journals left by zaps that did not commit. Some may belong to
+// zaps still running; Open() fails on those.
+//
+// @param vPaths Receives the paths of the journal files.
+// @return Result code.
+//
+HRESULT ZapJournal::FindPending(std::vector<CString>& vPaths) {
+	CString szDirectory = GetDirectory();
+	if (szDirectory.IsEmpty())
+		return E_FAIL;
+	WIN32_FIND_DATA data;
+	HANDLE hFind = ::FindFirstFile(szDirectory + L"\\*" + JOURNAL_EXTENSION, &data);
+	if (hFind == INVALID_HANDLE_VALUE) {
+		DWORD dwError = ::GetLastError();
+		return dwError == ERROR_FILE_NOT_FOUND ? S_OK : HRESULT_FROM_WIN32(dwError);
+	}
+	do {
+		if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			vPaths.push_back(szDirectory + L"\\" + data.cFileName);
+	} while (::FindNextFile(hFind, &data));
+	::FindClose(hFind);
+	return S_OK;
+}
+
+//
+// FindUndo
+//
+// Lists the undo records of the zaps whose content went to a folder. A
+// record may belong to another folder with the same hash; check GetFolder().
+//
+// @param szDestination Folder the content went to.
+// @param vPaths Receives the paths of the records, most recent first.
+// @return Result code.
+//
+HRESULT ZapJournal::FindUndo(const CString& szDestination, std::vector<CString>& vPaths) {
+	CString szDirectory = GetDirectory();
+	if (szDirectory.IsEmpty())
+		return E_FAIL;
+	CString szPattern;
+	szPattern.Format(L"%s\\%08X-*%s", szDirectory.GetString(), GetDestinationHash(szDestination), UNDO_EXTENSION);
+	WIN32_FIND_DATA data;
+	HANDLE hFind = ::FindFirstFile(szPattern, &data);
+	if (hFind == INVALID_HANDLE_VALUE) {
+		DWORD dwError = ::GetLastError();
+		return dwError == ERROR_FILE_NOT_FOUND || dwError == ERROR_PATH_NOT_FOUND ? S_OK : HRESULT_FROM_WIN32(dwError);
+	}
+	std::vector<CString> vNames;
+	do {
+		vNames.push_back(data.cFileName);
+	} while (::FindNextFile(hFind, &data));
+	::FindClose(hFind);
+	std::sort(vNames.begin(), vNames.end(), IsOlder);
+	for (size_t i = vNames.size(); i-- > 0; )
+		vPaths.push_back(szDirectory + L"\\" + vNames[i]);
+	return S_OK;
+}
+
+//
+// Open
+//
+// Opens a pending journal or an undo record exclusively and reads its
+// records, up to the first one that is incomplete or fails its checksum.
+//
+// @param szPath Path of the journal file or undo record.
+// @return Result code; ERROR_SHARING_VIOLATION if its zap is still running.
+//
+HRESULT ZapJournal::Open(const CString& szPath) {
+	m_hFile = ::CreateFile(szPath, GENERIC_READ, 0, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return HRESULT_FROM_WIN32(::GetLastError());
+	m_szPath = szPath;
+	m_szPlanPath = szPath.Left(szPath.ReverseFind(L'.')) + PLAN_EXTENSION;
+
+	LARGE_INTEGER liSize;
+	if (!::GetFileSizeEx(m_hFile, &liSize) || liSize.QuadPart > MAXDWORD)
+		return HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+	// A journal cut short before its header was written never got to its plan.
+	if (liSize.QuadPart < static_cast<LONGLONG>(sizeof(JournalHeader)))
+		return S_OK;
+	std::vector<BYTE> vData(static_cast<size_t>(liSize.QuadPart));
+	DWORD cbRead = 0;
+	if (!::ReadFile(m_hFile, &vData[0], static_cast<DWORD>(vData.size()), &cbRead, 0) || cbRead != vData.size())
+		return HRESULT_FROM_WIN32(ERROR_READ_FAULT);
+	JournalHeader header;
+	CopyMemory(&header, &vData[0], sizeof(header));
+	if (header.dwMagic != JOURNAL_MAGIC || header.dwVersion != JOURNAL_VERSION)
+		return HRESULT_FROM_WIN32(ERROR_BAD_FORMAT);
+
+	size_t uPos = sizeof(header);
+	while (vData.size() - uPos >= sizeof(JournalRecord)) {
+		JournalRecord record;
+		CopyMemory(&record, &vData[uPos], sizeof(record));
+		uPos += sizeof(record);
+		if (record.cchText > (vData.size() - uPos) / sizeof(WCHAR))
+			break;
+		LPCWSTR pszText = reinterpret_cast<LPCWSTR>(&vData[uPos]);
+		if (GetCheck(record, pszText) != record.dwCheck)
+			break;
+		uPos += record.cchText * sizeof(WCHAR);
+		switch (record.dwType) {
+		case RECORD_PLANNED:
+			m_bPlanned = true;
+			m_szFolder.SetString(pszText, record.cchText);
+			m_vDone.assign(record.dwValue, false);
+			break;
+		case RECORD_RENAME:
+			m_szRenamed.SetString(pszText, record.cchText);
+			break;
+		case RECORD_DONE:
+			if (record.dwValue < m_vDone.size())
+				m_vDone[record.dwValue] = true;
+			break;
+		case RECORD_MOVED:
+			m_bMoved = true;
+			m_bAllMoved = record.dwValue != 0;
+			break;
+		}
+	}
+	ZAP_LOG_INFO(L"Journal %s | planned %d, renamed %s, moved %d\n",
+		szPath, m_bPlanned, m_szRenamed, m_bMoved);
+	return S_OK;
+}
+
+//
+// Path of the plan saved with the journal
+//
+const CString& ZapJournal::GetPlanPath() const {
+	return m_szPlanPath;
+}
+
+//
+// Folder zapped, as it was planned
+//
+const CString& ZapJournal::GetFolder() const {
+	return m_szFolder;
+}
+
+//
+// The plan was saved completely, so moves may have started
+//
+bool ZapJournal::IsPlanned() const {
+	return m_bPlanned;
+}
+
+//
+// Path the folder was about to be renamed to, or an empty string
+//
+const CString& ZapJournal::GetRenamed() const {
+	return m_szRenamed;
+}
+
+//
+// Every move was attempted
+//
+bool ZapJournal::IsMoved() const {
+	return m_bMoved;
+}
+
+//
+// A move is recorded as completed, one by one or with all the others
+//
+// @param i Plan index of the move.
+//
+bool ZapJournal::IsDone(size_t i) const {
+	return m_bAllMoved || (i < m_vDone.size() && m_vDone[i]);
+}
+
+//
+// A move is recorded as completed by itself, not only with all the others
+//
+// @param i Plan index of the move.
+//
+bool ZapJournal::IsRecorded(size_t i) const {
+	return i < m_vDone.size() && m_vDone[i];
+}
+
+//
+// GetDirectory
+//
+// Folder of the journals: the JournalPath setting, or LevelZap\Journal in
+// the local application data folder. Begin() creates it.
+//
+// @return Path of the folder; an empty string if it is unknown.
+//
+CString ZapJournal::GetDirectory() {
+	CString szDirectory = ZapSettings::Current().GetString(L"JournalPath");
+	if (szDirectory.IsEmpty()) {
+		WCHAR szAppData[MAX_PATH];
+		if (FAILED(::SHGetFolderPath(0, CSIDL_LOCAL_APPDATA, 0, SHGFP_TYPE_CURRENT, szAppData)))
+			return CString();
+		szDirectory = CString(szAppData) + L"\\LevelZap\\Journal";
+	}
+	szDirectory.TrimRight(L"\\/");
+	return szDirectory;
+}
+
+//
+// Hash naming the records of a destination: FNV-1a over its upper-cased path
+//
+DWORD ZapJournal::GetDestinationHash(const CString& szDestination) {
+	CString szKey(szDestination);
+	szKey.TrimRight(L"\\/");
+	szKey.MakeUpper();
+	DWORD dwHash = 2166136261u;
+	for (int i = 0; i < szKey.GetLength(); ++i)
+		dwHash = (dwHash ^ szKey[i]) * 16777619u;
+	return dwHash;
+}
+
+//
+// Prune
+//
+// Deletes the oldest undo records of a destination, and their plans, beyond
+// a number. Records of destinations with the same hash are pruned together,
+// which at worst keeps fewer of them. A record in use by an un-zap cannot be
+// deleted and is left alone.
+//
+// @param szPrefix Start of the record names: the destination hash and its dash.
+// @param nDepth Number of records to keep.
+//
+void ZapJournal::Prune(const CString& szPrefix, UINT nDepth) {
+	CString szDirectory = GetDirectory();
+	WIN32_FIND_DATA data;
+	HANDLE hFind = ::FindFirstFile(szDirectory + L"\\" + szPrefix + L"*" + UNDO_EXTENSION, &data);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return;
+	std::vector<CString> vNames;
+	do {
+		if (wcslen(data.cFileName) > HASH_LENGTH)
+			vNames.push_back(data.cFileName);
+	} while (::FindNextFile(hFind, &data));
+	::FindClose(hFind);
+	if (vNames.size() <= nDepth)
+		return;
+	std::sort(vNames.begin(), vNames.end(), IsOlder);
+	for (size_t i = 0; i < vNames.size() - nDepth; ++i) {
+		CString szPath = szDirectory + L"\\" + vNames[i];
+		if (::DeleteFile(szPath))
+			::DeleteFile(szPath.Left(szPath.ReverseFind(L'.')) + PLAN_EXTENSION);
+	}
+}
+
+//
+// Append
+//
+// Adds a record to the buffer; the caller holds m_cs.
+//
+void ZapJournal::Append(DWORD dwType, DWORD dwValue, const CString& szText) {
+	JournalRecord record = { dwType, dwValue, static_cast<DWORD>(szText.GetLength()), 0 };
+	record.dwCheck = GetCheck(record, szText.GetString());
+	const BYTE* p = reinterpret_cast<const BYTE*>(&record);
+	m_vBuffer.insert(m_vBuffer.end(), p, p + sizeof(record));
+	p = reinterpret_cast<const BYTE*>(szText.GetString());
+	m_vBuffer.insert(m_vBuffer.end(), p, p + record.cchText * sizeof(WCHAR));
+}
+
+//
+// Flush
+//
+// Writes the buffered records and flushes them to the disk; the caller
+// holds m_cs. After a failure the zap goes on without its journal.
+//
+// @return Result code.
+//
+HRESULT ZapJournal::Flush() {
+	if (m_bFailed)
+		return E_FAIL;
+	DWORD cbWritten = 0;
+	if ((!m_vBuffer.empty()
+			&& !::WriteFile(m_hFile, &m_vBuffer[0], static_cast<DWORD>(m_vBuffer.size()), &cbWritten, 0))
+		|| !::FlushFileBuffers(m_hFile)) {
+		m_bFailed = true;
+		ZAP_LOG_WARNING(L"Journal write failed 0x%08x | %s\n", HRESULT_FROM_WIN32(::GetLastError()), m_szPath);
+	}
+	m_vBuffer.clear();
+	m_nPending = 0;
+	return m_bFailed ? E_FAIL : S_OK;
+}
+
+//
+// Close
+//
+// Writes the pending records and closes the journal, keeping its files.
+//
+void ZapJournal::Close() {
+	if (!IsOpen())
+		return;
+	if (!m_vBuffer.empty())
+		Flush();
+	::CloseHandle(m_hFile);
+	m_hFile = INVALID_HANDLE_VALUE;
+}
@@ -0,0 +1,159 @@
+// ZapLog.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapLog.h"
+#include "ZapSettings.h"
+
+volatile LONG ZapLog::s_lLevel = 0;
+volatile LONG ZapLog::s_lSinks = 0;
+ZapLog::Slot ZapLog::s_vSlots[SLOT_COUNT];
+volatile LONG ZapLog::s_lTail = 0;
+LONG ZapLog::s_lHead = 0;
+volatile LONG ZapLog::s_lFlushing = 0;
+volatile LONG ZapLog::s_lDropped = 0;
+
+//
+// Configure
+//
+// Sets the sinks and the highest level written to them. Messages above
+// ZAP_LOG_MAX_LEVEL are compiled out whatever the level.
+//
+// @param iLevel Highest level to write, e.g. ZAP_LOG_LEVEL_INFO; 0 disables logging.
+// @param dwSinks Combination of Sink values; 0 disables logging.
+//
+void ZapLog::Configure(int iLevel, DWORD dwSinks) {
+	::InterlockedExchange(&s_lSinks, static_cast<LONG>(dwSinks));
+	::InterlockedExchange(&s_lLevel, dwSinks != 0 ? iLevel : 0);
+}
+
+//
+// LoadSettings
+//
+// Configures the log from the LogLevel setting. When it is not set, messages
+// go to an attached debugger only, as OutputDebugStringEx() always did.
+//
+void ZapLog::LoadSettings() {
+	int iLevel = static_cast<int>(ZapSettings::Current().GetDWORD(L"LogLevel"));
+	if (iLevel == 0 && ::IsDebuggerPresent())
+		iLevel = ZAP_LOG_LEVEL_TRACE;
+	Configure(iLevel, SINK_DEBUGGER);
+}
+
+//
+// Write
+//
+// Formats a message into the ring. Use the ZAP_LOG_* macros instead, so that
+// disabled messages cost nothing.
+//
+// @param iLevel Level of the message.
+// @param format printf-style format, followed by its arguments.
+//
+void ZapLog::Write(int iLevel, const wchar_t* format, ...) {
+	va_list args;
+	va_start(args, format);
+	WriteV(iLevel, format, args);
+	va_end(args);
+}
+
+//
+// Formats a message into the ring
+//
+void ZapLog::WriteV(int iLevel, const wchar_t* format, va_list args) {
+	LONG lPosition;
+	Slot* pSlot = Claim(lPosition);
+	if (pSlot == 0) {
+		// Full: make room, unless someone else is already doing it.
+		Flush();
+		pSlot = Claim(lPosition);
+		if (pSlot == 0) {
+			::InterlockedIncrement(&s_lDropped);
+			return;
+		}
+	}
+	pSlot->iLevel = iLevel;
+	_vsnwprintf_s(pSlot->szText, SLOT_LENGTH, _TRUNCATE, format, args);
+	// Publish the slot to the flushing thread.
+	LONG lIndex = lPosition & (SLOT_COUNT - 1);
+	::InterlockedExchange(&pSlot->lSequence, lPosition + 1 - lIndex);
+}
+
+//
+// Claim
+//
+// Reserves the next slot of the ring for a writer.
+//
+// @param lPosition Receives the ring position of the slot.
+// @return Slot, or 0 if the ring is full.
+//
+ZapLog::Slot* ZapLog::Claim(LONG& lPosition) {
+	LONG lTail = s_lTail;
+	for (;;) {
+		LONG lIndex = lTail & (SLOT_COUNT - 1);
+		Slot& slot = s_vSlots[lIndex];
+		LONG lDiff = slot.lSequence + lIndex - lTail;
+		if (lDiff == 0) {
+			LONG lSeen = ::InterlockedCompareExchange(&s_lTail, lTail + 1, lTail);
+			if (lSeen == lTail) {
+				lPosition = lTail;
+				return &slot;
+			}
+			lTail = lSeen;
+		} else if (lDiff < 0) {
+			return 0;
+		} else {
+			lTail = s_lTail;
+		}
+	}
+}
+
+//
+// Flush
+//
+// Writes the messages in the ring to the sinks, in order. Only one thread
+// flushes at a time; the others return at once.
+//
+void ZapLog::Flush() {
+	if (::InterlockedCompareExchange(&s_lFlushing, 1, 0) != 0)
+		return;
+	LONG lSinks = s_lSinks;
+	for (;;) {
+		LONG lIndex = s_lHead & (SLOT_COUNT - 1);
+		Slot& slot = s_vSlots[lIndex];
+		if (slot.lSequence + lIndex - (s_lHead + 1) < 0)
+			break;
+		if (lSinks & SINK_DEBUGGER)
+			::OutputDebugString(slot.szText);
+		if (lSinks & SINK_CONSOLE)
+			fwprintf(stderr, L"%s", slot.szText);
+		// Hand the slot back to the writers for the next lap of the ring.
+		::InterlockedExchange(&slot.lSequence, s_lHead + SLOT_COUNT - lIndex);
+		++s_lHead;
+	}
+	::InterlockedExchange(&s_lFlushing, 0);
+}
+
+//
+// Number of messages dropped because the ring was full
+//
+LONG ZapLog::GetDroppedCount() {
+	return s_lDropped;
+}
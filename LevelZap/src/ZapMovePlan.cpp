@@ -0,0 +1,518 @@
+// ZapMovePlan.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapMovePlan.h"
+#include "ZapDedup.h"
+#include "ZapLog.h"
+#include "ZapNameIndex.h"
+#include "ZapPathBuilder.h"
+
+//
+// Constructor.
+//
+ZapMovePlan::ZapMovePlan()
+	: m_pTree(0),
+	  m_szTo(),
+	  m_vMoves(),
+	  m_nSkipped(0),
+	  m_nDeduped(0),
+	  m_ullDeduped(0)
+{
+}
+
+//
+// Build
+//
+// Plans the moves of a zap, in the same order a recursive walk of the folder
+// would produce them.
+//
+// @param tree Scanned folder. Must outlive the plan.
+// @param szTo Destination folder.
+// @param uDepth Levels to flatten: 1 moves the children of the folder, N also flattens
+//               their subfolders down to N levels, moving those deeper as a whole,
+//               and ZapTree::ALL_LEVELS flattens every subfolder.
+//
+void ZapMovePlan::Build(const ZapTree& tree, const CString& szTo, UINT uDepth) {
+	m_pTree = &tree;
+	m_szTo = szTo;
+	m_vMoves.clear();
+	m_nSkipped = 0;
+	m_nDeduped = 0;
+	m_ullDeduped = 0;
+	if (tree.GetCount() > 0)
+		AppendMoves(ZapTree::ROOT, 0, uDepth);
+}
+
+//
+// Restore
+//
+// Rebuilds a plan resolved earlier, e.g. from a saved plan.
+//
+// @param tree Tree the moves come from. Must outlive the plan.
+// @param szTo Destination folder.
+// @param vMoves Moves; their names must be owned by the tree's string pool.
+// @param nSkipped Moves the plan dropped when it was resolved.
+//
+void ZapMovePlan::Restore(const ZapTree& tree, const CString& szTo,
+						  const std::vector<ZapMove>& vMoves, size_t nSkipped) {
+	m_pTree = &tree;
+	m_szTo = szTo;
+	m_vMoves = vMoves;
+	m_nSkipped = nSkipped;
+	m_nDeduped = 0;
+	m_ullDeduped = 0;
+}
+
+//
+// AppendMoves
+//
+// Appends the children of one directory to the plan.
+//
+// @param uNode Directory node.
+// @param uLevel Depth of the directory below the zapped folder.
+// @param uDepth Levels to flatten.
+//
+void ZapMovePlan::AppendMoves(UINT uNode, UINT uLevel, UINT uDepth) {
+	const ZapNode& node = m_pTree->GetNode(uNode);
+	bool bFlatten = ZapTree::IsFlattened(uDepth, uLevel + 1);
+	for (UINT i = node.uFirstChild; i < node.uFirstChild + node.uChildCount; ++i) {
+		const ZapNode& child = m_pTree->GetNode(i);
+		if (child.bExcluded)
+			continue;
+		if (child.IsDirectory() && bFlatten) {
+			ZAP_LOG_TRACE(L"Folder %s\n", m_pTree->GetPath(i));
+			AppendMoves(i, uLevel + 1, uDepth);
+		} else {
+			ZapMove move;
+			move.uNode = i;
+			move.pszName = child.pszName;
+			move.cchName = child.cchName;
+			move.bReplace = false;
+			m_vMoves.push_back(move);
+			ZAP_LOG_TRACE(L"    Move %s -> %s\n", GetFromPath(m_vMoves.size() - 1), GetToPath(m_vMoves.size() - 1));
+		}
+	}
+}
+
+//
+// Number of planned moves
+//
+size_t ZapMovePlan::GetCount() const {
+	return m_vMoves.size();
+}
+
+//
+// Planned move accessor
+//
+const ZapMove& ZapMovePlan::GetMove(size_t i) const {
+	return m_vMoves[i];
+}
+
+//
+// Tree the plan was built from
+//
+const ZapTree& ZapMovePlan::GetTree() const {
+	return *m_pTree;
+}
+
+//
+// Destination folder
+//
+const CString& ZapMovePlan::GetDestination() const {
+	return m_szTo;
+}
+
+//
+// Source path of a move
+//
+CString ZapMovePlan::GetFromPath(size_t i) const {
+	return m_pTree->GetPath(m_vMoves[i].uNode);
+}
+
+//
+// Destination path of a move
+//
+CString ZapMovePlan::GetToPath(size_t i) const {
+	return m_szTo + L"\\" + m_vMoves[i].pszName;
+}
+
+//
+// Source path of a move, into a reused buffer
+//
+void ZapMovePlan::GetFromPath(size_t i, ZapPathBuilder& path) const {
+	m_pTree->GetPath(m_vMoves[i].uNode, path);
+}
+
+//
+// Destination path of a move, into a reused buffer
+//
+void ZapMovePlan::GetToPath(size_t i, ZapPathBuilder& path) const {
+	path.Reset(m_szTo);
+	path.Push(m_vMoves[i].pszName, m_vMoves[i].cchName);
+}
+
+//
+// GetFromList
+//
+// Builds the double-null source list expected by SHFileOperation for the
+// moves that replace their destination, or for the others. The buffer is
+// sized once and filled in place.
+//
+// @param buffer Receives the list, including the final terminator.
+// @param bReplace List the moves marked bReplace; otherwise the other ones.
+// @return Number of moves listed.
+//
+size_t ZapMovePlan::GetFromList(CAtlArray<WCHAR>& buffer, bool bReplace) const {
+	size_t cchTotal = 1, nListed = 0;
+	for (size_t i = 0; i < m_vMoves.size(); ++i)
+		if (m_vMoves[i].bReplace == bReplace)
+			cchTotal += m_pTree->GetPathLength(m_vMoves[i].uNode) + 1;
+
+	buffer.SetCount(cchTotal);
+	WCHAR* p = buffer.GetData();
+	for (size_t i = 0; i < m_vMoves.size(); ++i) {
+		if (m_vMoves[i].bReplace != bReplace)
+			continue;
+		UINT cch = m_pTree->GetPathLength(m_vMoves[i].uNode);
+		m_pTree->CopyPath(m_vMoves[i].uNode, p, cch);
+		p += cch;
+		*p++ = L'\0';
+		++nListed;
+	}
+	*p = L'\0';
+	return nListed;
+}
+
+//
+// GetToList
+//
+// Builds the double-null destination list expected by SHFileOperation,
+// matching GetFromList(). The buffer is sized once and filled in place.
+//
+// @param buffer Receives the list, including the final terminator.
+// @param bReplace List the moves marked bReplace; otherwise the other ones.
+// @return Number of moves listed.
+//
+size_t ZapMovePlan::GetToList(CAtlArray<WCHAR>& buffer, bool bReplace) const {
+	UINT cchTo = m_szTo.GetLength();
+	size_t cchTotal = 1, nListed = 0;
+	for (size_t i = 0; i < m_vMoves.size(); ++i)
+		if (m_vMoves[i].bReplace == bReplace)
+			cchTotal += cchTo + 1 + m_vMoves[i].cchName + 1;
+
+	buffer.SetCount(cchTotal);
+	WCHAR* p = buffer.GetData();
+	for (size_t i = 0; i < m_vMoves.size(); ++i) {
+		if (m_vMoves[i].bReplace != bReplace)
+			continue;
+		CopyMemory(p, m_szTo.GetString(), cchTo * sizeof(WCHAR));
+		p += cchTo;
+		*p++ = L'\\';
+		CopyMemory(p, m_vMoves[i].pszName, m_vMoves[i].cchName * sizeof(WCHAR));
+		p += m_vMoves[i].cchName;
+		*p++ = L'\0';
+		++nListed;
+	}
+	*p = L'\0';
+	return nListed;
+}
+
+//
+// FindCollisions
+//
+// Finds every move whose destination name is taken, with one pass over the
+// plan and one over the destination folder. Names are compared as NTFS does.
+//
+// @param szFolderName Name of the zapped folder.
+// @param pParent Destination folder scanned without recursion, or 0 to skip
+//                the entries already there.
+// @param vCollisions Receives the collisions, appended in plan order per kind.
+//
+void ZapMovePlan::FindCollisions(const CString& szFolderName, const ZapTree* pParent,
+								 std::vector<ZapCollision>& vCollisions) const {
+	ZapNameIndex index;
+	index.Reserve(m_vMoves.size());
+	UINT cchFolderName = szFolderName.GetLength();
+	for (size_t i = 0; i < m_vMoves.size(); ++i) {
+		const ZapMove& move = m_vMoves[i];
+		UINT uOther = index.Insert(move.pszName, move.cchName, static_cast<UINT>(i));
+		if (uOther != ZapNameIndex::NONE) {
+			ZapCollision collision = { ZapCollision::SIBLING, i, uOther };
+			vCollisions.push_back(collision);
+		}
+		if (ZapNameIndex::Equals(move.pszName, move.cchName, szFolderName, cchFolderName)) {
+			ZapCollision collision = { ZapCollision::FOLDER, i, 0 };
+			vCollisions.push_back(collision);
+		}
+	}
+	if (pParent == 0 || pParent->GetCount() == 0)
+		return;
+
+	const ZapNode& parent = pParent->GetNode(ZapTree::ROOT);
+	for (UINT i = parent.uFirstChild; i < parent.uFirstChild + parent.uChildCount; ++i) {
+		const ZapNode& node = pParent->GetNode(i);
+		// The zapped folder itself is reported as FOLDER above.
+		if (ZapNameIndex::Equals(node.pszName, node.cchName, szFolderName, cchFolderName))
+			continue;
+		UINT uMove = index.Find(node.pszName, node.cchName);
+		if (uMove != ZapNameIndex::NONE) {
+			ZapCollision collision = { ZapCollision::PARENT, uMove, i };
+			vCollisions.push_back(collision);
+		}
+	}
+}
+
+//
+// Resolve
+//
+// Settles every collision found by FindCollisions() before anything moves,
+// so that the moves run without asking. Renamed entries get new names in the
+// tree's string pool; skipped entries are dropped from the plan, which makes
+// the collision indexes stale.
+//
+// Only a file replaces a file: KEEP_NEWER and KEEP_LARGER rename an entry
+// that collides with or is a directory.
+//
+// With a comparison of the colliding files, a file holding the same bytes as
+// the entry that keeps its name is skipped whatever the policy, and is not
+// counted as taking the name.
+//
+// @param policy How to resolve the collisions.
+// @param pParent Destination folder the collisions were found with, or 0.
+// @param vCollisions Collisions found by FindCollisions().
+// @param pDedup Comparison of the colliding files made with the same collisions, or 0.
+// @return Result code; ERROR_FILE_EXISTS if the policy is FAIL and a name is taken.
+//
+HRESULT ZapMovePlan::Resolve(ZapCollision::Policy policy, const ZapTree* pParent,
+							 const std::vector<ZapCollision>& vCollisions, const ZapDedup* pDedup) {
+	if (policy == ZapCollision::ASK && pDedup == 0)
+		return S_OK;
+	size_t nTaken = 0, nSame = 0;
+	for (size_t i = 0; i < vCollisions.size(); ++i) {
+		const ZapCollision& collision = vCollisions[i];
+		if (collision.kind == ZapCollision::FOLDER)
+			continue;
+		if (pDedup != 0 && pDedup->IsSame(collision.iMove, collision.kind, collision.iOther))
+			++nSame;
+		else
+			++nTaken;
+	}
+	if (nTaken == 0 && nSame == 0)
+		return S_OK;
+	if (policy == ZapCollision::FAIL && nTaken != 0)
+		return HRESULT_FROM_WIN32(ERROR_FILE_EXISTS);
+
+	// Every name in use at the destination once the plan has run.
+	ZapNameIndex taken;
+	const ZapNode* pRoot = pParent != 0 && pParent->GetCount() != 0 ? &pParent->GetNode(ZapTree::ROOT) : 0;
+	taken.Reserve(m_vMoves.size() + (pRoot != 0 ? pRoot->uChildCount : 0));
+	for (size_t i = 0; i < m_vMoves.size(); ++i)
+		taken.Insert(m_vMoves[i].pszName, m_vMoves[i].cchName, static_cast<UINT>(i));
+	for (UINT i = 0; pRoot != 0 && i < pRoot->uChildCount; ++i) {
+		const ZapNode& node = pParent->GetNode(pRoot->uFirstChild + i);
+		taken.Insert(node.pszName, node.cchName, ZapNameIndex::NONE);
+	}
+
+	// Collisions name the first move of each name; vHolder tracks which move keeps it.
+	std::vector<size_t> vHolder(m_vMoves.size());
+	for (size_t i = 0; i < vHolder.size(); ++i)
+		vHolder[i] = i;
+	std::vector<bool> vSkip(m_vMoves.size(), false);
+	for (size_t i = 0; i < vCollisions.size(); ++i) {
+		const ZapCollision& collision = vCollisions[i];
+		if (collision.kind == ZapCollision::FOLDER)
+			continue;
+		bool bSibling = collision.kind == ZapCollision::SIBLING;
+		size_t iMove = bSibling ? collision.iMove : vHolder[collision.iMove];
+		const ZapNode& node = m_pTree->GetNode(m_vMoves[iMove].uNode);
+		size_t iOther = bSibling ? vHolder[collision.iOther] : collision.iOther;
+		const ZapNode& other = bSibling
+			? m_pTree->GetNode(m_vMoves[iOther].uNode)
+			: pParent->GetNode(static_cast<UINT>(iOther));
+
+		// A copy of what keeps the name is redundant.
+		if (pDedup != 0 && pDedup->IsSame(iMove, collision.kind, iOther)) {
+			ZAP_LOG_INFO(L"DUPLICATE: %s\n", GetFromPath(iMove));
+			vSkip[iMove] = true;
+			++m_nDeduped;
+			m_ullDeduped += node.ullSize;
+			continue;
+		}
+		if (policy == ZapCollision::ASK || policy == ZapCollision::FAIL)
+			continue;
+
+		ZapCollision::Policy resolution = policy;
+		if ((policy == ZapCollision::KEEP_NEWER || policy == ZapCollision::KEEP_LARGER)
+			&& (node.IsDirectory() || other.IsDirectory()))
+			resolution = ZapCollision::RENAME;
+		switch (resolution) {
+		case ZapCollision::RENAME:
+			Rename(iMove, CString(), taken);
+			break;
+		case ZapCollision::PREFIX:
+			Rename(iMove, GetPrefix(m_vMoves[iMove].uNode), taken);
+			break;
+		case ZapCollision::KEEP_NEWER:
+		case ZapCollision::KEEP_LARGER: {
+			bool bWins = resolution == ZapCollision::KEEP_NEWER
+				? ::CompareFileTime(&node.ftWrite, &other.ftWrite) > 0
+				: node.ullSize > other.ullSize;
+			if (!bWins) {
+				vSkip[iMove] = true;
+			} else if (bSibling) {
+				vSkip[vHolder[collision.iOther]] = true;
+				vHolder[collision.iOther] = iMove;
+			} else {
+				m_vMoves[iMove].bReplace = true;
+			}
+			break;
+		}
+		default:
+			vSkip[iMove] = true;
+			break;
+		}
+	}
+
+	size_t nKept = 0;
+	for (size_t i = 0; i < m_vMoves.size(); ++i) {
+		if (vSkip[i])
+			ZAP_LOG_INFO(L"SKIPPED: %s\n", GetFromPath(i));
+		else
+			m_vMoves[nKept++] = m_vMoves[i];
+	}
+	m_nSkipped += m_vMoves.size() - nKept;
+	m_vMoves.resize(nKept);
+	return S_OK;
+}
+
+//
+// Number of moves dropped when resolving collisions
+//
+// @return Entries left in the zapped folder.
+//
+size_t ZapMovePlan::GetSkippedCount() const {
+	return m_nSkipped;
+}
+
+//
+// Number of skipped moves whose file was the same as what keeps its name
+//
+size_t ZapMovePlan::GetDedupedCount() const {
+	return m_nDeduped;
+}
+
+//
+// Bytes of the files skipped as duplicates
+//
+ULONGLONG ZapMovePlan::GetDedupedBytes() const {
+	return m_ullDeduped;
+}
+
+//
+// Rename
+//
+// Gives a move a destination name nobody else uses: the prefixed name if it
+// is free, otherwise the first free "name (n).ext", with the name shortened
+// to keep it within MAX_NAME.
+//
+// @param i Move to rename.
+// @param szPrefix Prefix of the name; may be empty.
+// @param taken Names in use; receives the new name.
+//
+void ZapMovePlan::Rename(size_t i, const CString& szPrefix, ZapNameIndex& taken) {
+	ZapMove& move = m_vMoves[i];
+	CString szName(move.pszName, move.cchName);
+	CString szCandidate;
+	if (!szPrefix.IsEmpty() && szPrefix.GetLength() + szName.GetLength() <= MAX_NAME) {
+		szCandidate = szPrefix + szName;
+		if (taken.Find(szCandidate, szCandidate.GetLength()) != ZapNameIndex::NONE)
+			szCandidate.Empty();
+	}
+	if (szCandidate.IsEmpty()) {
+		// The extension stays last; a leading dot starts the name, not an extension.
+		int iDot = szName.ReverseFind(L'.');
+		if (iDot <= 0)
+			iDot = szName.GetLength();
+		CString szExtension = szName.Mid(iDot);
+		WCHAR szNumber[16];
+		for (UINT n = 2; ; ++n) {
+			int cchNumber = swprintf_s(szNumber, L" (%u)", n);
+			// Shorten the stem so the name fits; the extension goes too if it alone does not.
+			CString szStem = szName.Left(iDot);
+			CString szTail = szExtension;
+			if (cchNumber + szTail.GetLength() >= MAX_NAME) {
+				szStem = szName;
+				szTail.Empty();
+			}
+			int cchStem = MAX_NAME - cchNumber - szTail.GetLength();
+			if (szStem.GetLength() > cchStem) {
+				if (IS_HIGH_SURROGATE(szStem[cchStem - 1]))
+					--cchStem;
+				szStem.Truncate(cchStem);
+			}
+			szCandidate = szStem + szNumber + szTail;
+			if (taken.Find(szCandidate, szCandidate.GetLength()) == ZapNameIndex::NONE)
+				break;
+		}
+	}
+	ZAP_LOG_INFO(L"RENAMED: %s -> %s\n", GetFromPath(i), szCandidate);
+	move.cchName = szCandidate.GetLength();
+	move.pszName = m_pTree->GetPool().Store(szCandidate, move.cchName);
+	taken.Insert(move.pszName, move.cchName, static_cast<UINT>(i));
+}
+
+//
+// GetPrefix
+//
+// Prefix made of the folders between the zapped folder and an entry, e.g.
+// "photos_2019_" for photos\2019\a.jpg. Empty for immediate children.
+//
+CString ZapMovePlan::GetPrefix(UINT uNode) const {
+	CString szPrefix;
+	for (UINT u = m_pTree->GetNode(uNode).uParent; u != ZapTree::ROOT; u = m_pTree->GetNode(u).uParent) {
+		const ZapNode& node = m_pTree->GetNode(u);
+		szPrefix = CString(node.pszName, node.cchName) + L"_" + szPrefix;
+	}
+	return szPrefix;
+}
+
+//
+// Memory held by the plan and the tree it points into
+//
+// @return Bytes.
+//
+size_t ZapMovePlan::GetFootprint() const {
+	return m_vMoves.capacity() * sizeof(ZapMove) + (m_pTree ? m_pTree->GetFootprint() : 0);
+}
+
+//
+// Memory the same plan takes as two double-null path lists
+//
+// @return Bytes.
+//
+size_t ZapMovePlan::GetListFootprint() const {
+	size_t cch = 2;
+	for (size_t i = 0; i < m_vMoves.size(); ++i)
+		cch += m_pTree->GetPathLength(m_vMoves[i].uNode) + 1
+			 + m_szTo.GetLength() + 1 + m_vMoves[i].cchName + 1;
+	return cch * sizeof(WCHAR);
+}
@@ -0,0 +1,254 @@
+// ZapNameIndex.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapNameIndex.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#define ZAP_NAME_SSE2
+#endif
+
+namespace {
+
+	// Units folded at once on the stack when hashing or comparing.
+	const UINT FOLD_CHUNK = 64;
+
+	typedef WCHAR (WINAPI *RtlUpcaseUnicodeCharProc)(WCHAR);
+
+	WCHAR			s_vUpcase[0x10000];		// Upcase table, by UTF-16 unit.
+	volatile LONG	s_lUpcaseReady = 0;		// s_vUpcase is filled.
+
+	//
+	// GetUpcase
+	//
+	// Fills the upcase table on first use from RtlUpcaseUnicodeChar, the
+	// routine NTFS builds its own table from. Concurrent callers all store the
+	// same values, so no lock is needed.
+	//
+	const WCHAR* GetUpcase() {
+		if (s_lUpcaseReady)
+			return s_vUpcase;
+		HMODULE hNtdll = ::GetModuleHandle(L"ntdll.dll");
+		RtlUpcaseUnicodeCharProc pUpcase = hNtdll != 0
+			? reinterpret_cast<RtlUpcaseUnicodeCharProc>(::GetProcAddress(hNtdll, "RtlUpcaseUnicodeChar")) : 0;
+		// Each unit is stored once, with its final value, as readers may already use the table.
+		for (UINT c = 0; c < 0x10000; ++c) {
+			WCHAR ch = static_cast<WCHAR>(c);
+			if (pUpcase != 0)
+				ch = pUpcase(ch);
+			else if (c < 0xD800 || c > 0xDFFF)	// A lone surrogate would not survive the conversion.
+				::CharUpperBuffW(&ch, 1);
+			s_vUpcase[c] = ch;
+		}
+		::InterlockedExchange(&s_lUpcaseReady, 1);
+		return s_vUpcase;
+	}
+}
+
+//
+// Constructor.
+//
+ZapNameIndex::ZapNameIndex()
+	: m_vEntries(),
+	  m_vSlots()
+{
+}
+
+//
+// Reserve
+//
+// Sizes the table for a number of names, so that it is not rehashed while
+// they are inserted.
+//
+// @param nNames Expected number of names.
+//
+void ZapNameIndex::Reserve(size_t nNames) {
+	m_vEntries.reserve(nNames);
+	size_t nSlots = 16;
+	while (nSlots < nNames * 2)
+		nSlots *= 2;
+	if (nSlots > m_vSlots.size())
+		Grow(nSlots);
+}
+
+//
+// Insert
+//
+// Adds a name unless an equal one is already indexed.
+//
+// @param pszName Name; must outlive the index.
+// @param cchName Length of the name.
+// @param uValue Value returned by Find() for this name.
+// @return Value of the equal name already indexed, or NONE if the name was added.
+//
+UINT ZapNameIndex::Insert(LPCWSTR pszName, UINT cchName, UINT uValue) {
+	if ((m_vEntries.size() + 1) * 2 > m_vSlots.size())
+		Grow(m_vSlots.empty() ? 16 : m_vSlots.size() * 2);
+	UINT uHash = Hash(pszName, cchName);
+	size_t iSlot;
+	UINT uExisting = Lookup(pszName, cchName, uHash, iSlot);
+	if (uExisting != NONE)
+		return uExisting;
+	Entry entry = { pszName, cchName, uValue };
+	m_vSlots[iSlot].uHash = uHash;
+	m_vSlots[iSlot].uEntry = static_cast<UINT>(m_vEntries.size());
+	m_vEntries.push_back(entry);
+	return NONE;
+}
+
+//
+// Find
+//
+// @param pszName Name to look for.
+// @param cchName Length of the name.
+// @return Value of the equal name, or NONE.
+//
+UINT ZapNameIndex::Find(LPCWSTR pszName, UINT cchName) const {
+	if (m_vEntries.empty())
+		return NONE;
+	size_t iSlot;
+	return Lookup(pszName, cchName, Hash(pszName, cchName), iSlot);
+}
+
+//
+// Number of indexed names
+//
+size_t ZapNameIndex::GetCount() const {
+	return m_vEntries.size();
+}
+
+//
+// Lookup
+//
+// Probes the table for a name.
+//
+// @param iSlot Receives the slot of the name, or the free slot it would take.
+// @return Value of the equal name, or NONE.
+//
+UINT ZapNameIndex::Lookup(LPCWSTR pszName, UINT cchName, UINT uHash, size_t& iSlot) const {
+	size_t nMask = m_vSlots.size() - 1;
+	for (iSlot = uHash & nMask; m_vSlots[iSlot].uEntry != NONE; iSlot = (iSlot + 1) & nMask) {
+		const Slot& slot = m_vSlots[iSlot];
+		if (slot.uHash != uHash)
+			continue;
+		const Entry& entry = m_vEntries[slot.uEntry];
+		if (Equals(entry.pszName, entry.cchName, pszName, cchName))
+			return entry.uValue;
+	}
+	return NONE;
+}
+
+//
+// Grow
+//
+// Rehashes the table into more slots. The hashes are kept in the slots, so
+// no name is folded again.
+//
+void ZapNameIndex::Grow(size_t nSlots) {
+	Slot empty = { 0, NONE };
+	std::vector<Slot> vSlots(nSlots, empty);
+	size_t nMask = nSlots - 1;
+	for (size_t i = 0; i < m_vSlots.size(); ++i) {
+		if (m_vSlots[i].uEntry == NONE)
+			continue;
+		size_t iSlot = m_vSlots[i].uHash & nMask;
+		while (vSlots[iSlot].uEntry != NONE)
+			iSlot = (iSlot + 1) & nMask;
+		vSlots[iSlot] = m_vSlots[i];
+	}
+	m_vSlots.swap(vSlots);
+}
+
+//
+// Fold
+//
+// Upcases a name unit by unit, as NTFS does before comparing names.
+//
+// @param pszName Name.
+// @param cchName Length of the name.
+// @param pDst Receives cchName folded units; may be pszName.
+//
+void ZapNameIndex::Fold(LPCWSTR pszName, UINT cchName, WCHAR* pDst) {
+	UINT i = 0;
+#ifdef ZAP_NAME_SSE2
+	const __m128i vBeforeA = _mm_set1_epi16(L'a' - 1);
+	const __m128i vAfterZ = _mm_set1_epi16(L'z' + 1);
+	const __m128i vCase = _mm_set1_epi16(L'a' - L'A');
+	const __m128i vNonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+	const __m128i vZero = _mm_setzero_si128();
+	for (; i + 8 <= cchName; i += 8) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pszName + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, vNonAscii), vZero)) != 0xFFFF) {
+			// Not all ASCII; this block goes through the table.
+			const WCHAR* pUpcase = GetUpcase();
+			for (UINT j = i; j < i + 8; ++j)
+				pDst[j] = pUpcase[pszName[j]];
+			continue;
+		}
+		__m128i vLower = _mm_and_si128(_mm_cmpgt_epi16(v, vBeforeA), _mm_cmplt_epi16(v, vAfterZ));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_sub_epi16(v, _mm_and_si128(vLower, vCase)));
+	}
+#endif
+	for (; i < cchName; ++i) {
+		WCHAR c = pszName[i];
+		if (c < 0x80)
+			pDst[i] = (c >= L'a' && c <= L'z') ? static_cast<WCHAR>(c - (L'a' - L'A')) : c;
+		else
+			pDst[i] = GetUpcase()[c];
+	}
+}
+
+//
+// Equals
+//
+// @return The names are equal once folded.
+//
+bool ZapNameIndex::Equals(LPCWSTR pszName1, UINT cchName1, LPCWSTR pszName2, UINT cchName2) {
+	if (cchName1 != cchName2)
+		return false;
+	WCHAR vFolded1[FOLD_CHUNK], vFolded2[FOLD_CHUNK];
+	for (UINT i = 0; i < cchName1; i += FOLD_CHUNK) {
+		UINT cch = cchName1 - i < FOLD_CHUNK ? cchName1 - i : FOLD_CHUNK;
+		Fold(pszName1 + i, cch, vFolded1);
+		Fold(pszName2 + i, cch, vFolded2);
+		if (memcmp(vFolded1, vFolded2, cch * sizeof(WCHAR)) != 0)
+			return false;
+	}
+	return true;
+}
+
+//
+// Hash
+//
+// FNV-1a over the folded units of a name.
+//
+UINT ZapNameIndex::Hash(LPCWSTR pszName, UINT cchName) {
+	UINT uHash = 2166136261u;
+	WCHAR vFolded[FOLD_CHUNK];
+	for (UINT i = 0; i < cchName; i += FOLD_CHUNK) {
+		UINT cch = cchName - i < FOLD_CHUNK ? cchName - i : FOLD_CHUNK;
+		Fold(pszName + i, cch, vFolded);
+		for (UINT j = 0; j < cch; ++j)
+			uHash = (uHash ^ vFolded[j]) * 16777619u;
+	}
+	return uHash;
+}
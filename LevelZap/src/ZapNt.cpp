@@ -0,0 +1,249 @@
+// ZapNt.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapNt.h"
+
+namespace {
+
+	const LONG	NT_STATUS_NO_MORE_FILES			= static_cast<LONG>(0x80000006L);
+	const LONG	NT_STATUS_NO_SUCH_FILE			= static_cast<LONG>(0xC000000FL);
+
+	const ULONG	NT_FILE_DIRECTORY_FILE			= 0x00000001;
+	const ULONG	NT_FILE_SYNCHRONOUS_IO_NONALERT	= 0x00000020;
+	const ULONG	NT_FILE_OPEN_FOR_BACKUP_INTENT	= 0x00004000;
+	const ULONG	NT_FILE_OPEN_REPARSE_POINT		= 0x00200000;
+	const ULONG	NT_OBJ_CASE_INSENSITIVE			= 0x00000040;
+
+	const ULONG	NT_FILE_DIRECTORY_INFORMATION	= 1;
+	const ULONG	NT_FILE_RENAME_INFORMATION		= 10;
+
+	struct NtUnicodeString
+	{
+		USHORT	Length;
+		USHORT	MaximumLength;
+		PWSTR	Buffer;
+	};
+
+	struct NtObjectAttributes
+	{
+		ULONG				Length;
+		HANDLE				RootDirectory;
+		NtUnicodeString*	ObjectName;
+		ULONG				Attributes;
+		PVOID				SecurityDescriptor;
+		PVOID				SecurityQualityOfService;
+	};
+
+	struct NtIoStatusBlock
+	{
+		union {
+			LONG	Status;
+			PVOID	Pointer;
+		};
+		ULONG_PTR	Information;
+	};
+
+	struct NtRenameInformation
+	{
+		BOOLEAN		ReplaceIfExists;
+		HANDLE		RootDirectory;
+		ULONG		FileNameLength;
+		WCHAR		FileName[1];
+	};
+
+	typedef LONG (WINAPI *NtOpenFileProc)(PHANDLE, ACCESS_MASK, NtObjectAttributes*,
+		NtIoStatusBlock*, ULONG, ULONG);
+	typedef LONG (WINAPI *NtQueryDirectoryFileProc)(HANDLE, HANDLE, PVOID, PVOID,
+		NtIoStatusBlock*, PVOID, ULONG, ULONG, BOOLEAN, NtUnicodeString*, BOOLEAN);
+	typedef LONG (WINAPI *NtSetInformationFileProc)(HANDLE, NtIoStatusBlock*, PVOID, ULONG, ULONG);
+	typedef ULONG (WINAPI *RtlNtStatusToDosErrorProc)(LONG);
+
+	NtOpenFileProc				s_pNtOpenFile = 0;
+	NtQueryDirectoryFileProc	s_pNtQueryDirectoryFile = 0;
+	NtSetInformationFileProc	s_pNtSetInformationFile = 0;
+	RtlNtStatusToDosErrorProc	s_pRtlNtStatusToDosError = 0;
+	volatile LONG				s_lBound = -1;	// -1 not bound yet, 0 unavailable, 1 bound.
+}
+
+//
+// Bind
+//
+// Looks up the ntdll entry points on first use. Concurrent callers all store
+// the same addresses, so no lock is needed.
+//
+// @return Entry points are available.
+//
+bool ZapNt::Bind() {
+	if (s_lBound >= 0)
+		return s_lBound != 0;
+	HMODULE hNtdll = ::GetModuleHandle(L"ntdll.dll");
+	if (hNtdll != 0) {
+		s_pNtOpenFile = reinterpret_cast<NtOpenFileProc>(::GetProcAddress(hNtdll, "NtOpenFile"));
+		s_pNtQueryDirectoryFile = reinterpret_cast<NtQueryDirectoryFileProc>(::GetProcAddress(hNtdll, "NtQueryDirectoryFile"));
+		s_pNtSetInformationFile = reinterpret_cast<NtSetInformationFileProc>(::GetProcAddress(hNtdll, "NtSetInformationFile"));
+		s_pRtlNtStatusToDosError = reinterpret_cast<RtlNtStatusToDosErrorProc>(::GetProcAddress(hNtdll, "RtlNtStatusToDosError"));
+	}
+	bool bBound = s_pNtOpenFile && s_pNtQueryDirectoryFile && s_pNtSetInformationFile && s_pRtlNtStatusToDosError;
+	::InterlockedExchange(&s_lBound, bBound ? 1 : 0);
+	return bBound;
+}
+
+//
+// Handle-relative calls can be used
+//
+bool ZapNt::IsAvailable() {
+	return Bind();
+}
+
+//
+// Convert an NTSTATUS to an HRESULT
+//
+HRESULT ZapNt::FromStatus(LONG lStatus) {
+	if (lStatus >= 0) return S_OK;
+	return HRESULT_FROM_WIN32(s_pRtlNtStatusToDosError(lStatus));
+}
+
+//
+// OpenDirectory
+//
+// Opens a directory by path, for listing and as the root of relative opens.
+//
+// @param szPath Directory path.
+// @param hDir Receives the handle.
+// @return Result code.
+//
+HRESULT ZapNt::OpenDirectory(const CString& szPath, HANDLE& hDir) {
+	hDir = ::CreateFile(szPath, FILE_LIST_DIRECTORY | FILE_TRAVERSE | SYNCHRONIZE,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0, OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS, 0);
+	if (hDir == INVALID_HANDLE_VALUE) {
+		hDir = 0;
+		return HRESULT_FROM_WIN32(::GetLastError());
+	}
+	return S_OK;
+}
+
+//
+// OpenDirectory
+//
+// Opens a subdirectory relative to an open directory.
+//
+// @param hParent Parent directory.
+// @param pszName Name of the subdirectory.
+// @param cchName Length of the name.
+// @param hDir Receives the handle.
+// @return Result code.
+//
+HRESULT ZapNt::OpenDirectory(HANDLE hParent, LPCWSTR pszName, UINT cchName, HANDLE& hDir) {
+	return Open(hParent, pszName, cchName, FILE_LIST_DIRECTORY | FILE_TRAVERSE | SYNCHRONIZE,
+		NT_FILE_DIRECTORY_FILE | NT_FILE_SYNCHRONOUS_IO_NONALERT | NT_FILE_OPEN_FOR_BACKUP_INTENT, hDir);
+}
+
+//
+// OpenForRename
+//
+// Opens an entry of an open directory so that it can be renamed. Links are
+// opened themselves, not their targets.
+//
+// @param hParent Parent directory.
+// @param pszName Name of the entry.
+// @param cchName Length of the name.
+// @param hFile Receives the handle.
+// @return Result code.
+//
+HRESULT ZapNt::OpenForRename(HANDLE hParent, LPCWSTR pszName, UINT cchName, HANDLE& hFile) {
+	return Open(hParent, pszName, cchName, DELETE | SYNCHRONIZE,
+		NT_FILE_SYNCHRONOUS_IO_NONALERT | NT_FILE_OPEN_FOR_BACKUP_INTENT | NT_FILE_OPEN_REPARSE_POINT, hFile);
+}
+
+//
+// Open
+//
+// Opens a name relative to a directory handle.
+//
+HRESULT ZapNt::Open(HANDLE hParent, LPCWSTR pszName, UINT cchName,
+					DWORD dwAccess, ULONG uOptions, HANDLE& hFile) {
+	hFile = 0;
+	if (!Bind()) return E_NOTIMPL;
+
+	NtUnicodeString name;
+	name.Length = name.MaximumLength = static_cast<USHORT>(cchName * sizeof(WCHAR));
+	name.Buffer = const_cast<PWSTR>(pszName);
+	NtObjectAttributes attributes = { sizeof(NtObjectAttributes), hParent, &name, NT_OBJ_CASE_INSENSITIVE, 0, 0 };
+	NtIoStatusBlock iosb = {};
+	LONG lStatus = s_pNtOpenFile(&hFile, dwAccess, &attributes, &iosb,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, uOptions);
+	if (lStatus < 0)
+		hFile = 0;
+	return FromStatus(lStatus);
+}
+
+//
+// Rename
+//
+// Moves an open entry into another directory, under a new name.
+//
+// @param hFile Entry, opened with OpenForRename.
+// @param hToDir Destination directory.
+// @param pszName New name.
+// @param cchName Length of the new name.
+// @param bReplace Replace an existing entry of that name.
+// @return Result code; ERROR_NOT_SAME_DEVICE if the directory is on another volume.
+//
+HRESULT ZapNt::Rename(HANDLE hFile, HANDLE hToDir, LPCWSTR pszName, UINT cchName, bool bReplace) {
+	if (!Bind()) return E_NOTIMPL;
+
+	ULONG cbInfo = static_cast<ULONG>(FIELD_OFFSET(NtRenameInformation, FileName) + cchName * sizeof(WCHAR));
+	ULONGLONG vBuffer[(sizeof(NtRenameInformation) + MAX_PATH * sizeof(WCHAR)) / sizeof(ULONGLONG) + 1];
+	if (cbInfo > sizeof(vBuffer)) return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+	NtRenameInformation* pInfo = reinterpret_cast<NtRenameInformation*>(vBuffer);
+	pInfo->ReplaceIfExists = bReplace ? TRUE : FALSE;
+	pInfo->RootDirectory = hToDir;
+	pInfo->FileNameLength = cchName * sizeof(WCHAR);
+	CopyMemory(pInfo->FileName, pszName, cchName * sizeof(WCHAR));
+
+	NtIoStatusBlock iosb = {};
+	return FromStatus(s_pNtSetInformationFile(hFile, &iosb, pInfo, cbInfo, NT_FILE_RENAME_INFORMATION));
+}
+
+//
+// QueryDirectory
+//
+// Reads the next batch of entries of an open directory, as a chain of
+// DirectoryEntry records.
+//
+// @param hDir Directory, opened with OpenDirectory.
+// @param pBuffer Receives the entries; must be 8-byte aligned.
+// @param cbBuffer Size of the buffer.
+// @param bRestart Start again from the first entry.
+// @return S_OK if entries were returned, S_FALSE when there are no more, or an error code.
+//
+HRESULT ZapNt::QueryDirectory(HANDLE hDir, void* pBuffer, ULONG cbBuffer, bool bRestart) {
+	if (!Bind()) return E_NOTIMPL;
+
+	NtIoStatusBlock iosb = {};
+	LONG lStatus = s_pNtQueryDirectoryFile(hDir, 0, 0, 0, &iosb, pBuffer, cbBuffer,
+		NT_FILE_DIRECTORY_INFORMATION, FALSE, 0, bRestart ? TRUE : FALSE);
+	if (lStatus == NT_STATUS_NO_MORE_FILES || lStatus == NT_STATUS_NO_SUCH_FILE)
+		return S_FALSE;
+	return FromStatus(lStatus);
+}
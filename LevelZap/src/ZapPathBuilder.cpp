@@ -0,0 +1,123 @@
+// ZapPathBuilder.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapPathBuilder.h"
+
+//
+// Constructor. The path starts empty.
+//
+ZapPathBuilder::ZapPathBuilder()
+	: m_vBuffer(MAX_PATH),
+	  m_cchLength(0)
+{
+	m_vBuffer[0] = L'\0';
+}
+
+//
+// Reset
+//
+// Starts a new path.
+//
+// @param pszRoot Root of the path; need not be terminated.
+// @param cchRoot Length of the root.
+//
+void ZapPathBuilder::Reset(LPCWSTR pszRoot, UINT cchRoot) {
+	CopyMemory(SetLength(cchRoot), pszRoot, cchRoot * sizeof(WCHAR));
+}
+
+//
+// Start a new path from a folder
+//
+void ZapPathBuilder::Reset(const CString& szRoot) {
+	Reset(szRoot.GetString(), szRoot.GetLength());
+}
+
+//
+// Push
+//
+// Appends a component, after a backslash.
+//
+// @param pszName Component; need not be terminated.
+// @param cchName Length of the component.
+// @return Length of the path before the component, to give to Pop().
+//
+UINT ZapPathBuilder::Push(LPCWSTR pszName, UINT cchName) {
+	UINT cchBefore = m_cchLength;
+	WCHAR* pEnd = SetLength(cchBefore + 1 + cchName) + cchBefore;
+	*pEnd++ = L'\\';
+	CopyMemory(pEnd, pszName, cchName * sizeof(WCHAR));
+	return cchBefore;
+}
+
+//
+// Pop
+//
+// Drops the components pushed since the path had a given length.
+//
+// @param cchLength Length returned by Push().
+//
+void ZapPathBuilder::Pop(UINT cchLength) {
+	m_cchLength = cchLength;
+	m_vBuffer[cchLength] = L'\0';
+}
+
+//
+// SetLength
+//
+// Sets the path length, for a caller that writes the characters itself.
+// Characters below the previous length are kept.
+//
+// @param cchLength New length, without terminator.
+// @return Start of the buffer; the terminator is already written.
+//
+WCHAR* ZapPathBuilder::SetLength(UINT cchLength) {
+	Reserve(cchLength);
+	m_cchLength = cchLength;
+	m_vBuffer[cchLength] = L'\0';
+	return &m_vBuffer[0];
+}
+
+//
+// Terminated path
+//
+LPCWSTR ZapPathBuilder::GetString() const {
+	return &m_vBuffer[0];
+}
+
+//
+// Path length, without terminator
+//
+UINT ZapPathBuilder::GetLength() const {
+	return m_cchLength;
+}
+
+//
+// Grow the buffer to hold a path and its terminator
+//
+void ZapPathBuilder::Reserve(UINT cchLength) {
+	if (cchLength < m_vBuffer.size())
+		return;
+	size_t cchSize = m_vBuffer.size() * 2;
+	if (cchSize <= cchLength)
+		cchSize = cchLength + 1;
+	m_vBuffer.resize(cchSize);
+}
@@ -0,0 +1,186 @@
+// ZapPruner.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapPruner.h"
+#include "ZapLog.h"
+#include "ZapPathBuilder.h"
+#include "ZapStats.h"
+#include "ZapWorkPool.h"
+
+//
+// Constructor.
+//
+// @param tree Scan of the zapped folder. Must outlive the pruner.
+//
+ZapPruner::ZapPruner(const ZapTree& tree)
+	: m_Tree(tree),
+	  m_vPending(),
+	  m_vBlocked(),
+	  m_vPaths(),
+	  m_lRemoved(0),
+	  m_lKept(0),
+	  m_pStats(0)
+{
+}
+
+//
+// Destructor.
+//
+ZapPruner::~ZapPruner()
+{
+	for (size_t i = 0; i < m_vPaths.size(); ++i)
+		delete m_vPaths[i];
+}
+
+//
+// ZapPruner::PruneTask
+//
+// Removes one directory without subdirectories, then each ancestor it was the
+// last subdirectory of.
+//
+class ZapPruner::PruneTask : public ZapTask
+{
+public:
+	PruneTask(ZapPruner& pruner, UINT uNode) : m_Pruner(pruner), m_uNode(uNode) {}
+
+	virtual void Run(ZapWorkPool&, UINT p_uWorker) { m_Pruner.Remove(p_uWorker, m_uNode); }
+
+private:
+	ZapPruner&	m_Pruner;	// Pruner counting the removals.
+	UINT		m_uNode;	// Directory to remove.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+	PruneTask&	operator=(const PruneTask&);
+};
+
+//
+// Count the removals of the next prune
+//
+// @param pStats Counters to add to, or 0.
+//
+void ZapPruner::SetStats(ZapStats* pStats) {
+	m_pStats = pStats;
+}
+
+//
+// Prune
+//
+// Removes every directory of the tree below its root, deepest first. The
+// root itself is left to the caller.
+//
+// @param uThreads Number of threads; 0 picks a default, 1 prunes on the calling thread.
+// @return S_OK if every directory was removed and the root holds nothing the
+//         filter excluded, otherwise ERROR_DIR_NOT_EMPTY.
+//
+HRESULT ZapPruner::Prune(UINT uThreads) {
+	m_vPending.assign(m_Tree.GetCount(), 0);
+	m_vBlocked.assign(m_Tree.GetCount(), 0);
+	m_lRemoved = 0;
+	m_lKept = 0;
+
+	// Children always come after their parent, however the scan attached them.
+	// What the filter excluded is still there, so its directory is kept.
+	// Directories that were not listed were moved as a whole by a zap of
+	// limited depth; they are gone.
+	std::vector<UINT> vLeaves;
+	for (UINT i = ZapTree::ROOT + 1; i < m_Tree.GetCount(); ++i) {
+		const ZapNode& node = m_Tree.GetNode(i);
+		if (node.bExcluded)
+			m_vBlocked[node.uParent] = 1;
+		else if (node.IsDirectory() && node.bScanned)
+			++m_vPending[node.uParent];
+	}
+	for (UINT i = ZapTree::ROOT + 1; i < m_Tree.GetCount(); ++i) {
+		const ZapNode& node = m_Tree.GetNode(i);
+		if (node.IsDirectory() && node.bScanned && m_vPending[i] == 0)
+			vLeaves.push_back(i);
+	}
+
+	if (uThreads == 0)
+		uThreads = ZapWorkPool::GetDefaultThreadCount();
+	if (uThreads < 2 || vLeaves.size() < PARALLEL_THRESHOLD)
+		uThreads = 1;
+	for (size_t i = m_vPaths.size(); i < uThreads; ++i)
+		m_vPaths.push_back(new ZapPathBuilder);
+
+	if (uThreads == 1) {
+		for (size_t i = 0; i < vLeaves.size(); ++i)
+			Remove(0, vLeaves[i]);
+	} else {
+		ZapWorkPool pool(uThreads);
+		for (size_t i = 0; i < vLeaves.size(); ++i)
+			pool.Submit(new PruneTask(*this, vLeaves[i]));
+		pool.Wait();
+	}
+
+	if (m_pStats != 0)
+		m_pStats->Add(ZapStats::PRUNED, m_lRemoved);
+	ZAP_LOG_INFO(L"Prune | %ld removed, %ld kept, %u threads | %s\n", m_lRemoved, m_lKept, uThreads, m_Tree.GetRoot());
+	return m_lKept == 0 && m_vBlocked[ZapTree::ROOT] == 0 ? S_OK : HRESULT_FROM_WIN32(ERROR_DIR_NOT_EMPTY);
+}
+
+//
+// Remove
+//
+// Removes one directory whose subdirectories are all done, then goes on with
+// its parent if this was the last one. A directory below a kept one is kept
+// without trying.
+//
+// @param uWorker Index of the worker, for its path buffer.
+// @param uNode Directory to remove.
+//
+void ZapPruner::Remove(UINT uWorker, UINT uNode) {
+	ZapPathBuilder& path = *m_vPaths[uWorker];
+	for (;;) {
+		bool bRemoved = false;
+		if (m_vBlocked[uNode] == 0) {
+			m_Tree.GetPath(uNode, path);
+			bRemoved = ::RemoveDirectory(path.GetString()) != FALSE;
+			if (!bRemoved)
+				ZAP_LOG_WARNING(L"KEPT 0x%08x: %s\n", HRESULT_FROM_WIN32(::GetLastError()), path.GetString());
+			if (m_pStats != 0)
+				m_pStats->Add(ZapStats::KERNEL_CALLS);
+		}
+		::InterlockedIncrement(bRemoved ? &m_lRemoved : &m_lKept);
+
+		UINT uParent = m_Tree.GetNode(uNode).uParent;
+		if (!bRemoved)
+			::InterlockedExchange(&m_vBlocked[uParent], 1);
+		if (uParent == ZapTree::ROOT || ::InterlockedDecrement(&m_vPending[uParent]) != 0)
+			return;
+		uNode = uParent;
+	}
+}
+
+//
+// Number of directories the last prune removed
+//
+size_t ZapPruner::GetRemovedCount() const {
+	return static_cast<size_t>(m_lRemoved);
+}
+
+//
+// Number of directories the last prune kept
+//
+size_t ZapPruner::GetKeptCount() const {
+	return static_cast<size_t>(m_lKept);
+}
@@ -0,0 +1,401 @@
+// ZapScheduler.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapScheduler.h"
+
+#include <Utilities.h>
+#include <ZapLog.h>
+#include <ZapWorkPool.h>
+
+#include <process.h>
+
+//
+// ZapScheduler::StepTask
+//
+// Runs one step of the scheduler on the work pool.
+//
+class ZapScheduler::StepTask : public ZapTask
+{
+public:
+	StepTask(ZapScheduler& scheduler, Step step, UINT uIndex)
+		: m_Scheduler(scheduler), m_Step(step), m_uIndex(uIndex) {}
+
+	virtual void Run(ZapWorkPool&, UINT)
+	{
+		(m_Scheduler.*m_Step)(m_uIndex);
+	}
+
+private:
+	ZapScheduler&	m_Scheduler;	// Scheduler the step belongs to.
+	Step			m_Step;			// Step to run.
+	UINT			m_uIndex;		// Folder, slot or group the step works on.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+	StepTask&		operator=(const StepTask&);
+};
+
+//
+// Constructor.
+//
+// @param engine Engine running the zaps; must outlive the scheduler.
+// @param uThreads Zaps run at once; 0 uses DEFAULT_THREADS.
+//
+ZapScheduler::ZapScheduler(const ZapEngine& engine, UINT uThreads)
+	: m_Engine(engine),
+	  m_uThreads(uThreads != 0 ? uThreads : DEFAULT_THREADS),
+	  m_hParentWnd(0),
+	  m_pStats(0),
+	  m_hThread(0),
+	  m_hRun(S_OK)
+{
+}
+
+//
+// Destructor.
+//
+ZapScheduler::~ZapScheduler()
+{
+	Wait();
+	for (size_t i = 0; i < m_vJobs.size(); ++i)
+		delete m_vJobs[i];
+	for (size_t i = 0; i < m_vTrees.size(); ++i)
+		delete m_vTrees[i];
+}
+
+//
+// Add a folder to zap
+//
+// @param szFolder Full path of the folder, without trailing separator.
+//
+void ZapScheduler::Add(const CString& szFolder) {
+	m_vFolders.push_back(szFolder);
+}
+
+//
+// Run
+//
+// Zaps every folder added. The plans are made first, all of them before
+// anything moves; then each group of overlapping folders is zapped in order,
+// the groups in parallel. The first folder of a group runs as planned; the
+// next ones are planned again once the folders before them are zapped.
+//
+// @param p_hParentWnd Handle of parent window for Shell progress and error UI.
+//                     If this is set to 0, we will not show any UI.
+// @param p_pStats Receives the counters and phase times of every zap; may be 0.
+// @return S_OK if every folder was zapped, otherwise the first failure;
+//         GetResult() has the result of each folder.
+//
+HRESULT ZapScheduler::Run(const HWND p_hParentWnd, ZapStats* p_pStats) {
+	m_hParentWnd = p_hParentWnd;
+	m_pStats = p_pStats;
+	size_t nFolders = m_vFolders.size();
+	m_vResults.assign(nFolders, S_OK);
+	m_vJobs.assign(nFolders, 0);
+	m_vUnion.resize(nFolders);
+	m_vLandings.assign(nFolders, std::vector<UINT>());
+	for (size_t i = 0; i < nFolders; ++i)
+		m_vUnion[i] = static_cast<UINT>(i);
+
+	// Nested folders: the content of a folder also ends up where the selected
+	// folders above it are zapped.
+	PathMap folders;
+	for (size_t i = 0; i < nFolders; ++i) {
+		UINT uFolder = static_cast<UINT>(i);
+		const PathMap::CPair* pSame = folders.Lookup(m_vFolders[i]);
+		if (pSame != 0)
+			Union(uFolder, pSame->m_value);
+		else
+			folders.SetAt(m_vFolders[i], uFolder);
+	}
+	for (size_t i = 0; i < nFolders; ++i) {
+		UINT uFolder = static_cast<UINT>(i);
+		CString szParent = Util::PathFindPreviousComponent(m_vFolders[i]);
+		m_vLandings[i].push_back(GetParentSlot(szParent));
+		for (CString szAbove = szParent; !szAbove.IsEmpty(); szAbove = Util::PathFindPreviousComponent(szAbove)) {
+			const PathMap::CPair* pAbove = folders.Lookup(szAbove);
+			if (pAbove != 0) {
+				Union(uFolder, pAbove->m_value);
+				m_vLandings[i].push_back(GetParentSlot(Util::PathFindPreviousComponent(szAbove)));
+			}
+		}
+	}
+
+	// Scan each parent once, then plan every folder against it.
+	{
+		ZapWorkPool pool(m_uThreads);
+		m_vTrees.assign(m_vParents.size(), 0);
+		m_vNames.assign(m_vParents.size(), ZapNameIndex());
+		RunSteps(pool, &ZapScheduler::ScanParent, m_vParents.size());
+		RunSteps(pool, &ZapScheduler::PlanFolder, nFolders);
+	}
+	for (size_t i = 0; i < m_vTrees.size(); ++i)
+		delete m_vTrees[i];
+	m_vTrees.clear();
+
+	// Siblings: folders moving equal names into the same parent overlap, and
+	// so does a folder moving an entry named like another folder zapped there.
+	for (size_t i = 0; i < nFolders; ++i) {
+		if (m_vJobs[i] == 0)
+			continue;
+		UINT uFolder = static_cast<UINT>(i);
+		const CString& szFolder = m_vFolders[i];
+		int iName = szFolder.ReverseFind(L'\\') + 1;
+		UINT uOther = m_vNames[m_vLandings[i][0]].Insert(szFolder.GetString() + iName,
+			szFolder.GetLength() - iName, uFolder);
+		if (uOther != ZapNameIndex::NONE)
+			Union(uFolder, uOther);
+		const ZapMovePlan& plan = m_vJobs[i]->GetPlan();
+		for (size_t j = 0; j < plan.GetCount(); ++j) {
+			const ZapMove& move = plan.GetMove(j);
+			for (size_t k = 0; k < m_vLandings[i].size(); ++k) {
+				uOther = m_vNames[m_vLandings[i][k]].Insert(move.pszName, move.cchName, uFolder);
+				if (uOther != ZapNameIndex::NONE)
+					Union(uFolder, uOther);
+			}
+		}
+	}
+
+	// Groups, in the order of their first folder; only that folder keeps its plan.
+	std::vector<UINT> vGroupOf(nFolders, UINT_MAX);
+	m_vGroups.clear();
+	for (size_t i = 0; i < nFolders; ++i) {
+		UINT uRoot = Find(static_cast<UINT>(i));
+		if (vGroupOf[uRoot] == UINT_MAX) {
+			vGroupOf[uRoot] = static_cast<UINT>(m_vGroups.size());
+			m_vGroups.push_back(std::vector<UINT>());
+		} else {
+			delete m_vJobs[i];
+			m_vJobs[i] = 0;
+		}
+		m_vGroups[vGroupOf[uRoot]].push_back(static_cast<UINT>(i));
+	}
+	ZAP_LOG_INFO(L"Scheduled %Iu folders in %Iu groups, %Iu parents\n", nFolders, m_vGroups.size(), m_vParents.size());
+	ZapLog::Flush();
+
+	{
+		ZapWorkPool pool(m_uThreads);
+		RunSteps(pool, &ZapScheduler::ZapGroup, m_vGroups.size());
+	}
+
+	for (size_t i = 0; i < nFolders; ++i)
+		if (FAILED(m_vResults[i]))
+			return m_vResults[i];
+	return S_OK;
+}
+
+//
+// Start
+//
+// Runs Run() on a background thread and returns at once. The counters of
+// the stats can be read while the zaps run; Wait() gives the result.
+//
+// @param p_hParentWnd Handle of parent window for Shell progress and error UI.
+//                     If this is set to 0, we will not show any UI.
+// @param p_pStats Receives the counters and phase times of every zap; may be 0.
+// @return Result code of starting the thread.
+//
+HRESULT ZapScheduler::Start(const HWND p_hParentWnd, ZapStats* p_pStats) {
+	if (m_hThread != 0)
+		return E_UNEXPECTED;
+	m_hParentWnd = p_hParentWnd;
+	m_pStats = p_pStats;
+	m_hRun = E_PENDING;
+	m_hThread = reinterpret_cast<HANDLE>(::_beginthreadex(0, 0, ThreadProc, this, 0, 0));
+	return m_hThread != 0 ? S_OK : HRESULT_FROM_WIN32(::GetLastError());
+}
+
+//
+// Wait
+//
+// Waits for the zaps started by Start().
+//
+// @param dwMilliseconds Longest wait; INFINITE waits until they are over.
+// @return Result of Run(); E_PENDING if the zaps are still running.
+//
+HRESULT ZapScheduler::Wait(DWORD dwMilliseconds) {
+	if (m_hThread == 0)
+		return m_hRun;
+	if (::WaitForSingleObject(m_hThread, dwMilliseconds) != WAIT_OBJECT_0)
+		return E_PENDING;
+	::CloseHandle(m_hThread);
+	m_hThread = 0;
+	return m_hRun;
+}
+
+//
+// Background thread entry point
+//
+unsigned __stdcall ZapScheduler::ThreadProc(void* pParam) {
+	ZapScheduler* pScheduler = static_cast<ZapScheduler*>(pParam);
+	pScheduler->m_hRun = pScheduler->Run(pScheduler->m_hParentWnd, pScheduler->m_pStats);
+	return 0;
+}
+
+//
+// Number of folders added
+//
+size_t ZapScheduler::GetCount() const {
+	return m_vFolders.size();
+}
+
+//
+// Folder added
+//
+// @param i Index of the folder, in the order it was added.
+//
+const CString& ZapScheduler::GetFolder(size_t i) const {
+	return m_vFolders[i];
+}
+
+//
+// Result of the zap of a folder
+//
+// @param i Index of the folder, in the order it was added.
+// @return Result code; S_FALSE if the content was moved but the folder was kept.
+//
+HRESULT ZapScheduler::GetResult(size_t i) const {
+	return m_vResults[i];
+}
+
+//
+// Number of groups of overlapping folders found by the last Run()
+//
+size_t ZapScheduler::GetGroupCount() const {
+	return m_vGroups.size();
+}
+
+//
+// Find
+//
+// Representative of the group of a folder, halving the path on the way.
+//
+UINT ZapScheduler::Find(UINT i) {
+	while (m_vUnion[i] != i) {
+		m_vUnion[i] = m_vUnion[m_vUnion[i]];
+		i = m_vUnion[i];
+	}
+	return i;
+}
+
+//
+// Union
+//
+// Merges the groups of two folders. The first folder added represents the
+// group, so that Find() on any folder gives the folder the group starts with.
+//
+void ZapScheduler::Union(UINT i, UINT j) {
+	i = Find(i);
+	j = Find(j);
+	if (i < j)
+		m_vUnion[j] = i;
+	else if (j < i)
+		m_vUnion[i] = j;
+}
+
+//
+// Slot of a parent folder, added if it is new
+//
+UINT ZapScheduler::GetParentSlot(const CString& szParent) {
+	const PathMap::CPair* pSlot = m_Slots.Lookup(szParent);
+	if (pSlot != 0)
+		return pSlot->m_value;
+	UINT uSlot = static_cast<UINT>(m_vParents.size());
+	m_Slots.SetAt(szParent, uSlot);
+	m_vParents.push_back(szParent);
+	return uSlot;
+}
+
+//
+// Run one step per index on the pool and wait for all of them
+//
+void ZapScheduler::RunSteps(ZapWorkPool& pool, Step step, size_t nSteps) {
+	for (size_t i = 0; i < nSteps; ++i)
+		pool.Submit(new StepTask(*this, step, static_cast<UINT>(i)));
+	pool.Wait();
+}
+
+//
+// ScanParent
+//
+// Scans a parent folder without recursion; a folder that cannot be scanned
+// is left for each plan to scan again.
+//
+void ZapScheduler::ScanParent(UINT uSlot) {
+	ZapTree* pTree = new ZapTree;
+	pTree->SetStats(m_pStats);
+	if (FAILED(pTree->Scan(m_vParents[uSlot], 1))) {
+		delete pTree;
+		pTree = 0;
+	}
+	m_vTrees[uSlot] = pTree;
+}
+
+//
+// PlanFolder
+//
+// Plans the zap of one folder, before any folder moves.
+//
+void ZapScheduler::PlanFolder(UINT i) {
+	ZapJob* pJob = new ZapJob;
+	HRESULT hRes = m_Engine.Plan(m_vFolders[i], m_vTrees[m_vLandings[i][0]], *pJob, m_pStats);
+	m_vResults[i] = hRes;
+	if (FAILED(hRes)) {
+		delete pJob;
+		pJob = 0;
+	}
+	m_vJobs[i] = pJob;
+}
+
+//
+// ZapGroup
+//
+// Zaps the folders of one group in order.
+//
+void ZapScheduler::ZapGroup(UINT uGroup) {
+	HRESULT hInit = ::CoInitializeEx(0, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+	const std::vector<UINT>& vGroup = m_vGroups[uGroup];
+	for (size_t k = 0; k < vGroup.size(); ++k) {
+		UINT i = vGroup[k];
+		ZapJob* pJob = m_vJobs[i];
+		if (k == 0 && pJob == 0)
+			continue;
+		if (m_Engine.IsCancelled()) {
+			delete pJob;
+			m_vJobs[i] = 0;
+			m_vResults[i] = HRESULT_FROM_WIN32(ERROR_CANCELLED);
+			continue;
+		}
+		HRESULT hRes = S_OK;
+		if (pJob == 0) {
+			pJob = new ZapJob;
+			hRes = m_Engine.Plan(m_vFolders[i], *pJob, m_pStats);
+		}
+		if (SUCCEEDED(hRes))
+			hRes = m_Engine.Execute(m_hParentWnd, *pJob, m_pStats);
+		delete pJob;
+		m_vJobs[i] = 0;
+		m_vResults[i] = hRes;
+		ZapLog::Flush();
+	}
+	if (SUCCEEDED(hInit))
+		::CoUninitialize();
+}
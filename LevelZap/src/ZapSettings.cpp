@@ -0,0 +1,297 @@
+// ZapSettings.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapSettings.h"
+
+namespace {
+
+	// Key holding the settings, under HKEY_CURRENT_USER.
+	const wchar_t SETTINGS_KEY[] = L"Software\\LevelZap";
+
+	// Milliseconds between two attempts to open a missing key.
+	const DWORD RETRY_INTERVAL = 1000;
+
+#ifndef REG_NOTIFY_THREAD_AGNOSTIC
+	// Windows 8 and later: the notification does not end with the calling thread.
+	const DWORD REG_NOTIFY_THREAD_AGNOSTIC = 0x10000000L;
+#endif
+}
+
+//
+// ZapSettings::Watcher
+//
+// Owns the published snapshot, the settings key and its change notification.
+// There is one per module.
+//
+class ZapSettings::Watcher
+{
+public:
+	Watcher();
+	~Watcher();
+
+	const ZapSettings&		Current();
+
+private:
+	void					Refresh();
+
+	ZapSettings* volatile	m_pCurrent;		// Published snapshot; never 0 once Current() returned.
+	CComAutoCriticalSection	m_cs;			// Serializes refreshes.
+	HKEY					m_hKey;			// Settings key, or 0 if it could not be opened yet.
+	volatile DWORD			m_dwTried;		// Tick count of the last attempt to open the key.
+	HANDLE					m_hChanged;		// Signaled when the key changes.
+	std::vector<ZapSettings*> m_vRetired;	// Replaced snapshots; readers may still use them.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+							Watcher(const Watcher&);
+	Watcher&				operator=(const Watcher&);
+};
+
+// Constructed with the module, before any thread can ask for a snapshot.
+ZapSettings::Watcher ZapSettings::s_Watcher;
+
+//
+// Constructor.
+//
+ZapSettings::Watcher::Watcher()
+	: m_pCurrent(0),
+	  m_cs(),
+	  m_hKey(0),
+	  m_dwTried(0),
+	  m_hChanged(::CreateEvent(0, FALSE, FALSE, 0)),
+	  m_vRetired()
+{
+}
+
+//
+// Destructor. Frees every snapshot.
+//
+ZapSettings::Watcher::~Watcher()
+{
+	delete m_pCurrent;
+	for (size_t i = 0; i < m_vRetired.size(); ++i)
+		delete m_vRetired[i];
+	if (m_hKey != 0)
+		::RegCloseKey(m_hKey);
+	if (m_hChanged != 0)
+		::CloseHandle(m_hChanged);
+}
+
+//
+// Current
+//
+// Returns the published snapshot. The key is read again only when it changed
+// since the last read; a missing key is looked for again at most once every
+// RETRY_INTERVAL.
+//
+const ZapSettings& ZapSettings::Watcher::Current() {
+	ZapSettings* pCurrent = m_pCurrent;
+	bool bRefresh = pCurrent == 0;
+	if (!bRefresh && m_hKey == 0)
+		bRefresh = ::GetTickCount() - m_dwTried >= RETRY_INTERVAL;
+	else if (!bRefresh)
+		bRefresh = ::WaitForSingleObject(m_hChanged, 0) == WAIT_OBJECT_0;
+	if (bRefresh) {
+		Refresh();
+		pCurrent = m_pCurrent;
+	}
+	return *pCurrent;
+}
+
+//
+// Refresh
+//
+// Reads the key into a new snapshot and publishes it, unless it holds the
+// same values as the published one. The notification is armed before
+// reading, so a change made during the read is not missed.
+//
+void ZapSettings::Watcher::Refresh() {
+	CComCritSecLock<CComAutoCriticalSection> lock(m_cs);
+	if (m_hKey == 0) {
+		m_dwTried = ::GetTickCount();
+		if (::RegOpenKeyEx(HKEY_CURRENT_USER, SETTINGS_KEY, 0, KEY_READ | KEY_NOTIFY, &m_hKey) != ERROR_SUCCESS)
+			m_hKey = 0;
+	}
+
+	ZapSettings* pSettings = new ZapSettings;
+	if (m_hKey != 0) {
+		DWORD dwFilter = REG_NOTIFY_CHANGE_LAST_SET;
+		OSVERSIONINFO osvi = { sizeof(OSVERSIONINFO) };
+		if (::GetVersionEx(&osvi) && (osvi.dwMajorVersion > 6 || (osvi.dwMajorVersion == 6 && osvi.dwMinorVersion >= 2)))
+			dwFilter |= REG_NOTIFY_THREAD_AGNOSTIC;
+		::RegNotifyChangeKeyValue(m_hKey, FALSE, dwFilter, m_hChanged, TRUE);
+		pSettings->Load(m_hKey);
+	}
+	if (m_pCurrent != 0 && m_pCurrent->Equals(*pSettings)) {
+		delete pSettings;
+		return;
+	}
+
+	ZapSettings* pOld = static_cast<ZapSettings*>(
+		::InterlockedExchangePointer(reinterpret_cast<PVOID volatile*>(&m_pCurrent), pSettings));
+	if (pOld != 0)
+		m_vRetired.push_back(pOld);
+}
+
+//
+// Current
+//
+// Latest snapshot of the settings.
+//
+// @return Snapshot; valid until the module unloads.
+//
+const ZapSettings& ZapSettings::Current() {
+	return s_Watcher.Current();
+}
+
+//
+// Constructor. The snapshot starts empty.
+//
+ZapSettings::ZapSettings()
+	: m_mValues()
+{
+}
+
+//
+// Load
+//
+// Reads every value of the key.
+//
+// @param hKey Open settings key.
+//
+void ZapSettings::Load(HKEY hKey) {
+	DWORD cchMaxName = 0, cbMaxData = 0;
+	if (::RegQueryInfoKey(hKey, 0, 0, 0, 0, 0, 0, 0, &cchMaxName, &cbMaxData, 0, 0) != ERROR_SUCCESS)
+		return;
+	std::vector<WCHAR> vName(cchMaxName + 1);
+	std::vector<BYTE> vData(cbMaxData + 2 * sizeof(WCHAR));
+
+	for (DWORD dwIndex = 0; ; ++dwIndex) {
+		DWORD cchName = static_cast<DWORD>(vName.size());
+		DWORD cbData = cbMaxData;
+		DWORD dwType = 0;
+		LONG lRes = ::RegEnumValue(hKey, dwIndex, &vName[0], &cchName, 0, &dwType, &vData[0], &cbData);
+		if (lRes == ERROR_NO_MORE_ITEMS)
+			break;
+		if (lRes != ERROR_SUCCESS)
+			continue;
+
+		Value value;
+		value.dwType = dwType;
+		value.dwValue = 0;
+		// Strings are not always terminated in the registry.
+		vData[cbData] = vData[cbData + 1] = 0;
+		vData[cbData + 2] = vData[cbData + 3] = 0;
+		LPCWSTR psz = reinterpret_cast<LPCWSTR>(&vData[0]);
+		switch (dwType) {
+		case REG_DWORD:
+			if (cbData < sizeof(DWORD)) continue;
+			value.dwValue = *reinterpret_cast<const DWORD*>(&vData[0]);
+			break;
+		case REG_SZ:
+		case REG_EXPAND_SZ:
+			value.szValue = psz;
+			break;
+		case REG_MULTI_SZ:
+			for (LPCWSTR pszEnd = psz + cbData / sizeof(WCHAR); psz < pszEnd && *psz; psz += wcslen(psz) + 1)
+				value.vValues.push_back(CString(psz));
+			break;
+		default:
+			continue;
+		}
+		m_mValues.SetAt(CString(&vName[0], cchName), value);
+	}
+}
+
+//
+// Equals
+//
+// @param other Snapshot to compare with.
+// @return Both snapshots hold the same values.
+//
+bool ZapSettings::Equals(const ZapSettings& other) const {
+	if (m_mValues.GetCount() != other.m_mValues.GetCount())
+		return false;
+	for (POSITION pos = m_mValues.GetStartPosition(); pos != 0; ) {
+		const ValueMap::CPair* pPair = m_mValues.GetNext(pos);
+		const ValueMap::CPair* pOther = other.m_mValues.Lookup(pPair->m_key);
+		if (pOther == 0)
+			return false;
+		const Value& value = pPair->m_value;
+		const Value& otherValue = pOther->m_value;
+		if (value.dwType != otherValue.dwType || value.dwValue != otherValue.dwValue
+			|| value.szValue != otherValue.szValue || value.vValues != otherValue.vValues)
+			return false;
+	}
+	return true;
+}
+
+//
+// Find a value of the given type
+//
+const ZapSettings::Value* ZapSettings::Find(LPCWSTR pszName, DWORD dwType) const {
+	const ValueMap::CPair* pPair = m_mValues.Lookup(pszName);
+	if (pPair == 0)
+		return 0;
+	if (pPair->m_value.dwType != dwType
+		&& !(dwType == REG_SZ && pPair->m_value.dwType == REG_EXPAND_SZ))
+		return 0;
+	return &pPair->m_value;
+}
+
+//
+// Read a DWORD setting
+//
+// @param pszName Value name.
+// @param dwDefault Returned when the value is missing or not a DWORD.
+// @return Value data.
+//
+DWORD ZapSettings::GetDWORD(LPCWSTR pszName, DWORD dwDefault) const {
+	const Value* pValue = Find(pszName, REG_DWORD);
+	return pValue != 0 ? pValue->dwValue : dwDefault;
+}
+
+//
+// Read a string setting
+//
+// @param pszName Value name.
+// @return Value data; empty when the value is missing.
+//
+CString ZapSettings::GetString(LPCWSTR pszName) const {
+	const Value* pValue = Find(pszName, REG_SZ);
+	return pValue != 0 ? pValue->szValue : CString();
+}
+
+//
+// Read a multi-string setting
+//
+// @param pszName Value name.
+// @param lStrings Receives the strings, appended.
+// @return The value exists.
+//
+bool ZapSettings::GetMultiString(LPCWSTR pszName, CAtlList<CString>& lStrings) const {
+	const Value* pValue = Find(pszName, REG_MULTI_SZ);
+	if (pValue == 0)
+		return false;
+	for (size_t i = 0; i < pValue->vValues.size(); ++i)
+		lStrings.AddTail(pValue->vValues[i]);
+	return true;
+}
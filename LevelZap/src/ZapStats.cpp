@@ -0,0 +1,208 @@
+// ZapStats.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapStats.h"
+
+namespace {
+
+	// JSON names of the counters, in ZapStats::Counter order.
+	const wchar_t* const COUNTER_NAMES[ZapStats::COUNTER_COUNT] = {
+		L"directories", L"entries", L"renames", L"copies", L"bytes", L"retries", L"failures", L"kernel_calls",
+		L"collisions", L"planned", L"pruned", L"excluded", L"hashed_bytes", L"deduped", L"dedup_bytes"
+	};
+
+	// JSON names of the phases, in ZapStats::Phase order.
+	const wchar_t* const PHASE_NAMES[ZapStats::PHASE_COUNT] = {
+		L"scan", L"collision", L"plan", L"move", L"cleanup", L"dedup"
+	};
+
+	//
+	// Ticks of QueryPerformanceCounter
+	//
+	LONGLONG GetTicks() {
+		LARGE_INTEGER li;
+		::QueryPerformanceCounter(&li);
+		return li.QuadPart;
+	}
+}
+
+//
+// Constructor.
+//
+// @param pStats Stats to charge the phases to, or 0 to do nothing.
+// @param bCount Count a new zap; false when the clock carries on with a zap
+//               another clock counted.
+//
+ZapStats::Clock::Clock(ZapStats* pStats, bool bCount)
+	: m_pStats(pStats),
+	  m_llWall(0),
+	  m_llCpu(0)
+{
+	if (m_pStats != 0) {
+		if (bCount)
+			::InterlockedIncrement(&m_pStats->m_lZaps);
+		m_llWall = GetTicks();
+		m_llCpu = GetCpuTime();
+	}
+}
+
+//
+// Charge the time since the previous call to a phase
+//
+// @param phase Phase that just ended.
+//
+void ZapStats::Clock::Next(Phase phase) {
+	if (m_pStats == 0)
+		return;
+	LONGLONG llWall = GetTicks();
+	LONGLONG llCpu = GetCpuTime();
+	::InterlockedExchangeAdd64(&m_pStats->m_vWall[phase], llWall - m_llWall);
+	::InterlockedExchangeAdd64(&m_pStats->m_vCpu[phase], llCpu - m_llCpu);
+	m_llWall = llWall;
+	m_llCpu = llCpu;
+}
+
+//
+// Constructor. Every counter starts at zero.
+//
+ZapStats::ZapStats()
+	: m_lZaps(0),
+	  m_llFrequency(0)
+{
+	for (int i = 0; i < COUNTER_COUNT; ++i)
+		m_vCounters[i] = 0;
+	for (int i = 0; i < PHASE_COUNT; ++i)
+		m_vWall[i] = m_vCpu[i] = 0;
+	LARGE_INTEGER li;
+	::QueryPerformanceFrequency(&li);
+	m_llFrequency = li.QuadPart;
+}
+
+//
+// Add to a counter; safe from any thread
+//
+void ZapStats::Add(Counter counter, LONGLONG llValue) {
+	::InterlockedExchangeAdd64(&m_vCounters[counter], llValue);
+}
+
+//
+// Value of a counter
+//
+LONGLONG ZapStats::Get(Counter counter) const {
+	return m_vCounters[counter];
+}
+
+//
+// Wall time spent in a phase, in microseconds
+//
+LONGLONG ZapStats::GetWallTime(Phase phase) const {
+	return m_vWall[phase] * 1000000 / m_llFrequency;
+}
+
+//
+// Process CPU time spent in a phase, in microseconds. Includes every thread
+// of the process, so the work pools are counted.
+//
+LONGLONG ZapStats::GetCpuTime(Phase phase) const {
+	return m_vCpu[phase] / 10;
+}
+
+//
+// Number of zaps that charged time to these stats
+//
+LONG ZapStats::GetZapCount() const {
+	return m_lZaps;
+}
+
+//
+// ToJson
+//
+// Formats the stats as one line of JSON, with the phase times in microseconds.
+//
+// @return JSON object.
+//
+CString ZapStats::ToJson() const {
+	CString szJson;
+	szJson.Format(L"{\"zaps\":%ld", GetZapCount());
+	for (int i = 0; i < COUNTER_COUNT; ++i)
+		szJson.AppendFormat(L",\"%s\":%I64d", COUNTER_NAMES[i], Get(static_cast<Counter>(i)));
+	szJson += L",\"phases\":{";
+	for (int i = 0; i < PHASE_COUNT; ++i) {
+		Phase phase = static_cast<Phase>(i);
+		szJson.AppendFormat(L"%s\"%s\":{\"wall_us\":%I64d,\"cpu_us\":%I64d}",
+			i ? L"," : L"", PHASE_NAMES[i], GetWallTime(phase), GetCpuTime(phase));
+	}
+	szJson += L"}}";
+	return szJson;
+}
+
+//
+// WriteReport
+//
+// Appends the stats to a report file as one line of JSON, prefixed with the
+// time of the report. Environment variables in the path are expanded.
+//
+// @param szPath Report file; created if needed.
+// @return Result code.
+//
+HRESULT ZapStats::WriteReport(const CString& szPath) const {
+	WCHAR szExpanded[MAX_PATH];
+	DWORD cch = ::ExpandEnvironmentStrings(szPath, szExpanded, MAX_PATH);
+	if (cch == 0 || cch > MAX_PATH)
+		return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+
+	SYSTEMTIME st;
+	::GetSystemTime(&st);
+	CString szLine;
+	szLine.Format(L"{\"time\":\"%04u-%02u-%02uT%02u:%02u:%02u.%03uZ\",\"pid\":%lu,",
+		st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds,
+		::GetCurrentProcessId());
+	szLine += ToJson().Mid(1);
+	szLine += L"\n";
+
+	// Names in the report are ASCII, so the line is written as is.
+	CStringA szUtf8(szLine);
+	HANDLE hFile = ::CreateFile(szExpanded, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, 0,
+		OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return HRESULT_FROM_WIN32(::GetLastError());
+	DWORD cbWritten = 0;
+	BOOL bWritten = ::WriteFile(hFile, szUtf8.GetString(), szUtf8.GetLength(), &cbWritten, 0);
+	DWORD dwError = ::GetLastError();
+	::CloseHandle(hFile);
+	return bWritten ? S_OK : HRESULT_FROM_WIN32(dwError);
+}
+
+//
+// CPU time of the process so far, user and kernel, in 100ns
+//
+LONGLONG ZapStats::GetCpuTime() {
+	FILETIME ftCreation, ftExit, ftKernel, ftUser;
+	if (!::GetProcessTimes(::GetCurrentProcess(), &ftCreation, &ftExit, &ftKernel, &ftUser))
+		return 0;
+	ULARGE_INTEGER uliKernel, uliUser;
+	uliKernel.LowPart = ftKernel.dwLowDateTime;
+	uliKernel.HighPart = ftKernel.dwHighDateTime;
+	uliUser.LowPart = ftUser.dwLowDateTime;
+	uliUser.HighPart = ftUser.dwHighDateTime;
+	return static_cast<LONGLONG>(uliKernel.QuadPart + uliUser.QuadPart);
+}
@@ -0,0 +1,169 @@
+// ZapStringPool.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapStringPool.h"
+
+//
+// Constructor.
+//
+ZapStringPool::ZapStringPool()
+	: m_vBlocks(),
+	  m_pNext(0),
+	  m_cchLeft(0),
+	  m_cchAllocated(0),
+	  m_vAtoms(),
+	  m_nAtoms(0)
+{
+}
+
+//
+// Destructor. Releases every block.
+//
+ZapStringPool::~ZapStringPool()
+{
+	Clear();
+}
+
+//
+// Release all strings
+//
+void ZapStringPool::Clear() {
+	for (size_t i = 0; i < m_vBlocks.size(); ++i)
+		delete [] m_vBlocks[i];
+	m_vBlocks.clear();
+	m_vAtoms.clear();
+	m_pNext = 0;
+	m_cchLeft = 0;
+	m_cchAllocated = 0;
+	m_nAtoms = 0;
+}
+
+//
+// Allocate room for a string and its terminator
+//
+// @param cch String length in characters.
+// @return Pointer to cch + 1 characters.
+//
+WCHAR* ZapStringPool::Allocate(UINT cch) {
+	size_t cchNeeded = cch + 1;
+	if (cchNeeded > BLOCK_CHARS / 4) {
+		// Long strings get their own block so the current one is not wasted.
+		WCHAR* pBlock = new WCHAR[cchNeeded];
+		m_vBlocks.push_back(pBlock);
+		m_cchAllocated += cchNeeded;
+		return pBlock;
+	}
+	if (cchNeeded > m_cchLeft) {
+		WCHAR* pBlock = new WCHAR[BLOCK_CHARS];
+		m_vBlocks.push_back(pBlock);
+		m_cchAllocated += BLOCK_CHARS;
+		m_pNext = pBlock;
+		m_cchLeft = BLOCK_CHARS;
+	}
+	WCHAR* p = m_pNext;
+	m_pNext += cchNeeded;
+	m_cchLeft -= cchNeeded;
+	return p;
+}
+
+//
+// Copy a string into the pool
+//
+// @param psz String, does not need to be null-terminated.
+// @param cch String length in characters.
+// @return Null-terminated copy owned by the pool.
+//
+LPCWSTR ZapStringPool::Store(LPCWSTR psz, UINT cch) {
+	WCHAR* p = Allocate(cch);
+	CopyMemory(p, psz, cch * sizeof(WCHAR));
+	p[cch] = L'\0';
+	return p;
+}
+
+//
+// Copy a string into the pool unless an identical string is already there
+//
+// @param psz String, does not need to be null-terminated.
+// @param cch String length in characters.
+// @return Null-terminated string owned by the pool.
+//
+LPCWSTR ZapStringPool::Intern(LPCWSTR psz, UINT cch) {
+	if ((m_nAtoms + 1) * 4 > m_vAtoms.size() * 3)
+		Grow();
+
+	UINT uHash = Hash(psz, cch);
+	size_t uMask = m_vAtoms.size() - 1;
+	for (size_t i = uHash & uMask; ; i = (i + 1) & uMask) {
+		Atom& atom = m_vAtoms[i];
+		if (atom.psz == 0) {
+			atom.psz = Store(psz, cch);
+			atom.cch = cch;
+			atom.uHash = uHash;
+			++m_nAtoms;
+			return atom.psz;
+		}
+		if (atom.uHash == uHash && atom.cch == cch && !wmemcmp(atom.psz, psz, cch))
+			return atom.psz;
+	}
+}
+
+//
+// Double the intern table
+//
+void ZapStringPool::Grow() {
+	std::vector<Atom> vOld;
+	vOld.swap(m_vAtoms);
+	Atom empty = { 0, 0, 0 };
+	m_vAtoms.assign(vOld.empty() ? 1024 : vOld.size() * 2, empty);
+
+	size_t uMask = m_vAtoms.size() - 1;
+	for (size_t j = 0; j < vOld.size(); ++j) {
+		if (vOld[j].psz == 0) continue;
+		size_t i = vOld[j].uHash & uMask;
+		while (m_vAtoms[i].psz != 0)
+			i = (i + 1) & uMask;
+		m_vAtoms[i] = vOld[j];
+	}
+}
+
+//
+// FNV-1a over the characters of a string
+//
+UINT ZapStringPool::Hash(LPCWSTR psz, UINT cch) {
+	UINT uHash = 2166136261u;
+	for (UINT i = 0; i < cch; ++i) {
+		uHash ^= psz[i];
+		uHash *= 16777619u;
+	}
+	return uHash;
+}
+
+//
+// Memory held by the pool
+//
+// @return Bytes allocated for strings and the intern table.
+//
+size_t ZapStringPool::GetFootprint() const {
+	return m_cchAllocated * sizeof(WCHAR)
+		+ m_vBlocks.capacity() * sizeof(WCHAR*)
+		+ m_vAtoms.capacity() * sizeof(Atom);
+}
@@ -0,0 +1,801 @@
+// ZapTree.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapTree.h"
+#include "Utilities.h"
+#include "ZapCancel.h"
+#include "ZapFilter.h"
+#include "ZapLog.h"
+#include "ZapNt.h"
+#include "ZapPathBuilder.h"
+#include "ZapStats.h"
+#include "ZapWorkPool.h"
+
+//
+// Constructor.
+//
+ZapTree::ZapTree()
+	: m_szRoot(),
+	  m_vNodes(),
+	  m_Pool(),
+	  m_csNodes(),
+	  m_uHandleBudget(DEFAULT_HANDLE_BUDGET),
+	  m_cbListBuffer(DEFAULT_LIST_BUFFER * 1024),
+	  m_lHandles(0),
+	  m_pStats(0),
+	  m_pCancel(0),
+	  m_pFilter(0),
+	  m_uDepth(1)
+{
+}
+
+//
+// ZapTree::Listing
+//
+// Entries of one directory, collected before they are attached to the tree.
+// Names are kept in one buffer until they are interned. The query buffer is
+// kept from directory to directory.
+//
+struct ZapTree::Listing
+{
+	std::vector<ZapNode>	vNodes;		// Entries; pszName is not set yet.
+	std::vector<UINT>		vOffsets;	// Offset of each name in vNames.
+	std::vector<WCHAR>		vNames;		// Null-terminated names.
+	std::vector<ULONGLONG>	vBuffer;	// Directory query buffer; Clear() keeps it.
+	UINT					uCalls;		// File system calls made to list the directory.
+
+	void					Clear() { vNodes.clear(); vOffsets.clear(); vNames.clear(); uCalls = 0; }
+	LPCWSTR					GetName(size_t i) const { return &vNames[vOffsets[i]]; }
+	void					Add(LPCWSTR pszName, UINT cchName, DWORD dwAttributes,
+								ULONGLONG ullSize, const FILETIME& ftWrite);
+	size_t					GetFolderCount() const;
+};
+
+//
+// Add an entry to a listing; "." and ".." are skipped.
+//
+void ZapTree::Listing::Add(LPCWSTR pszName, UINT cchName, DWORD dwAttributes,
+						   ULONGLONG ullSize, const FILETIME& ftWrite) {
+	if ((dwAttributes & FILE_ATTRIBUTE_DIRECTORY) && pszName[0] == L'.'
+		&& (cchName == 1 || (cchName == 2 && pszName[1] == L'.')))
+		return;
+
+	ZapNode child;
+	child.cchName = cchName;
+	child.pszName = 0;
+	child.dwAttributes = dwAttributes;
+	child.ullSize = ullSize;
+	child.ftWrite = ftWrite;
+	child.uParent = 0;
+	child.uFirstChild = 0;
+	child.uChildCount = 0;
+	child.bScanned = false;
+	child.bExcluded = false;
+	vNodes.push_back(child);
+	vOffsets.push_back(static_cast<UINT>(vNames.size()));
+	vNames.insert(vNames.end(), pszName, pszName + cchName);
+	vNames.push_back(L'\0');
+}
+
+//
+// Number of subdirectories in a listing, without the excluded ones
+//
+size_t ZapTree::Listing::GetFolderCount() const {
+	size_t nFolders = 0;
+	for (size_t i = 0; i < vNodes.size(); ++i)
+		if (vNodes[i].IsDirectory() && !vNodes[i].bExcluded)
+			++nFolders;
+	return nFolders;
+}
+
+//
+// ZapTree::DirHandle
+//
+// Open directory handle shared by the scans of its subdirectories, which open
+// themselves relative to it. The last one to be done with it closes it.
+//
+struct ZapTree::DirHandle
+{
+	ZapTree*		pTree;		// Tree counting the shared handles.
+	HANDLE			hDir;		// Directory handle.
+	volatile LONG	lRefs;		// Subdirectory scans that have not opened yet.
+
+	void			Release();
+};
+
+//
+// Drop one reference; the last one closes the handle.
+//
+void ZapTree::DirHandle::Release() {
+	if (::InterlockedDecrement(&lRefs) == 0) {
+		::CloseHandle(hDir);
+		::InterlockedDecrement(&pTree->m_lHandles);
+		delete this;
+	}
+}
+
+//
+// ZapTree::ScanTask
+//
+// Parallel scan of one directory. Attaches the directory's entries to the tree
+// and submits one task per subdirectory.
+//
+class ZapTree::ScanTask : public ZapTask
+{
+public:
+	ScanTask(ZapTree& tree, UINT uNode, UINT uLevel, const CString& szPath, UINT cchName, DirHandle* pParent)
+		: m_Tree(tree), m_uNode(uNode), m_uLevel(uLevel), m_szPath(szPath), m_cchName(cchName), m_pParent(pParent) {}
+
+	virtual void Run(ZapWorkPool& p_Pool, UINT p_uWorker)
+	{
+		Listing listing;
+		DirHandle* pDir = 0;
+		UINT uFirstChild;
+		if (FAILED(m_Tree.ScanFolder(m_uNode, m_uLevel, m_szPath, m_cchName, m_pParent, listing, pDir, uFirstChild)))
+			return;
+		m_Tree.SubmitFolders(p_Pool, p_uWorker, uFirstChild, m_uLevel, m_szPath, listing, pDir);
+	}
+
+private:
+	ZapTree&	m_Tree;		// Tree being built.
+	UINT		m_uNode;	// Directory node to scan.
+	UINT		m_uLevel;	// Depth of the directory below the root.
+	CString		m_szPath;	// Directory path.
+	UINT		m_cchName;	// Length of the directory name, at the end of m_szPath.
+	DirHandle*	m_pParent;	// Parent directory handle, or 0 to open by path.
+
+	// THESE METHODS ARE NOT IMPLEMENTED.
+	ScanTask&	operator=(const ScanTask&);
+};
+
+//
+// ZapTree::Folder
+//
+// Directory waiting to be scanned by a sequential scan.
+//
+struct ZapTree::Folder
+{
+	UINT		uNode;		// Directory node to scan.
+	UINT		uLevel;		// Depth of the directory below the root.
+	CString		szPath;		// Directory path.
+	UINT		cchName;	// Length of the directory name, at the end of szPath.
+	DirHandle*	pParent;	// Parent directory handle, or 0 to open by path.
+};
+
+//
+// Scan
+//
+// Walks the folder once and builds the tree model. A parallel scan attaches
+// directories in whatever order the workers finish them, but the children of
+// each directory keep their enumeration order, so walks of the tree (and the
+// move plan built from it) come out the same as with a sequential scan.
+//
+// Subdirectories are opened relative to their parent's handle while the
+// handle budget allows it, and by path otherwise.
+//
+// @param szRoot Folder to scan.
+// @param uDepth Levels the zap flattens: 1 scans the immediate children only, N also
+//               scans the subfolders down to N - 1 levels below the root, and
+//               ALL_LEVELS descends into every subfolder.
+// @param uThreads Number of threads for a recursive scan; 0 picks a default, 1 scans
+//                 on the calling thread.
+// @return S_OK if the folder itself could be enumerated, otherwise an error code.
+//
+HRESULT ZapTree::Scan(const CString& szRoot, UINT uDepth, UINT uThreads) {
+	m_szRoot = szRoot;
+	m_vNodes.clear();
+	m_Pool.Clear();
+	m_uDepth = uDepth;
+
+	// files are ignored
+	DWORD dwAttributes = GetFileAttributes(szRoot);
+	if (dwAttributes == INVALID_FILE_ATTRIBUTES || !(dwAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+		ZAP_LOG_WARNING(L"INVALID_HANDLE_VALUE: %s\n", szRoot);
+		return E_FAIL;
+	}
+
+	CString szName = Util::PathFindFolderName(szRoot);
+	ZapNode root;
+	root.cchName = szName.GetLength();
+	root.pszName = m_Pool.Store(szName, root.cchName);
+	root.dwAttributes = dwAttributes;
+	root.ullSize = 0;
+	root.ftWrite.dwLowDateTime = root.ftWrite.dwHighDateTime = 0;
+	root.uParent = ROOT;
+	root.uFirstChild = 0;
+	root.uChildCount = 0;
+	root.bScanned = false;
+	root.bExcluded = false;
+	m_vNodes.push_back(root);
+
+	// The folder itself is always listed here so that its failure is reported.
+	Listing listing;
+	DirHandle* pDir = 0;
+	UINT uFirstChild;
+	if (FAILED(ScanFolder(ROOT, 0, szRoot, 0, 0, listing, pDir, uFirstChild)))
+		return E_FAIL;
+	if (!IsFlattened(uDepth, 1))
+		return S_OK;
+
+	if (uThreads == 0)
+		uThreads = ZapWorkPool::GetDefaultThreadCount();
+	if (uThreads > 1) {
+		// One task per directory; the workers attach their entries as they go.
+		ZapWorkPool pool(uThreads);
+		SubmitFolders(pool, 0, uFirstChild, 0, szRoot, listing, pDir);
+		pool.Wait();
+		return S_OK;
+	}
+
+	// Breadth-first so that the children of each directory end up contiguous.
+	std::deque<Folder> qFolders;
+	QueueFolders(qFolders, uFirstChild, 0, szRoot, listing, pDir);
+	while (!qFolders.empty()) {
+		Folder folder = qFolders.front();
+		qFolders.pop_front();
+
+		if (FAILED(ScanFolder(folder.uNode, folder.uLevel, folder.szPath, folder.cchName, folder.pParent,
+							  listing, pDir, uFirstChild)))
+			continue;
+		QueueFolders(qFolders, uFirstChild, folder.uLevel, folder.szPath, listing, pDir);
+	}
+	return S_OK;
+}
+
+//
+// Limit the number of directory handles a scan keeps open
+//
+// @param uBudget Maximum number of shared directory handles; 0 restores the default.
+//
+void ZapTree::SetHandleBudget(UINT uBudget) {
+	m_uHandleBudget = uBudget ? uBudget : DEFAULT_HANDLE_BUDGET;
+}
+
+//
+// Limit the buffer a directory query reads into
+//
+// @param uSize Largest query buffer, in KB; 0 restores the default.
+//
+void ZapTree::SetListBuffer(UINT uSize) {
+	m_cbListBuffer = (uSize ? uSize : DEFAULT_LIST_BUFFER) * 1024;
+	if (m_cbListBuffer < LIST_BUFFER_SIZE)
+		m_cbListBuffer = LIST_BUFFER_SIZE;
+}
+
+//
+// Count the directories, entries and calls of the next scans
+//
+// @param pStats Counters to add to, or 0.
+//
+void ZapTree::SetStats(ZapStats* pStats) {
+	m_pStats = pStats;
+}
+
+//
+// Stop the next scans when a token is cancelled
+//
+// @param pCancel Token looked at before each directory is listed, or 0.
+//
+void ZapTree::SetCancel(const ZapCancel* pCancel) {
+	m_pCancel = pCancel;
+}
+
+//
+// Leave out of the next scans the entries a filter excludes
+//
+// @param pFilter Compiled rules, or 0 to scan everything.
+//
+void ZapTree::SetFilter(const ZapFilter* pFilter) {
+	m_pFilter = pFilter;
+}
+
+//
+// ScanFolder
+//
+// Opens, lists and attaches one directory. Safe to call from any worker.
+//
+// @param uNode Directory node.
+// @param uLevel Depth of the directory below the root.
+// @param szPath Path of the directory.
+// @param cchName Length of the directory name at the end of szPath; 0 for the root.
+// @param pParent Handle of the parent directory, or 0; one reference is released.
+// @param listing Receives the entries.
+// @param pDir Receives the handle to share with the subdirectories, or 0.
+// @param uFirstChild Receives the index of the first child.
+// @return Result code.
+//
+HRESULT ZapTree::ScanFolder(UINT uNode, UINT uLevel, const CString& szPath, UINT cchName, DirHandle* pParent,
+							Listing& listing, DirHandle*& pDir, UINT& uFirstChild) {
+	pDir = 0;
+	// A cancelled scan lists nothing more; the directories left are not scanned.
+	if (m_pCancel != 0 && m_pCancel->IsCancelled()) {
+		if (pParent != 0)
+			pParent->Release();
+		return HRESULT_FROM_WIN32(ERROR_CANCELLED);
+	}
+	HANDLE hDir = OpenFolder(pParent ? pParent->hDir : 0, szPath, cchName);
+	if (pParent != 0)
+		pParent->Release();
+
+	HRESULT hRes = ListFolder(szPath, hDir, m_cbListBuffer, listing);
+	if (m_pStats != 0) {
+		m_pStats->Add(ZapStats::KERNEL_CALLS, listing.uCalls + (hDir != 0 ? 1 : 0));
+		if (SUCCEEDED(hRes)) {
+			m_pStats->Add(ZapStats::DIRECTORIES);
+			m_pStats->Add(ZapStats::ENTRIES, static_cast<LONGLONG>(listing.vNodes.size()));
+		} else {
+			m_pStats->Add(ZapStats::FAILURES);
+		}
+	}
+	if (FAILED(hRes)) {
+		if (hDir != 0) ::CloseHandle(hDir);
+		return hRes;
+	}
+	if (m_pFilter != 0 && !m_pFilter->IsEmpty())
+		Exclude(uLevel, listing);
+	{
+		CComCritSecLock<CComAutoCriticalSection> lock(m_csNodes);
+		uFirstChild = Attach(uNode, listing);
+	}
+	// Subdirectories at the depth of the zap move as a whole and are not scanned.
+	pDir = ShareFolder(hDir, IsFlattened(m_uDepth, uLevel + 1) ? listing.GetFolderCount() : 0);
+	return S_OK;
+}
+
+//
+// OpenFolder
+//
+// Opens a directory for listing: relative to its parent when the parent is
+// open, by path otherwise.
+//
+// @param hParent Parent directory, or 0.
+// @param szPath Path of the directory.
+// @param cchName Length of the directory name at the end of szPath.
+// @return Directory handle, or 0 if handle-relative calls are not available.
+//
+HANDLE ZapTree::OpenFolder(HANDLE hParent, const CString& szPath, UINT cchName) {
+	if (!ZapNt::IsAvailable())
+		return 0;
+	HANDLE hDir = 0;
+	if (hParent != 0 && SUCCEEDED(ZapNt::OpenDirectory(hParent,
+			szPath.GetString() + szPath.GetLength() - cchName, cchName, hDir)))
+		return hDir;
+	if (SUCCEEDED(ZapNt::OpenDirectory(szPath, hDir)))
+		return hDir;
+	return 0;
+}
+
+//
+// ShareFolder
+//
+// Keeps a directory handle open for its subdirectories, if the handle budget
+// allows it. Otherwise the handle is closed and they open by path.
+//
+// @param hDir Directory handle, or 0.
+// @param nFolders Number of subdirectories.
+// @return Shared handle holding one reference per subdirectory, or 0.
+//
+ZapTree::DirHandle* ZapTree::ShareFolder(HANDLE hDir, size_t nFolders) {
+	if (hDir == 0)
+		return 0;
+	if (nFolders == 0 || static_cast<UINT>(::InterlockedIncrement(&m_lHandles)) > m_uHandleBudget) {
+		if (nFolders != 0)
+			::InterlockedDecrement(&m_lHandles);
+		::CloseHandle(hDir);
+		return 0;
+	}
+	DirHandle* pDir = new DirHandle;
+	pDir->pTree = this;
+	pDir->hDir = hDir;
+	pDir->lRefs = static_cast<LONG>(nFolders);
+	return pDir;
+}
+
+//
+// Drop the references a shared handle holds for subdirectories that will not be scanned
+//
+void ZapTree::ReleaseFolders(DirHandle* pDir, size_t nFolders) {
+	if (pDir == 0) return;
+	for (size_t i = 0; i < nFolders; ++i)
+		pDir->Release();
+}
+
+//
+// ListFolder
+//
+// Enumerates one directory. Does not touch the tree, so it can run on any thread.
+//
+// Entries are classified from the attributes the query returns; nothing is
+// opened or queried per entry. A query that fills the buffer doubles it for
+// the next one, up to cbMax.
+//
+// @param szPath Path of the directory.
+// @param hDir Open directory handle, or 0 to enumerate by path.
+// @param cbMax Largest query buffer, in bytes.
+// @param listing Receives the entries.
+// @return Result code.
+//
+HRESULT ZapTree::ListFolder(const CString& szPath, HANDLE hDir, ULONG cbMax, Listing& listing) {
+	listing.Clear();
+	if (hDir == 0)
+		return FindFolder(szPath, listing);
+
+	// Room left by a query stopped short for want of space: one entry with the longest name.
+	const ULONG cbSlack = sizeof(ZapNt::DirectoryEntry) + MAX_PATH * sizeof(WCHAR);
+	ULONG cbBuffer = LIST_BUFFER_SIZE;
+	for (bool bRestart = true; ; bRestart = false) {
+		if (listing.vBuffer.size() * sizeof(ULONGLONG) < cbBuffer)
+			listing.vBuffer.resize(cbBuffer / sizeof(ULONGLONG));
+		HRESULT hRes = ZapNt::QueryDirectory(hDir, &listing.vBuffer[0], cbBuffer, bRestart);
+		++listing.uCalls;
+		if (hRes == S_FALSE)
+			break;
+		if (FAILED(hRes)) {
+			ZAP_LOG_WARNING(L"QUERY_FAILED 0x%08x: %s\n", hRes, szPath);
+			return E_FAIL;
+		}
+		const BYTE* pStart = reinterpret_cast<const BYTE*>(&listing.vBuffer[0]);
+		const BYTE* p = pStart;
+		for (;;) {
+			const ZapNt::DirectoryEntry* pEntry = reinterpret_cast<const ZapNt::DirectoryEntry*>(p);
+			FILETIME ftWrite;
+			ftWrite.dwLowDateTime = pEntry->LastWriteTime.LowPart;
+			ftWrite.dwHighDateTime = static_cast<DWORD>(pEntry->LastWriteTime.HighPart);
+			listing.Add(pEntry->FileName, pEntry->FileNameLength / sizeof(WCHAR), pEntry->FileAttributes,
+				static_cast<ULONGLONG>(pEntry->EndOfFile.QuadPart), ftWrite);
+			if (pEntry->NextEntryOffset == 0) {
+				p = reinterpret_cast<const BYTE*>(pEntry->FileName) + pEntry->FileNameLength;
+				break;
+			}
+			p += pEntry->NextEntryOffset;
+		}
+		if (cbBuffer < cbMax && static_cast<ULONG>(p - pStart) + cbSlack > cbBuffer)
+			cbBuffer = cbBuffer * 2 < cbMax ? cbBuffer * 2 : cbMax;
+	}
+	return S_OK;
+}
+
+//
+// FindFolder
+//
+// Enumerates one directory by path, when it cannot be opened. From Windows 7
+// on, short names are not looked up and entries are fetched in large batches.
+// FindNextFile does not tell when it goes to the kernel for the next batch,
+// so only the FindFirstFileEx call is counted; these listings are not
+// measured in kernel calls.
+//
+// @param szPath Path of the directory.
+// @param listing Receives the entries.
+// @return Result code.
+//
+HRESULT ZapTree::FindFolder(const CString& szPath, Listing& listing) {
+	bool bBasic = Util::GetVersionEx2() >= 7;
+	WIN32_FIND_DATA ffd;
+	HANDLE hFind = FindFirstFileEx(szPath + L"\\*", bBasic ? FindExInfoBasic : FindExInfoStandard, &ffd,
+		FindExSearchNameMatch, 0, bBasic ? FIND_FIRST_EX_LARGE_FETCH : 0);
+	++listing.uCalls;
+	if (INVALID_HANDLE_VALUE == hFind) {
+		ZAP_LOG_WARNING(L"INVALID_HANDLE_VALUE: %s\n", szPath);
+		return E_FAIL;
+	}
+	do {
+		listing.Add(ffd.cFileName, static_cast<UINT>(wcslen(ffd.cFileName)), ffd.dwFileAttributes,
+			(static_cast<ULONGLONG>(ffd.nFileSizeHigh) << 32) | ffd.nFileSizeLow, ffd.ftLastWriteTime);
+	} while (FindNextFile(hFind, &ffd));
+	FindClose(hFind);
+	return S_OK;
+}
+
+//
+// Exclude
+//
+// Marks the entries of a listing the filter leaves out. Runs before the
+// listing is attached, so that excluded directories are never scanned.
+// Directories the zap flattens are matched as folders to descend into,
+// the others as entries to move.
+//
+// @param uLevel Depth of the listed directory below the root.
+// @param listing Entries of one directory.
+//
+void ZapTree::Exclude(UINT uLevel, Listing& listing) const {
+	bool bFlattened = IsFlattened(m_uDepth, uLevel + 1);
+	size_t nExcluded = 0;
+	for (size_t i = 0; i < listing.vNodes.size(); ++i) {
+		ZapNode& node = listing.vNodes[i];
+		node.bExcluded = m_pFilter->IsExcluded(listing.GetName(i), node.cchName,
+			!node.IsDirectory() || !bFlattened);
+		if (node.bExcluded)
+			++nExcluded;
+	}
+	if (m_pStats != 0 && nExcluded != 0)
+		m_pStats->Add(ZapStats::EXCLUDED, static_cast<LONGLONG>(nExcluded));
+}
+
+//
+// Attach
+//
+// Appends the entries of a directory to the tree as one contiguous block.
+// Callers scanning in parallel must hold m_csNodes.
+//
+// @param uNode Index of the directory node.
+// @param listing Entries of the directory.
+// @return Index of the first child.
+//
+UINT ZapTree::Attach(UINT uNode, const Listing& listing) {
+	UINT uFirstChild = static_cast<UINT>(m_vNodes.size());
+	for (size_t i = 0; i < listing.vNodes.size(); ++i) {
+		ZapNode child = listing.vNodes[i];
+		child.pszName = m_Pool.Intern(listing.GetName(i), child.cchName);
+		child.uParent = uNode;
+		m_vNodes.push_back(child);
+	}
+
+	ZapNode& node = m_vNodes[uNode];
+	node.uFirstChild = uFirstChild;
+	node.uChildCount = static_cast<UINT>(listing.vNodes.size());
+	node.bScanned = true;
+	return uFirstChild;
+}
+
+//
+// SubmitFolders
+//
+// Submits a scan task for every subdirectory of a listing the zap flattens.
+//
+// @param pool Pool running the scan.
+// @param uWorker Worker whose deque receives the tasks.
+// @param uFirstChild Index of the first child of the listed directory.
+// @param uLevel Depth of the listed directory below the root.
+// @param szPath Path of the listed directory.
+// @param listing Entries of the directory.
+// @param pDir Shared handle of the listed directory, or 0.
+//
+void ZapTree::SubmitFolders(ZapWorkPool& pool, UINT uWorker, UINT uFirstChild, UINT uLevel,
+							const CString& szPath, const Listing& listing, DirHandle* pDir) {
+	if (!IsFlattened(m_uDepth, uLevel + 1))
+		return;
+	// Pushed in reverse so the worker pops them in listing order.
+	for (size_t i = listing.vNodes.size(); i-- > 0; ) {
+		if (listing.vNodes[i].IsDirectory() && !listing.vNodes[i].bExcluded)
+			pool.Submit(new ScanTask(*this, uFirstChild + static_cast<UINT>(i), uLevel + 1,
+				szPath + L"\\" + listing.GetName(i), listing.vNodes[i].cchName, pDir), uWorker);
+	}
+}
+
+//
+// QueueFolders
+//
+// Queues every subdirectory of a listing the zap flattens for a sequential scan.
+//
+// @param qFolders Queue of the sequential scan.
+// @param uFirstChild Index of the first child of the listed directory.
+// @param uLevel Depth of the listed directory below the root.
+// @param szPath Path of the listed directory.
+// @param listing Entries of the directory.
+// @param pDir Shared handle of the listed directory, or 0.
+//
+void ZapTree::QueueFolders(std::deque<Folder>& qFolders, UINT uFirstChild, UINT uLevel,
+						   const CString& szPath, const Listing& listing, DirHandle* pDir) const {
+	if (!IsFlattened(m_uDepth, uLevel + 1))
+		return;
+	for (size_t i = 0; i < listing.vNodes.size(); ++i) {
+		if (listing.vNodes[i].IsDirectory() && !listing.vNodes[i].bExcluded) {
+			Folder folder;
+			folder.uNode = uFirstChild + static_cast<UINT>(i);
+			folder.uLevel = uLevel + 1;
+			folder.szPath = szPath + L"\\" + listing.GetName(i);
+			folder.cchName = listing.vNodes[i].cchName;
+			folder.pParent = pDir;
+			qFolders.push_back(folder);
+		}
+	}
+}
+
+//
+// Restore
+//
+// Rebuilds a tree scanned earlier, e.g. from a saved plan, without touching
+// the file system.
+//
+// @param szRoot Path of the folder.
+// @param vNodes Nodes of the tree; their names are copied into the pool.
+//
+void ZapTree::Restore(const CString& szRoot, const std::vector<ZapNode>& vNodes) {
+	m_szRoot = szRoot;
+	m_Pool.Clear();
+	m_vNodes = vNodes;
+	for (size_t i = 0; i < m_vNodes.size(); ++i)
+		m_vNodes[i].pszName = m_Pool.Store(m_vNodes[i].pszName, m_vNodes[i].cchName);
+}
+
+//
+// Folder the tree was scanned from
+//
+const CString& ZapTree::GetRoot() const {
+	return m_szRoot;
+}
+
+//
+// Move the tree to a new root, e.g. after the folder has been renamed.
+// Node paths are relative to the root so nothing else needs updating.
+//
+// @param szRoot New root path.
+//
+void ZapTree::SetRoot(const CString& szRoot) {
+	m_szRoot = szRoot;
+}
+
+//
+// Full path of a node
+//
+// @param uNode Node index.
+// @return Path of the node under the current root.
+//
+CString ZapTree::GetPath(UINT uNode) const {
+	if (uNode == ROOT) return m_szRoot;
+	UINT cch = GetPathLength(uNode);
+	CString szPath;
+	CopyPath(uNode, szPath.GetBufferSetLength(cch), cch);
+	szPath.ReleaseBufferSetLength(cch);
+	return szPath;
+}
+
+//
+// Full path of a node, into a reused buffer
+//
+// @param uNode Node index.
+// @param path Receives the path of the node under the current root.
+//
+void ZapTree::GetPath(UINT uNode, ZapPathBuilder& path) const {
+	UINT cch = GetPathLength(uNode);
+	CopyPath(uNode, path.SetLength(cch), cch);
+}
+
+//
+// Length of the full path of a node
+//
+// @param uNode Node index.
+// @return Path length in characters, without terminator.
+//
+UINT ZapTree::GetPathLength(UINT uNode) const {
+	UINT cch = m_szRoot.GetLength();
+	for (; uNode != ROOT; uNode = m_vNodes[uNode].uParent)
+		cch += 1 + m_vNodes[uNode].cchName;
+	return cch;
+}
+
+//
+// Write the full path of a node
+//
+// The path is assembled from the shared parent entries, so no per-entry path
+// is ever stored.
+//
+// @param uNode Node index.
+// @param pDst Destination buffer; no terminator is written.
+// @param cch Path length, as returned by GetPathLength.
+//
+void ZapTree::CopyPath(UINT uNode, WCHAR* pDst, UINT cch) const {
+	WCHAR* pEnd = pDst + cch;
+	for (; uNode != ROOT; uNode = m_vNodes[uNode].uParent) {
+		const ZapNode& node = m_vNodes[uNode];
+		pEnd -= node.cchName;
+		CopyMemory(pEnd, node.pszName, node.cchName * sizeof(WCHAR));
+		*--pEnd = L'\\';
+	}
+	CopyMemory(pDst, m_szRoot.GetString(), (pEnd - pDst) * sizeof(WCHAR));
+}
+
+//
+// Number of nodes, including the root
+//
+size_t ZapTree::GetCount() const {
+	return m_vNodes.size();
+}
+
+//
+// Node accessor
+//
+const ZapNode& ZapTree::GetNode(UINT uNode) const {
+	return m_vNodes[uNode];
+}
+
+//
+// Is directory empty
+//
+// A folder is empty when its tree holds no files, only (empty) subfolders.
+// Folders that could not be enumerated count as not empty.
+//
+// @return BOOL Folder is empty.
+//
+BOOL ZapTree::IsEmpty() const {
+	for (size_t i = 0; i < m_vNodes.size(); ++i) {
+		if (!m_vNodes[i].IsDirectory() || !m_vNodes[i].bScanned)
+			return false;
+	}
+	return !m_vNodes.empty();
+}
+
+//
+// Was every folder of the move list enumerated
+//
+// When this is true and the move list has been moved successfully, the folder is
+// known to hold nothing but what the filter excluded, without looking at it again.
+//
+// @param uDepth Levels the move list flattens.
+// @return BOOL Scan is complete.
+//
+BOOL ZapTree::IsComplete(UINT uDepth) const {
+	if (m_vNodes.empty() || !m_vNodes[ROOT].bScanned) return false;
+	if (!IsFlattened(uDepth, 1)) return true;
+	for (UINT i = 1; i < m_vNodes.size(); ++i) {
+		if (m_vNodes[i].IsDirectory() && !m_vNodes[i].bScanned && !m_vNodes[i].bExcluded
+			&& IsFlattened(uDepth, GetLevel(i)))
+			return false;
+	}
+	return true;
+}
+
+//
+// Depth of a node below the root
+//
+// @param uNode Node index.
+// @return 0 for the root, 1 for its children, and so on.
+//
+UINT ZapTree::GetLevel(UINT uNode) const {
+	UINT uLevel = 0;
+	for (; uNode != ROOT; uNode = m_vNodes[uNode].uParent)
+		++uLevel;
+	return uLevel;
+}
+
+//
+// Does a zap flatten the directories at some depth
+//
+// A flattened directory is dissolved: its entries are moved one by one, and
+// it is removed once empty. The others are moved as a whole.
+//
+// @param uDepth Levels the zap flattens; ALL_LEVELS for every level.
+// @param uLevel Depth of the directories below the root; the root is 0.
+// @return true if the zap flattens them.
+//
+bool ZapTree::IsFlattened(UINT uDepth, UINT uLevel) {
+	return uDepth == ALL_LEVELS || uLevel < uDepth;
+}
+
+//
+// String pool holding the entry names
+//
+// Other zap structures intern their names here so that identical names are
+// shared with the tree.
+//
+ZapStringPool& ZapTree::GetPool() const {
+	return m_Pool;
+}
+
+//
+// Memory held by the tree
+//
+// @return Bytes used by nodes and names.
+//
+size_t ZapTree::GetFootprint() const {
+	return m_vNodes.capacity() * sizeof(ZapNode) + m_Pool.GetFootprint();
+}
@@ -0,0 +1,193 @@
+// ZapWorkPool.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapWorkPool.h"
+
+#include <process.h>
+
+//
+// Constructor. Starts the worker threads.
+//
+// @param uThreads Number of workers; 0 uses GetDefaultThreadCount().
+//
+ZapWorkPool::ZapWorkPool(UINT uThreads)
+	: m_vWorkers(),
+	  m_hWork(::CreateSemaphore(0, 0, LONG_MAX, 0)),
+	  m_hIdle(::CreateEvent(0, FALSE, FALSE, 0)),
+	  m_lPending(0),
+	  m_lNext(0),
+	  m_lShutdown(0)
+{
+	if (uThreads == 0)
+		uThreads = GetDefaultThreadCount();
+	for (UINT i = 0; i < uThreads; ++i) {
+		Worker* pWorker = new Worker;
+		pWorker->pPool = this;
+		pWorker->uIndex = i;
+		pWorker->hThread = 0;
+		m_vWorkers.push_back(pWorker);
+	}
+	for (UINT i = 0; i < uThreads; ++i) {
+		m_vWorkers[i]->hThread = reinterpret_cast<HANDLE>(
+			::_beginthreadex(0, 0, ThreadProc, m_vWorkers[i], 0, 0));
+	}
+}
+
+//
+// Destructor. Waits for pending tasks, then stops the workers.
+//
+ZapWorkPool::~ZapWorkPool()
+{
+	Wait();
+	::InterlockedExchange(&m_lShutdown, 1);
+	::ReleaseSemaphore(m_hWork, static_cast<LONG>(m_vWorkers.size()), 0);
+	for (size_t i = 0; i < m_vWorkers.size(); ++i) {
+		if (m_vWorkers[i]->hThread != 0) {
+			::WaitForSingleObject(m_vWorkers[i]->hThread, INFINITE);
+			::CloseHandle(m_vWorkers[i]->hThread);
+		}
+		delete m_vWorkers[i];
+	}
+	::CloseHandle(m_hWork);
+	::CloseHandle(m_hIdle);
+}
+
+//
+// Default number of workers
+//
+// Directory enumeration mostly waits on the file system, so we run more
+// workers than there are processors to keep more requests outstanding.
+//
+// @return Worker count.
+//
+UINT ZapWorkPool::GetDefaultThreadCount() {
+	SYSTEM_INFO si;
+	::GetSystemInfo(&si);
+	UINT uThreads = si.dwNumberOfProcessors * 2;
+	return uThreads < 2 ? 2 : (uThreads > 32 ? 32 : uThreads);
+}
+
+//
+// Number of workers
+//
+UINT ZapWorkPool::GetThreadCount() const {
+	return static_cast<UINT>(m_vWorkers.size());
+}
+
+//
+// Submit a task from outside the pool
+//
+// @param pTask Task to run. The pool assumes ownership.
+//
+void ZapWorkPool::Submit(ZapTask* pTask) {
+	LONG lNext = ::InterlockedIncrement(&m_lNext);
+	Submit(pTask, static_cast<UINT>(lNext) % GetThreadCount());
+}
+
+//
+// Submit a task to a given worker
+//
+// @param pTask Task to run. The pool assumes ownership.
+// @param uWorker Worker whose deque receives the task; usually the worker
+//                running the task that submits it.
+//
+void ZapWorkPool::Submit(ZapTask* pTask, UINT uWorker) {
+	::InterlockedIncrement(&m_lPending);
+	Worker* pWorker = m_vWorkers[uWorker % GetThreadCount()];
+	{
+		CComCritSecLock<CComAutoCriticalSection> lock(pWorker->cs);
+		pWorker->dqTasks.push_back(pTask);
+	}
+	::ReleaseSemaphore(m_hWork, 1, 0);
+}
+
+//
+// Wait until every submitted task, and every task they submitted, has run
+//
+void ZapWorkPool::Wait() {
+	while (m_lPending != 0)
+		::WaitForSingleObject(m_hIdle, INFINITE);
+}
+
+//
+// Take the newest task of a worker
+//
+ZapTask* ZapWorkPool::Pop(UINT uIndex) {
+	Worker* pWorker = m_vWorkers[uIndex];
+	CComCritSecLock<CComAutoCriticalSection> lock(pWorker->cs);
+	if (pWorker->dqTasks.empty()) return 0;
+	ZapTask* pTask = pWorker->dqTasks.back();
+	pWorker->dqTasks.pop_back();
+	return pTask;
+}
+
+//
+// Take the oldest task of another worker
+//
+ZapTask* ZapWorkPool::Steal(UINT uIndex) {
+	UINT uCount = GetThreadCount();
+	for (UINT i = 1; i < uCount; ++i) {
+		Worker* pVictim = m_vWorkers[(uIndex + i) % uCount];
+		CComCritSecLock<CComAutoCriticalSection> lock(pVictim->cs);
+		if (!pVictim->dqTasks.empty()) {
+			ZapTask* pTask = pVictim->dqTasks.front();
+			pVictim->dqTasks.pop_front();
+			return pTask;
+		}
+	}
+	return 0;
+}
+
+//
+// Worker thread entry point
+//
+unsigned __stdcall ZapWorkPool::ThreadProc(void* pParam) {
+	Worker* pWorker = static_cast<Worker*>(pParam);
+	pWorker->pPool->WorkerLoop(pWorker->uIndex);
+	return 0;
+}
+
+//
+// WorkerLoop
+//
+// Runs tasks until the pool shuts down.
+//
+void ZapWorkPool::WorkerLoop(UINT uIndex) {
+	for (;;) {
+		ZapTask* pTask = Pop(uIndex);
+		if (pTask == 0)
+			pTask = Steal(uIndex);
+		if (pTask != 0) {
+			try {
+				pTask->Run(*this, uIndex);
+			} catch (...) {
+			}
+			delete pTask;
+			if (::InterlockedDecrement(&m_lPending) == 0)
+				::SetEvent(m_hIdle);
+			continue;
+		}
+		if (m_lShutdown != 0)
+			break;
+		::WaitForSingleObject(m_hWork, INFINITE);
+	}
+}
@@ -0,0 +1,96 @@
+// ZapBench.h
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <ZapEngine.h>
+#include <ZapFilter.h>
+
+class ZapPathBuilder;
+
+//
+// ZapBench
+//
+// Benchmark behind "levelzap bench". Generates a deterministic folder tree,
+// zaps it, and reports the time of each phase as JSON on standard output.
+//
+class ZapBench
+{
+public:
+	//
+	// Shape of the generated tree
+	//
+	struct Shape
+	{
+		UINT		uFanout;		// Subfolders in each folder.
+		UINT		uDepth;			// Levels of subfolders below the zapped folder.
+		UINT		uFiles;			// Files in each folder.
+		ULONGLONG	ullMinSize;		// Smallest file, in bytes.
+		ULONGLONG	ullMaxSize;		// Largest file, in bytes; sizes are log-uniform in between.
+		UINT		uCollide;		// Percentage of files named from a small shared pool.
+		UINT		uDupes;			// Percentage of those files holding the same bytes for the same name.
+		BOOL		bSelfName;		// Put an entry named like the zapped folder in it.
+		UINT		uSeed;			// Seed of the generator.
+	};
+
+						ZapBench();
+
+	static int			Run(int argc, wchar_t* argv[]);
+
+private:
+	//
+	// Counts of a generated tree
+	//
+	struct Counts
+	{
+		UINT		uFolders;		// Folders, without the zapped one.
+		UINT		uFiles;			// Files.
+		ULONGLONG	ullBytes;		// Bytes in the files.
+	};
+
+	bool				ParseArgs(int argc, wchar_t* argv[]);
+
+	HRESULT				Generate(const CString& szRoot, Counts& counts);
+	HRESULT				GenerateFolder(ZapPathBuilder& path, UINT uLevel, Counts& counts);
+	HRESULT				GenerateFile(const CString& szPath, ULONGLONG ullSize, DWORD dwOffset);
+	ULONGLONG			NextRandom();
+	ULONGLONG			NextSize();
+
+	HRESULT				RunOnce(const CString& szRunDir, BOOL bRecursive, UINT uRun);
+	void				PrintHeader() const;
+	double				TimeFilter(UINT& uExcluded) const;
+
+	static HRESULT		RemoveTree(const CString& szPath);
+	static CString		JsonString(const CString& sz);
+
+	Shape				m_Shape;		// Shape of the generated trees.
+	ZapOptions			m_Options;		// Settings of the zaps.
+	ZapFilter			m_Filter;		// Entries the zaps leave out.
+	CString				m_szDir;		// Folder the trees are generated in.
+	UINT				m_uRuns;		// Zaps per mode.
+	int					m_iMode;		// 0 non-recursive only, 1 recursive only, -1 both.
+	ULONGLONG			m_ullState;		// Generator state.
+	UINT				m_uNames;		// Unique names handed out so far.
+	std::vector<BYTE>	m_vData;		// Content written to the files.
+	std::vector<ULONGLONG> m_vDupes;	// Size of the identical files of each pooled name.
+	LONGLONG			m_llFrequency;	// QueryPerformanceCounter ticks per second.
+	bool				m_bFirst;		// No run reported yet.
+};
@@ -0,0 +1,637 @@
+// LevelZapCmd.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include <ZapCancel.h>
+#include <ZapEngine.h>
+#include <ZapFilter.h>
+#include <ZapLog.h>
+#include <ZapScheduler.h>
+#include <ZapSettings.h>
+#include <ZapWorkPool.h>
+#include "ZapBench.h"
+
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+
+namespace {
+
+	const wchar_t USAGE[] =
+		L"Usage: levelzap [options] [folder...]\n"
+		L"\n"
+		L"Moves the content of each folder one level up, then deletes the folder.\n"
+		L"Folders are read from standard input when none is given, or with '-'.\n"
+		L"\n"
+		L"  -r          Flatten subfolders too.\n"
+		L"  -l N        Flatten N levels at once: 2 also moves the content of the subfolders up,\n"
+		L"              and deeper folders move as a whole. Implies -r; 0 flattens every level.\n"
+		L"              Default with -r: the ZapDepth setting.\n"
+		L"  -j N        Zap N folders at once (default 1). Folders are taken 2N at a time; among\n"
+		L"              them, nested folders, repeated folders and folders moving the same names\n"
+		L"              into the same parent are zapped one after another, in order. A window\n"
+		L"              starts once the previous one is over. -n and -u run the folders as given.\n"
+		L"  -c POLICY   When a destination name is taken, decided before anything moves:\n"
+		L"              'fail' the entry, 'replace' it, 'rename' to \"name (2)\", 'prefix' with\n"
+		L"              the folders it comes from, keep the 'newer' or 'larger' file, 'skip'\n"
+		L"              the entry, or 'abort' the zap. Default: the CollisionPolicy setting.\n"
+		L"  -D          Leave colliding files that hold the same bytes as what keeps their name,\n"
+		L"              instead of moving them; files of equal size are hashed, then compared.\n"
+		L"              Default: the Dedup setting.\n"
+		L"  -n          Dry run: print the planned moves and what they are expected to cost.\n"
+		L"  -p FILE     Save the plan of the one folder given to FILE instead of zapping it.\n"
+		L"  -x FILE     Zap as planned in FILE by -p, without scanning again; with -n, print it.\n"
+		L"  -i GLOB     Only move the entries matching GLOB ('*' and '?' wildcards, any case);\n"
+		L"              subfolders are still flattened with -r. Adds to the Include setting.\n"
+		L"  -e GLOB     Leave the entries matching GLOB, and do not descend into such folders.\n"
+		L"              Adds to the Exclude setting. Both may be repeated.\n"
+		L"  -R MODE     Zaps interrupted by a crash are first 'resume'd or 'rollback'ed from\n"
+		L"              their journal. Default: the Recovery setting.\n"
+		L"  -u          Un-zap: undo the last zap whose content went into each folder given.\n"
+		L"  -0          Input folders are separated by NUL instead of newlines.\n"
+		L"  -P          Print progress counters to standard error every second.\n"
+		L"  -v          Log warnings to standard error; -vv adds progress, -vvv every entry (debug builds).\n"
+		L"  -h          Show this help.\n"
+		L"\n"
+		L"\n"
+		L"Ctrl+C cancels: folders not started are left alone, and the zaps running\n"
+		L"move back what they had moved. A second Ctrl+C ends the process at once.\n"
+		L"\n"
+		L"'levelzap bench -h' lists the options of the benchmark.\n";
+
+	// Cancelled by Ctrl+C.
+	ZapCancel g_Cancel;
+
+	//
+	// Console control handler: the first Ctrl+C or Ctrl+Break cancels the zaps
+	//
+	BOOL WINAPI OnConsoleCtrl(DWORD dwCtrlType) {
+		if ((dwCtrlType != CTRL_C_EVENT && dwCtrlType != CTRL_BREAK_EVENT) || g_Cancel.IsCancelled())
+			return FALSE;
+		g_Cancel.Cancel();
+		return TRUE;
+	}
+
+	//
+	// Batch
+	//
+	// State shared by the zaps of one run.
+	//
+	struct Batch
+	{
+		const ZapEngine*		pEngine;	// Engine running the zaps.
+		ZapStats				stats;		// Counters and phase times of every zap.
+		CComAutoCriticalSection	csOutput;	// Serializes console output.
+		HANDLE					hSlots;		// Semaphore bounding the folders in flight.
+		volatile LONG			lFailed;	// Folders that could not be zapped.
+		bool					bDryRun;	// Print the plans instead of zapping.
+		bool					bUnzap;		// Undo the last zap into each folder instead of zapping.
+	};
+
+	//
+	// Print the moves and forecast of a planned zap
+	//
+	void PrintJob(const ZapJob& job) {
+		const ZapMovePlan& plan = job.GetPlan();
+		for (size_t i = 0; i < plan.GetCount(); ++i) {
+			fwprintf(stdout, L"%s%s\t%s\t%s\n", job.IsCopy(i) ? L"copy" : L"rename",
+				plan.GetMove(i).bReplace ? L"+replace" : L"",
+				plan.GetFromPath(i).GetString(), plan.GetToPath(i).GetString());
+		}
+		ZapForecast forecast;
+		job.GetForecast(forecast);
+		fwprintf(stdout,
+			L"planned\t%s\t{\"moves\":%Iu,\"renames\":%Iu,\"copies\":%Iu,\"replaced\":%Iu,"
+			L"\"skipped\":%Iu,\"collisions\":%Iu,\"deduped\":%Iu,\"bytes\":%I64u,\"copy_bytes\":%I64u,"
+			L"\"dedup_bytes\":%I64u,\"rename_folder\":%s}\n",
+			job.GetFolder().GetString(), plan.GetCount(), forecast.nRenames, forecast.nCopies,
+			forecast.nReplaced, forecast.nSkipped, forecast.nCollisions, plan.GetDedupedCount(), forecast.ullBytes,
+			forecast.ullCopyBytes, plan.GetDedupedBytes(), job.NeedsRename() ? L"true" : L"false");
+	}
+
+	//
+	// Report the outcome of one zap
+	//
+	void Report(Batch& batch, const CString& szFolder, HRESULT hRes, LPCWSTR pszDone = L"zapped") {
+		CComCritSecLock<CComAutoCriticalSection> lock(batch.csOutput);
+		if (hRes == HRESULT_FROM_WIN32(ERROR_CANCELLED)) {
+			::InterlockedIncrement(&batch.lFailed);
+			fwprintf(stderr, L"cancelled\t%s\n", szFolder.GetString());
+		} else if (FAILED(hRes)) {
+			::InterlockedIncrement(&batch.lFailed);
+			fwprintf(stderr, L"failed\t0x%08x\t%s\n", hRes, szFolder.GetString());
+		} else {
+			fwprintf(stdout, L"%s\t%s\n", hRes == S_FALSE ? L"kept" : pszDone, szFolder.GetString());
+		}
+	}
+
+	//
+	// Zap one folder on the calling thread
+	//
+	void ZapOne(Batch& batch, const CString& szFolder) {
+		HRESULT hRes = ::CoInitializeEx(0, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+		bool bUninitialize = SUCCEEDED(hRes);
+		if (batch.bDryRun) {
+			ZapJob job;
+			HRESULT hPlan = batch.pEngine->Plan(szFolder, job, &batch.stats);
+			if (SUCCEEDED(hPlan)) {
+				CComCritSecLock<CComAutoCriticalSection> lock(batch.csOutput);
+				PrintJob(job);
+			} else {
+				Report(batch, szFolder, hPlan);
+			}
+		} else if (batch.bUnzap) {
+			Report(batch, szFolder, batch.pEngine->Unzap(szFolder), L"unzapped");
+		} else {
+			Report(batch, szFolder, batch.pEngine->Zap(0, szFolder, &batch.stats));
+		}
+		ZapLog::Flush();
+		if (bUninitialize)
+			::CoUninitialize();
+	}
+
+	//
+	// FolderTask
+	//
+	// Zaps one folder on the work pool and frees its slot.
+	//
+	class FolderTask : public ZapTask
+	{
+	public:
+		FolderTask(Batch& batch, const CString& szFolder)
+			: m_Batch(batch), m_szFolder(szFolder) {}
+
+		virtual void Run(ZapWorkPool&, UINT)
+		{
+			ZapOne(m_Batch, m_szFolder);
+			::ReleaseSemaphore(m_Batch.hSlots, 1, 0);
+		}
+
+	private:
+		Batch&		m_Batch;		// Run the zap belongs to.
+		CString		m_szFolder;		// Folder to zap.
+
+		// THESE METHODS ARE NOT IMPLEMENTED.
+		FolderTask&	operator=(const FolderTask&);
+	};
+
+	//
+	// ManifestReader
+	//
+	// Reads folder names from a stream, one at a time, in constant memory.
+	// Names are UTF-8, separated by newlines or by NUL characters.
+	//
+	class ManifestReader
+	{
+	public:
+		ManifestReader(HANDLE hInput, char chSeparator)
+			: m_hInput(hInput), m_chSeparator(chSeparator), m_vBuffer(CHUNK_SIZE),
+			  m_uStart(0), m_uEnd(0), m_bEof(false) {}
+
+		//
+		// Next folder name
+		//
+		// @param szFolder Receives the name.
+		// @return A name was read; false at the end of the input.
+		//
+		bool Next(CString& szFolder) {
+			for (;;) {
+				// Look for a separator in what has been read so far.
+				for (size_t i = m_uStart; i < m_uEnd; ++i) {
+					if (m_vBuffer[i] == m_chSeparator) {
+						bool bFound = Decode(m_uStart, i, szFolder);
+						m_uStart = i + 1;
+						if (bFound) return true;
+						i = m_uStart - 1;
+					}
+				}
+				if (m_bEof) {
+					bool bFound = Decode(m_uStart, m_uEnd, szFolder);
+					m_uStart = m_uEnd;
+					return bFound;
+				}
+				Fill();
+			}
+		}
+
+	private:
+		enum { CHUNK_SIZE = 64 * 1024 };
+
+		//
+		// Read more input after the pending partial name
+		//
+		void Fill() {
+			if (m_uStart > 0) {
+				std::copy(m_vBuffer.begin() + m_uStart, m_vBuffer.begin() + m_uEnd, m_vBuffer.begin());
+				m_uEnd -= m_uStart;
+				m_uStart = 0;
+			}
+			if (m_vBuffer.size() - m_uEnd < CHUNK_SIZE / 2)
+				m_vBuffer.resize(m_vBuffer.size() * 2);
+			DWORD cbRead = 0;
+			if (!::ReadFile(m_hInput, &m_vBuffer[m_uEnd], static_cast<DWORD>(m_vBuffer.size() - m_uEnd), &cbRead, 0)
+				|| cbRead == 0)
+				m_bEof = true;
+			m_uEnd += cbRead;
+		}
+
+		//
+		// Convert one name to UTF-16; empty names are skipped
+		//
+		bool Decode(size_t uBegin, size_t uEnd, CString& szFolder) const {
+			if (m_chSeparator == '\n' && uEnd > uBegin && m_vBuffer[uEnd - 1] == '\r')
+				--uEnd;
+			if (uEnd == uBegin)
+				return false;
+			int cch = ::MultiByteToWideChar(CP_UTF8, 0, &m_vBuffer[uBegin], static_cast<int>(uEnd - uBegin), 0, 0);
+			::MultiByteToWideChar(CP_UTF8, 0, &m_vBuffer[uBegin], static_cast<int>(uEnd - uBegin),
+				szFolder.GetBufferSetLength(cch), cch);
+			szFolder.ReleaseBufferSetLength(cch);
+			return true;
+		}
+
+		HANDLE				m_hInput;		// Stream to read.
+		char				m_chSeparator;	// Name separator.
+		std::vector<char>	m_vBuffer;		// Bytes read and not consumed yet.
+		size_t				m_uStart;		// First unconsumed byte.
+		size_t				m_uEnd;			// End of the bytes read.
+		bool				m_bEof;			// Nothing more to read.
+	};
+
+	//
+	// ProgressPrinter
+	//
+	// Prints the counters of a batch to standard error every second while it
+	// runs. The counters are read without locking them.
+	//
+	class ProgressPrinter
+	{
+	public:
+		ProgressPrinter(Batch& batch, bool bEnabled)
+			: m_Batch(batch), m_hStop(::CreateEvent(0, TRUE, FALSE, 0)), m_hThread(0) {
+			if (bEnabled)
+				m_hThread = reinterpret_cast<HANDLE>(::_beginthreadex(0, 0, ThreadProc, this, 0, 0));
+		}
+
+		~ProgressPrinter() {
+			::SetEvent(m_hStop);
+			if (m_hThread != 0) {
+				::WaitForSingleObject(m_hThread, INFINITE);
+				::CloseHandle(m_hThread);
+			}
+			::CloseHandle(m_hStop);
+		}
+
+	private:
+		enum { INTERVAL = 1000 };	// Milliseconds between two lines.
+
+		static unsigned __stdcall ThreadProc(void* pParam) {
+			ProgressPrinter* pPrinter = static_cast<ProgressPrinter*>(pParam);
+			while (::WaitForSingleObject(pPrinter->m_hStop, INTERVAL) == WAIT_TIMEOUT)
+				pPrinter->Print();
+			return 0;
+		}
+
+		void Print() {
+			const ZapStats& stats = m_Batch.stats;
+			CComCritSecLock<CComAutoCriticalSection> lock(m_Batch.csOutput);
+			fwprintf(stderr, L"progress\t{\"entries\":%I64d,\"planned\":%I64d,\"moved\":%I64d,\"bytes\":%I64d}\n",
+				stats.Get(ZapStats::ENTRIES), stats.Get(ZapStats::PLANNED),
+				stats.Get(ZapStats::RENAMES) + stats.Get(ZapStats::COPIES), stats.Get(ZapStats::BYTES));
+		}
+
+		Batch&		m_Batch;	// Batch whose counters are printed.
+		HANDLE		m_hStop;	// Set when the batch is over.
+		HANDLE		m_hThread;	// Printing thread, or 0 if disabled.
+
+		// THESE METHODS ARE NOT IMPLEMENTED.
+		ProgressPrinter(const ProgressPrinter&);
+		ProgressPrinter& operator=(const ProgressPrinter&);
+	};
+
+	//
+	// Full path of a folder argument, without trailing separator
+	//
+	CString GetFolderPath(const CString& szFolder) {
+		CString szPath;
+		DWORD cch = ::GetFullPathName(szFolder, 0, 0, 0);
+		if (cch == 0)
+			return szFolder;
+		cch = ::GetFullPathName(szFolder, cch, szPath.GetBufferSetLength(cch), 0);
+		szPath.ReleaseBufferSetLength(cch);
+		szPath.TrimRight(L"\\/");
+		return szPath;
+	}
+
+	//
+	// Dispatcher
+	//
+	// Runs the zaps of a batch, on the calling thread, or in windows of 2N
+	// folders through a scheduler that keeps overlapping zaps apart. Dry runs
+	// and un-zaps move nothing the others depend on; they go to a pool.
+	//
+	class Dispatcher
+	{
+	public:
+		Dispatcher(Batch& batch, UINT uJobs)
+			: m_Batch(batch), m_uJobs(uJobs),
+			  m_pPool(uJobs > 1 && (batch.bDryRun || batch.bUnzap) ? new ZapWorkPool(uJobs) : 0),
+			  m_vWindow() {}
+		~Dispatcher() { delete m_pPool; }
+
+		void Submit(const CString& szFolder) {
+			CString szPath = GetFolderPath(szFolder);
+			if (m_pPool != 0) {
+				// Wait for a free slot so that a long manifest is never queued in full.
+				::WaitForSingleObject(m_Batch.hSlots, INFINITE);
+				m_pPool->Submit(new FolderTask(m_Batch, szPath));
+			} else if (m_uJobs > 1) {
+				m_vWindow.push_back(szPath);
+				if (m_vWindow.size() >= 2 * m_uJobs)
+					RunWindow();
+			} else {
+				ZapOne(m_Batch, szPath);
+			}
+		}
+
+		void Wait() {
+			if (m_pPool != 0)
+				m_pPool->Wait();
+			RunWindow();
+		}
+
+	private:
+		//
+		// Zap the folders of the window, those that overlap one after another
+		//
+		void RunWindow() {
+			if (m_vWindow.empty())
+				return;
+			ZapScheduler scheduler(*m_Batch.pEngine, m_uJobs);
+			for (size_t i = 0; i < m_vWindow.size(); ++i)
+				scheduler.Add(m_vWindow[i]);
+			scheduler.Run(0, &m_Batch.stats);
+			for (size_t i = 0; i < scheduler.GetCount(); ++i)
+				Report(m_Batch, scheduler.GetFolder(i), scheduler.GetResult(i));
+			ZapLog::Flush();
+			m_vWindow.clear();
+		}
+
+		Batch&			m_Batch;	// Run the zaps belong to.
+		UINT			m_uJobs;	// Folders zapped at once.
+		ZapWorkPool*	m_pPool;	// Pool running the dry runs or un-zaps, or 0.
+		std::vector<CString> m_vWindow;	// Folders waiting for the scheduler.
+
+		// THESE METHODS ARE NOT IMPLEMENTED.
+		Dispatcher(const Dispatcher&);
+		Dispatcher&		operator=(const Dispatcher&);
+	};
+
+	//
+	// Append the counters of a run to the ReportPath file, if set
+	//
+	void WriteReport(const ZapStats& stats) {
+		CString szReport = ZapSettings::Current().GetString(L"ReportPath");
+		if (!szReport.IsEmpty() && stats.GetZapCount() != 0)
+			stats.WriteReport(szReport);
+	}
+
+	//
+	// Finish or roll back the zaps a crash interrupted, before anything else moves
+	//
+	void Recover(const ZapEngine& engine) {
+		HRESULT hRes = ::CoInitializeEx(0, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+		bool bUninitialize = SUCCEEDED(hRes);
+		hRes = engine.Recover(0);
+		ZapLog::Flush();
+		if (bUninitialize)
+			::CoUninitialize();
+		if (FAILED(hRes))
+			fwprintf(stderr, L"recovery failed\t0x%08x\n", hRes);
+	}
+
+	//
+	// SavePlan
+	//
+	// Plans the zap of one folder and saves it instead of zapping.
+	//
+	// @return Exit code.
+	//
+	int SavePlan(const ZapEngine& engine, const CString& szFolder, const CString& szPlan, bool bDryRun) {
+		ZapJob job;
+		HRESULT hRes = engine.Plan(GetFolderPath(szFolder), job);
+		if (SUCCEEDED(hRes))
+			hRes = job.Save(szPlan);
+		if (SUCCEEDED(hRes) && bDryRun)
+			PrintJob(job);
+		ZapLog::Flush();
+		if (FAILED(hRes)) {
+			fwprintf(stderr, L"failed\t0x%08x\t%s\n", hRes, szFolder.GetString());
+			return 1;
+		}
+		fwprintf(stdout, L"saved\t%s\t%s\n", job.GetFolder().GetString(), szPlan.GetString());
+		return 0;
+	}
+
+	//
+	// RunPlan
+	//
+	// Zaps a folder as planned in a saved plan, or prints the plan.
+	//
+	// @return Exit code.
+	//
+	int RunPlan(const ZapEngine& engine, const CString& szPlan, bool bDryRun) {
+		ZapJob job;
+		HRESULT hRes = job.Load(szPlan);
+		if (FAILED(hRes)) {
+			fwprintf(stderr, L"failed\t0x%08x\t%s\n", hRes, szPlan.GetString());
+			return 1;
+		}
+		if (bDryRun) {
+			PrintJob(job);
+			return 0;
+		}
+		hRes = ::CoInitializeEx(0, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+		bool bUninitialize = SUCCEEDED(hRes);
+		ZapStats stats;
+		hRes = engine.Execute(0, job, &stats);
+		ZapLog::Flush();
+		if (bUninitialize)
+			::CoUninitialize();
+		WriteReport(stats);
+		if (FAILED(hRes)) {
+			fwprintf(stderr, L"failed\t0x%08x\t%s\n", hRes, job.GetFolder().GetString());
+			return 1;
+		}
+		fwprintf(stdout, L"%s\t%s\n", hRes == S_FALSE ? L"kept" : L"zapped", job.GetFolder().GetString());
+		return 0;
+	}
+}
+
+//
+// Entry point.
+//
+// @return 0 if every folder was zapped, 1 if some failed, 2 on usage errors.
+//
+int wmain(int argc, wchar_t* argv[]) {
+	_setmode(_fileno(stdout), _O_U8TEXT);
+	_setmode(_fileno(stderr), _O_U8TEXT);
+	if (argc > 1 && CString(argv[1]) == L"bench")
+		return ZapBench::Run(argc - 1, argv + 1);
+
+	BOOL bRecursive = FALSE;
+	UINT uDepth = 0;
+	bool bDepth = false;
+	CString szPolicy;
+	CString szRecovery;
+	CString szSavePlan, szRunPlan;
+	bool bDryRun = false;
+	bool bDedup = false;
+	bool bUnzap = false;
+	bool bProgress = false;
+	UINT uJobs = 1;
+	char chSeparator = '\n';
+	bool bStdin = false;
+	int iLogLevel = ZAP_LOG_LEVEL_ERROR;
+	std::vector<CString> vFolders;
+	ZapFilter filter;
+	filter.Load();
+	for (int i = 1; i < argc; ++i) {
+		CString szArg(argv[i]);
+		if (szArg == L"-r") {
+			bRecursive = TRUE;
+		} else if (szArg == L"-l" && i + 1 < argc) {
+			uDepth = wcstoul(argv[++i], 0, 10);
+			bDepth = true;
+			bRecursive = TRUE;
+		} else if (szArg == L"-j" && i + 1 < argc) {
+			uJobs = wcstoul(argv[++i], 0, 10);
+			if (uJobs == 0) uJobs = ZapWorkPool::GetDefaultThreadCount();
+		} else if (szArg == L"-c" && i + 1 < argc) {
+			szPolicy = argv[++i];
+		} else if (szArg == L"-D") {
+			bDedup = true;
+		} else if (szArg == L"-i" && i + 1 < argc) {
+			filter.Add(argv[++i], false);
+		} else if (szArg == L"-e" && i + 1 < argc) {
+			filter.Add(argv[++i], true);
+		} else if (szArg == L"-R" && i + 1 < argc) {
+			szRecovery = argv[++i];
+		} else if (szArg == L"-v" || szArg == L"-vv" || szArg == L"-vvv") {
+			iLogLevel = ZAP_LOG_LEVEL_ERROR + szArg.GetLength() - 1;
+		} else if (szArg == L"-n") {
+			bDryRun = true;
+		} else if (szArg == L"-u") {
+			bUnzap = true;
+		} else if (szArg == L"-p" && i + 1 < argc) {
+			szSavePlan = argv[++i];
+		} else if (szArg == L"-x" && i + 1 < argc) {
+			szRunPlan = argv[++i];
+		} else if (szArg == L"-P") {
+			bProgress = true;
+		} else if (szArg == L"-0") {
+			chSeparator = '\0';
+		} else if (szArg == L"-") {
+			bStdin = true;
+		} else if (szArg == L"-h" || szArg == L"-?" || szArg == L"/?") {
+			fwprintf(stdout, L"%s", USAGE);
+			return 0;
+		} else if (szArg.GetLength() > 1 && szArg[0] == L'-') {
+			fwprintf(stderr, L"Unknown option: %s\n\n%s", szArg.GetString(), USAGE);
+			return 2;
+		} else {
+			vFolders.push_back(szArg);
+		}
+	}
+	if ((!szSavePlan.IsEmpty() && (vFolders.size() != 1 || bStdin || !szRunPlan.IsEmpty()))
+		|| (!szRunPlan.IsEmpty() && (!vFolders.empty() || bStdin))) {
+		fwprintf(stderr, L"-p takes exactly one folder, -x none.\n\n%s", USAGE);
+		return 2;
+	}
+	if (vFolders.empty())
+		bStdin = true;
+	ZapLog::Configure(iLogLevel, ZapLog::SINK_CONSOLE);
+
+	ZapOptions options;
+	ZapEngine::LoadOptions(options);
+	options.bRecursive = bRecursive;
+	if (bDepth)
+		options.uDepth = uDepth;
+	options.bNativeMove = TRUE;
+	if (bDedup)
+		options.bDedup = TRUE;
+	if (!szPolicy.IsEmpty() && !ZapEngine::SetCollisionPolicy(options, szPolicy)) {
+		fwprintf(stderr, L"Unknown collision policy: %s\n\n%s", szPolicy.GetString(), USAGE);
+		return 2;
+	}
+	if (szRecovery == L"resume" || szRecovery == L"rollback") {
+		options.bRollback = szRecovery == L"rollback";
+	} else if (!szRecovery.IsEmpty()) {
+		fwprintf(stderr, L"Unknown recovery mode: %s\n\n%s", szRecovery.GetString(), USAGE);
+		return 2;
+	}
+	if (uJobs > 1) {
+		// Folders already run in parallel; unless configured otherwise, each
+		// zap keeps to its own thread.
+		if (options.uScanThreads == 0) options.uScanThreads = 1;
+		if (options.uQueueDepth == 0) options.uQueueDepth = 1;
+	}
+	if (FAILED(filter.Compile())) {
+		fwprintf(stderr, L"Too many include and exclude rules.\n");
+		return 2;
+	}
+	ZapEngine engine(options);
+	engine.SetCancel(&g_Cancel);
+	engine.SetFilter(&filter);
+	::SetConsoleCtrlHandler(OnConsoleCtrl, TRUE);
+	if (!bDryRun && szSavePlan.IsEmpty())
+		Recover(engine);
+	if (!szSavePlan.IsEmpty())
+		return SavePlan(engine, vFolders[0], szSavePlan, bDryRun);
+	if (!szRunPlan.IsEmpty())
+		return RunPlan(engine, szRunPlan, bDryRun);
+
+	Batch batch;
+	batch.pEngine = &engine;
+	batch.hSlots = ::CreateSemaphore(0, uJobs * 2, uJobs * 2, 0);
+	batch.lFailed = 0;
+	batch.bDryRun = bDryRun;
+	batch.bUnzap = bUnzap;
+	{
+		ProgressPrinter progress(batch, bProgress);
+		Dispatcher dispatcher(batch, uJobs);
+		// Once cancelled, the folders not submitted yet are left alone.
+		for (size_t i = 0; i < vFolders.size() && !g_Cancel.IsCancelled(); ++i)
+			dispatcher.Submit(vFolders[i]);
+		if (bStdin) {
+			ManifestReader reader(::GetStdHandle(STD_INPUT_HANDLE), chSeparator);
+			CString szFolder;
+			while (!g_Cancel.IsCancelled() && reader.Next(szFolder))
+				dispatcher.Submit(szFolder);
+		}
+		dispatcher.Wait();
+	}
+	::CloseHandle(batch.hSlots);
+	ZapLog::Flush();
+	if (!bDryRun)
+		WriteReport(batch.stats);
+	return batch.lFailed != 0 ? 1 : 0;
+}
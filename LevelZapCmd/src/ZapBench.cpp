@@ -0,0 +1,509 @@
+// ZapBench.cpp
+// (c) 2026, LevelZap contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ZapBench.h"
+#include <ZapFilter.h>
+#include "ZapPathBuilder.h"
+
+namespace {
+
+	const wchar_t USAGE[] =
+		L"Usage: levelzap bench [options]\n"
+		L"\n"
+		L"Generates a folder tree, zaps it and prints the counters and phase times as JSON.\n"
+		L"\n"
+		L"  -d DIR          Folder to generate the trees in (default %TEMP%\\levelzap-bench).\n"
+		L"  -fanout N       Subfolders in each folder (default 4).\n"
+		L"  -depth N        Levels of subfolders (default 3).\n"
+		L"  -files N        Files in each folder (default 16).\n"
+		L"  -size MIN:MAX   File sizes in bytes, log-uniform (default 0:65536).\n"
+		L"  -collide PCT    Percentage of files with colliding names (default 0).\n"
+		L"  -dupes PCT      Percentage of those holding the same bytes as the others of their name (default 0).\n"
+		L"  -selfname       Put an entry named like the zapped folder in it.\n"
+		L"  -seed N         Seed of the generator (default 1).\n"
+		L"  -runs N         Zaps per mode (default 3).\n"
+		L"  -mode MODE      'flat', 'recursive' or 'both' (default).\n"
+		L"  -shell          Move with SHFileOperation instead of native renames.\n"
+		L"  -listbuffer KB  Largest directory query buffer (default: the setting).\n"
+		L"  -levels N       Levels a recursive zap flattens; 0 flattens all of them\n"
+		L"                  (default: the ZapDepth setting).\n"
+		L"  -i GLOB         Only move the entries matching GLOB, as for levelzap -i.\n"
+		L"  -e GLOB         Leave the entries matching GLOB, as for levelzap -e.\n"
+		L"  -c POLICY       Collision policy, as for levelzap -c (default: the setting).\n"
+		L"  -dedup          Leave colliding files identical to what keeps their name, as for levelzap -D.\n";
+
+	// Name of the zapped folder; -selfname puts an entry with this name in it.
+	const wchar_t ZAPPED_NAME[] = L"zap";
+
+	// Number of names colliding files are picked from.
+	const UINT COLLIDE_POOL = 32;
+
+	// Size of the buffer the file content is written from.
+	const DWORD DATA_SIZE = 64 * 1024;
+
+	// Offset given to GenerateFile() to start at a random place in the buffer.
+	const DWORD RANDOM_OFFSET = DATA_SIZE;
+
+	// Names the filter is timed on.
+	const UINT MATCH_NAMES = 1000000;
+
+	//
+	// Ticks of QueryPerformanceCounter
+	//
+	LONGLONG GetTicks() {
+		LARGE_INTEGER li;
+		::QueryPerformanceCounter(&li);
+		return li.QuadPart;
+	}
+}
+
+//
+// Constructor. Sets the default shape and options.
+//
+ZapBench::ZapBench()
+	: m_Filter(),
+	  m_szDir(),
+	  m_uRuns(3),
+	  m_iMode(-1),
+	  m_ullState(0),
+	  m_uNames(0),
+	  m_vData(DATA_SIZE),
+	  m_vDupes(),
+	  m_llFrequency(0),
+	  m_bFirst(true)
+{
+	m_Shape.uFanout = 4;
+	m_Shape.uDepth = 3;
+	m_Shape.uFiles = 16;
+	m_Shape.ullMinSize = 0;
+	m_Shape.ullMaxSize = 64 * 1024;
+	m_Shape.uCollide = 0;
+	m_Shape.uDupes = 0;
+	m_Shape.bSelfName = FALSE;
+	m_Shape.uSeed = 1;
+
+	ZapEngine::LoadOptions(m_Options);
+	m_Options.bNativeMove = TRUE;
+	m_Filter.Load();
+
+	LARGE_INTEGER li;
+	::QueryPerformanceFrequency(&li);
+	m_llFrequency = li.QuadPart;
+
+	WCHAR szTemp[MAX_PATH];
+	DWORD cch = ::GetTempPath(MAX_PATH, szTemp);
+	m_szDir.SetString(szTemp, cch < MAX_PATH ? cch : 0);
+	m_szDir.TrimRight(L'\\');
+	m_szDir += L"\\levelzap-bench";
+}
+
+//
+// Run
+//
+// Entry point of "levelzap bench".
+//
+// @param argc Argument count, "bench" included.
+// @param argv Arguments, starting with "bench".
+// @return 0 if every zap succeeded, 1 if some failed, 2 on usage errors.
+//
+int ZapBench::Run(int argc, wchar_t* argv[]) {
+	ZapBench bench;
+	if (!bench.ParseArgs(argc, argv))
+		return 2;
+	if (FAILED(bench.m_Filter.Compile())) {
+		fwprintf(stderr, L"Too many include and exclude rules.\n");
+		return 2;
+	}
+
+	::CreateDirectory(bench.m_szDir, 0);
+	bench.PrintHeader();
+	int iResult = 0;
+	for (int iRecursive = 0; iRecursive < 2; ++iRecursive) {
+		if (bench.m_iMode >= 0 && bench.m_iMode != iRecursive)
+			continue;
+		for (UINT uRun = 0; uRun < bench.m_uRuns; ++uRun) {
+			CString szRunDir;
+			szRunDir.Format(L"%s\\run-%u", bench.m_szDir.GetString(), uRun);
+			if (FAILED(bench.RunOnce(szRunDir, iRecursive, uRun)))
+				iResult = 1;
+		}
+	}
+	fwprintf(stdout, L"\n\t]\n}\n");
+	::RemoveDirectory(bench.m_szDir);
+	return iResult;
+}
+
+//
+// Parse the arguments following "bench"
+//
+// @return Arguments are valid; false after printing the usage.
+//
+bool ZapBench::ParseArgs(int argc, wchar_t* argv[]) {
+	for (int i = 1; i < argc; ++i) {
+		CString szArg(argv[i]);
+		const wchar_t* pszValue = i + 1 < argc ? argv[i + 1] : 0;
+		if (szArg == L"-selfname") {
+			m_Shape.bSelfName = TRUE;
+		} else if (szArg == L"-shell") {
+			m_Options.bNativeMove = FALSE;
+		} else if (szArg == L"-dedup") {
+			m_Options.bDedup = TRUE;
+		} else if (pszValue == 0) {
+			fwprintf(stderr, L"%s", USAGE);
+			return false;
+		} else if (szArg == L"-d") {
+			m_szDir = pszValue;
+			m_szDir.TrimRight(L"\\/");
+			++i;
+		} else if (szArg == L"-fanout") {
+			m_Shape.uFanout = wcstoul(argv[++i], 0, 10);
+		} else if (szArg == L"-depth") {
+			m_Shape.uDepth = wcstoul(argv[++i], 0, 10);
+		} else if (szArg == L"-files") {
+			m_Shape.uFiles = wcstoul(argv[++i], 0, 10);
+		} else if (szArg == L"-size") {
+			wchar_t* pszEnd = 0;
+			m_Shape.ullMinSize = _wcstoui64(argv[++i], &pszEnd, 10);
+			m_Shape.ullMaxSize = *pszEnd == L':' ? _wcstoui64(pszEnd + 1, 0, 10) : m_Shape.ullMinSize;
+			if (m_Shape.ullMaxSize < m_Shape.ullMinSize)
+				std::swap(m_Shape.ullMinSize, m_Shape.ullMaxSize);
+		} else if (szArg == L"-collide") {
+			m_Shape.uCollide = wcstoul(argv[++i], 0, 10);
+			if (m_Shape.uCollide > 100) m_Shape.uCollide = 100;
+		} else if (szArg == L"-dupes") {
+			m_Shape.uDupes = wcstoul(argv[++i], 0, 10);
+			if (m_Shape.uDupes > 100) m_Shape.uDupes = 100;
+		} else if (szArg == L"-seed") {
+			m_Shape.uSeed = wcstoul(argv[++i], 0, 10);
+		} else if (szArg == L"-runs") {
+			m_uRuns = wcstoul(argv[++i], 0, 10);
+		} else if (szArg == L"-mode") {
+			CString szMode(argv[++i]);
+			m_iMode = szMode == L"flat" ? 0 : szMode == L"recursive" ? 1 : -1;
+		} else if (szArg == L"-listbuffer") {
+			m_Options.uListBuffer = wcstoul(argv[++i], 0, 10);
+		} else if (szArg == L"-levels") {
+			m_Options.uDepth = wcstoul(argv[++i], 0, 10);
+		} else if (szArg == L"-i") {
+			m_Filter.Add(argv[++i], false);
+		} else if (szArg == L"-e") {
+			m_Filter.Add(argv[++i], true);
+		} else if (szArg == L"-c") {
+			CString szPolicy(argv[++i]);
+			if (!ZapEngine::SetCollisionPolicy(m_Options, szPolicy)) {
+				fwprintf(stderr, L"Unknown collision policy: %s\n\n%s", szPolicy.GetString(), USAGE);
+				return false;
+			}
+		} else {
+			fwprintf(stderr, L"Unknown option: %s\n\n%s", szArg.GetString(), USAGE);
+			return false;
+		}
+	}
+	return true;
+}
+
+//
+// RunOnce
+//
+// Generates a tree, zaps it, prints the result and removes what is left.
+//
+// @param szRunDir Folder to generate the tree in.
+// @param bRecursive Zap recursively.
+// @param uRun Index of the run within its mode.
+// @return Result of the generation or of the zap.
+//
+HRESULT ZapBench::RunOnce(const CString& szRunDir, BOOL bRecursive, UINT uRun) {
+	RemoveTree(szRunDir);
+	::CreateDirectory(szRunDir, 0);
+	CString szRoot = szRunDir + L"\\" + ZAPPED_NAME;
+
+	Counts counts = { 0, 0, 0 };
+	LONGLONG llStart = GetTicks();
+	HRESULT hRes = Generate(szRoot, counts);
+	LONGLONG llGenerate = GetTicks() - llStart;
+
+	ZapStats stats;
+	if (SUCCEEDED(hRes)) {
+		ZapOptions options(m_Options);
+		options.bRecursive = bRecursive;
+		ZapEngine engine(options);
+		engine.SetFilter(&m_Filter);
+		hRes = engine.Zap(0, szRoot, &stats);
+	}
+
+	LONGLONG llTotal = 0;
+	for (int i = 0; i < ZapStats::PHASE_COUNT; ++i)
+		llTotal += stats.GetWallTime(static_cast<ZapStats::Phase>(i));
+	// Bytes per microsecond are MB per second.
+	LONGLONG llHashUs = stats.GetWallTime(ZapStats::DEDUP);
+	double dHashRate = llHashUs > 0 ? static_cast<double>(stats.Get(ZapStats::HASHED)) / llHashUs : 0;
+	fwprintf(stdout,
+		L"%s\n\t\t{ \"mode\": \"%s\", \"run\": %u, \"hr\": \"0x%08x\", "
+		L"\"folders\": %u, \"files\": %u, \"bytes\": %I64u, \"generate_us\": %I64d, "
+		L"\"total_us\": %I64d, \"hash_mb_per_s\": %.1f, \"stats\": %s }",
+		m_bFirst ? L"" : L",", bRecursive ? L"recursive" : L"flat", uRun, hRes,
+		counts.uFolders, counts.uFiles, counts.ullBytes, llGenerate * 1000000 / m_llFrequency,
+		llTotal, dHashRate, stats.ToJson().GetString());
+	fflush(stdout);
+	m_bFirst = false;
+
+	RemoveTree(szRunDir);
+	return hRes;
+}
+
+//
+// Print the settings of the benchmark and open the list of runs
+//
+void ZapBench::PrintHeader() const {
+	WCHAR szVolume[MAX_PATH] = L"";
+	WCHAR szFileSystem[MAX_PATH] = L"";
+	if (::GetVolumePathName(m_szDir, szVolume, MAX_PATH))
+		::GetVolumeInformation(szVolume, 0, 0, 0, 0, 0, szFileSystem, MAX_PATH);
+	UINT uExcluded = 0;
+	double dMatchNs = TimeFilter(uExcluded);
+
+	fwprintf(stdout,
+		L"{\n"
+		L"\t\"dir\": %s,\n"
+		L"\t\"volume\": %s,\n"
+		L"\t\"filesystem\": %s,\n"
+		L"\t\"shape\": { \"fanout\": %u, \"depth\": %u, \"files\": %u, \"min_size\": %I64u, "
+		L"\"max_size\": %I64u, \"collide\": %u, \"dupes\": %u, \"selfname\": %s, \"seed\": %u },\n"
+		L"\t\"options\": { \"native_move\": %s, \"collision_policy\": \"%s\", \"scan_threads\": %u, "
+		L"\"queue_depth\": %u, \"handle_budget\": %u, \"list_buffer\": %u, \"levels\": %u, \"dedup\": %s },\n"
+		L"\t\"filter\": { \"rules\": %Iu, \"states\": %Iu, \"names\": %u, \"excluded\": %u, "
+		L"\"match_ns_per_name\": %.1f },\n"
+		L"\t\"runs\": [",
+		JsonString(m_szDir).GetString(), JsonString(szVolume).GetString(),
+		JsonString(szFileSystem).GetString(),
+		m_Shape.uFanout, m_Shape.uDepth, m_Shape.uFiles, m_Shape.ullMinSize,
+		m_Shape.ullMaxSize, m_Shape.uCollide, m_Shape.uDupes, m_Shape.bSelfName ? L"true" : L"false", m_Shape.uSeed,
+		m_Options.bNativeMove ? L"true" : L"false", ZapEngine::GetCollisionPolicyName(m_Options),
+		m_Options.uScanThreads, m_Options.uQueueDepth, m_Options.uHandleBudget, m_Options.uListBuffer,
+		m_Options.uDepth, m_Options.bDedup ? L"true" : L"false", m_Filter.GetRuleCount(), m_Filter.GetStateCount(), MATCH_NAMES, uExcluded, dMatchNs);
+}
+
+//
+// TimeFilter
+//
+// Times the filter on names shaped like the generated ones, built up front
+// so that only the matching is timed.
+//
+// @param uExcluded Receives the number of names excluded.
+// @return Nanoseconds per name; 0 without rules.
+//
+double ZapBench::TimeFilter(UINT& uExcluded) const {
+	uExcluded = 0;
+	if (m_Filter.IsEmpty())
+		return 0;
+	std::vector<WCHAR> vNames;
+	std::vector<UINT> vOffsets;
+	vNames.reserve(MATCH_NAMES * 12);
+	vOffsets.reserve(MATCH_NAMES + 1);
+	WCHAR szName[16];
+	for (UINT i = 0; i < MATCH_NAMES; ++i) {
+		int cchName = i % 3 == 0 ? swprintf_s(szName, L"f%06u.dat", i)
+			: i % 3 == 1 ? swprintf_s(szName, L"d%06u", i)
+			: swprintf_s(szName, L"c%02u.tmp", i % COLLIDE_POOL);
+		vOffsets.push_back(static_cast<UINT>(vNames.size()));
+		vNames.insert(vNames.end(), szName, szName + cchName);
+	}
+	vOffsets.push_back(static_cast<UINT>(vNames.size()));
+
+	LONGLONG llStart = GetTicks();
+	for (UINT i = 0; i < MATCH_NAMES; ++i) {
+		if (m_Filter.IsExcluded(&vNames[vOffsets[i]], vOffsets[i + 1] - vOffsets[i], true))
+			++uExcluded;
+	}
+	LONGLONG llTicks = GetTicks() - llStart;
+	return static_cast<double>(llTicks) * 1e9 / m_llFrequency / MATCH_NAMES;
+}
+
+//
+// Generate
+//
+// Creates the tree to zap. The same shape and seed always give the same tree.
+//
+// @param szRoot Folder to create.
+// @param counts Receives what was created.
+// @return Result code.
+//
+HRESULT ZapBench::Generate(const CString& szRoot, Counts& counts) {
+	m_ullState = 0x9E3779B97F4A7C15ULL ^ m_Shape.uSeed;
+	m_uNames = 0;
+	for (size_t i = 0; i < m_vData.size(); ++i)
+		m_vData[i] = static_cast<BYTE>(NextRandom());
+	m_vDupes.clear();
+	for (UINT i = 0; m_Shape.uDupes != 0 && i < COLLIDE_POOL; ++i)
+		m_vDupes.push_back(NextSize());
+
+	if (!::CreateDirectory(szRoot, 0))
+		return HRESULT_FROM_WIN32(::GetLastError());
+	ZapPathBuilder path;
+	path.Reset(szRoot);
+	HRESULT hRes = GenerateFolder(path, 0, counts);
+	if (SUCCEEDED(hRes) && m_Shape.bSelfName) {
+		hRes = GenerateFile(szRoot + L"\\" + ZAPPED_NAME, NextSize(), RANDOM_OFFSET);
+		if (SUCCEEDED(hRes))
+			++counts.uFiles;
+	}
+	return hRes;
+}
+
+//
+// Create the files and subfolders of one folder
+//
+// @param path Folder; components are pushed and popped, so it is unchanged on return.
+// @param uLevel Depth of the folder.
+// @param counts Receives what was created.
+// @return Result code.
+//
+HRESULT ZapBench::GenerateFolder(ZapPathBuilder& path, UINT uLevel, Counts& counts) {
+	WCHAR szName[16];
+	for (UINT i = 0; i < m_Shape.uFiles; ++i) {
+		UINT uPool = COLLIDE_POOL;
+		if (NextRandom() % 100 < m_Shape.uCollide)
+			uPool = static_cast<UINT>(NextRandom() % COLLIDE_POOL);
+		int cchName = uPool < COLLIDE_POOL
+			? swprintf_s(szName, L"c%02u.dat", uPool)
+			: swprintf_s(szName, L"f%06u.dat", m_uNames++);
+		// Identical files of a name share their size and their start in the buffer.
+		bool bDupe = uPool < COLLIDE_POOL && m_Shape.uDupes != 0 && NextRandom() % 100 < m_Shape.uDupes;
+		ULONGLONG ullSize = bDupe ? m_vDupes[uPool] : NextSize();
+		UINT cchFolder = path.Push(szName, cchName);
+		HRESULT hRes = GenerateFile(path.GetString(), ullSize, bDupe ? uPool : RANDOM_OFFSET);
+		path.Pop(cchFolder);
+		if (hRes == HRESULT_FROM_WIN32(ERROR_FILE_EXISTS))
+			continue;
+		if (FAILED(hRes))
+			return hRes;
+		++counts.uFiles;
+		counts.ullBytes += ullSize;
+	}
+	if (uLevel >= m_Shape.uDepth)
+		return S_OK;
+	for (UINT i = 0; i < m_Shape.uFanout; ++i) {
+		int cchName = swprintf_s(szName, L"d%06u", m_uNames++);
+		UINT cchFolder = path.Push(szName, cchName);
+		HRESULT hRes = ::CreateDirectory(path.GetString(), 0) ? S_OK : HRESULT_FROM_WIN32(::GetLastError());
+		if (SUCCEEDED(hRes)) {
+			++counts.uFolders;
+			hRes = GenerateFolder(path, uLevel + 1, counts);
+		}
+		path.Pop(cchFolder);
+		if (FAILED(hRes))
+			return hRes;
+	}
+	return S_OK;
+}
+
+//
+// Create one file
+//
+// @param szPath File to create; it must not exist.
+// @param ullSize Size of the file.
+// @param dwOffset Place in the buffer the content starts at, or RANDOM_OFFSET.
+// @return Result code.
+//
+HRESULT ZapBench::GenerateFile(const CString& szPath, ULONGLONG ullSize, DWORD dwOffset) {
+	CHandle hFile(::CreateFile(szPath, GENERIC_WRITE, 0, 0, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, 0));
+	if (hFile == INVALID_HANDLE_VALUE) {
+		hFile.Detach();
+		return HRESULT_FROM_WIN32(::GetLastError());
+	}
+	// Start at a different place in the buffer for each file.
+	if (dwOffset == RANDOM_OFFSET)
+		dwOffset = static_cast<DWORD>(NextRandom() % DATA_SIZE);
+	while (ullSize > 0) {
+		DWORD cb = DATA_SIZE - dwOffset;
+		if (cb > ullSize) cb = static_cast<DWORD>(ullSize);
+		DWORD cbWritten = 0;
+		if (!::WriteFile(hFile, &m_vData[dwOffset], cb, &cbWritten, 0))
+			return HRESULT_FROM_WIN32(::GetLastError());
+		ullSize -= cbWritten;
+		dwOffset = 0;
+	}
+	return S_OK;
+}
+
+//
+// Next value of the generator (xorshift64*)
+//
+ULONGLONG ZapBench::NextRandom() {
+	m_ullState ^= m_ullState >> 12;
+	m_ullState ^= m_ullState << 25;
+	m_ullState ^= m_ullState >> 27;
+	return m_ullState * 2685821657736338717ULL;
+}
+
+//
+// Size of the next file, log-uniform between the smallest and largest size
+//
+ULONGLONG ZapBench::NextSize() {
+	ULONGLONG ullMin = m_Shape.ullMinSize, ullMax = m_Shape.ullMaxSize;
+	if (ullMax <= ullMin)
+		return ullMin;
+	// Pick an order of magnitude first, then a size within it.
+	UINT uMinBits = 0, uMaxBits = 0;
+	while (uMinBits < 64 && (ullMin >> uMinBits) != 0) ++uMinBits;
+	while (uMaxBits < 64 && (ullMax >> uMaxBits) != 0) ++uMaxBits;
+	UINT uBits = uMinBits + static_cast<UINT>(NextRandom() % (uMaxBits - uMinBits + 1));
+	ULONGLONG ullLow = uBits == 0 ? 0 : 1ULL << (uBits - 1);
+	ULONGLONG ullHigh = uBits == 0 ? 0 : (ullLow << 1) - 1;
+	if (ullLow < ullMin) ullLow = ullMin;
+	if (ullHigh > ullMax) ullHigh = ullMax;
+	return ullLow + NextRandom() % (ullHigh - ullLow + 1);
+}
+
+//
+// Delete a folder and everything in it, without UI and without the recycle bin
+//
+HRESULT ZapBench::RemoveTree(const CString& szPath) {
+	if (::GetFileAttributes(szPath) == INVALID_FILE_ATTRIBUTES)
+		return S_OK;
+	CString szFrom(szPath);
+	szFrom.AppendChar(L'\0');
+	SHFILEOPSTRUCT fileOpStruct = {0};
+	fileOpStruct.wFunc = FO_DELETE;
+	fileOpStruct.pFrom = szFrom;
+	fileOpStruct.fFlags = FOF_SILENT | FOF_NOCONFIRMATION | FOF_NOERRORUI;
+	int iRes = ::SHFileOperation(&fileOpStruct);
+	return iRes == 0 ? S_OK : HRESULT_FROM_WIN32(iRes);
+}
+
+//
+// Quote a string for JSON
+//
+CString ZapBench::JsonString(const CString& sz) {
+	CString szJson(L"\"");
+	for (int i = 0; i < sz.GetLength(); ++i) {
+		WCHAR ch = sz[i];
+		if (ch == L'"' || ch == L'\\')
+			szJson.AppendChar(L'\\');
+		if (ch < 0x20)
+			szJson.AppendFormat(L"\\u%04x", ch);
+		else
+			szJson.AppendChar(ch);
+	}
+	szJson.AppendChar(L'"');
+	return szJson;
+}
@@ -1,4 +1,6 @@
 call build.bat Release x64 LevelZap
 call build.bat Release Win32 LevelZap
+call build.bat Release x64 LevelZapCmd
+call build.bat Release Win32 LevelZapCmd
 @if %ERRORLEVEL% equ 0 (@echo All builds succeeded)
 pause
\ No newline at end of file